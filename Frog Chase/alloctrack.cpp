@@ -0,0 +1,157 @@
+#include "alloctrack.h"
+
+#if defined(FROG_TRACK_ALLOCS)
+#include <atomic>
+#include <new>
+#include <stdlib.h>
+
+#if defined(_MSC_VER)
+#define ALLOC_THREAD_LOCAL __declspec(thread)
+#else
+#define ALLOC_THREAD_LOCAL __thread
+#endif
+
+//Counters live in static storage, zeroed before any constructor can allocate
+static std::atomic<unsigned long long> sFrameCount[ALLOC_TAG_COUNT];
+static std::atomic<unsigned long long> sFrameBytes[ALLOC_TAG_COUNT];
+static std::atomic<unsigned long long> sTotalCount[ALLOC_TAG_COUNT];
+static std::atomic<unsigned long long> sTotalBytes[ALLOC_TAG_COUNT];
+
+//Subsystem the calling thread is working for
+static ALLOC_THREAD_LOCAL int tAllocTag = ALLOC_OTHER;
+
+static const char *ALLOC_TAG_NAMES[ALLOC_TAG_COUNT] =
+{
+	"other",
+	"game",
+	"render",
+	"audio",
+	"assets",
+	"jobs",
+};
+
+static void *trackedAlloc(size_t size)
+{
+	int tag = tAllocTag;
+	sFrameCount[tag]++;
+	sFrameBytes[tag] += size;
+	sTotalCount[tag]++;
+	sTotalBytes[tag] += size;
+	return malloc(size > 0 ? size : 1);
+}
+
+AllocScope::AllocScope(AllocTag tag)
+{
+	mPrevious = tAllocTag;
+	tAllocTag = tag;
+}
+
+AllocScope::~AllocScope()
+{
+	tAllocTag = mPrevious;
+}
+
+bool allocTrackingEnabled()
+{
+	return true;
+}
+
+void allocFrameBegin()
+{
+	for (int i = 0; i < ALLOC_TAG_COUNT; i++)
+	{
+		sFrameCount[i] = 0;
+		sFrameBytes[i] = 0;
+	}
+}
+
+AllocCounts allocFrameCounts(AllocTag tag)
+{
+	AllocCounts counts = { sFrameCount[tag].load(), sFrameBytes[tag].load() };
+	return counts;
+}
+
+AllocCounts allocFrameCounts()
+{
+	AllocCounts counts = { 0, 0 };
+	for (int i = 0; i < ALLOC_TAG_COUNT; i++)
+	{
+		counts.count += sFrameCount[i].load();
+		counts.bytes += sFrameBytes[i].load();
+	}
+	return counts;
+}
+
+AllocCounts allocTotalCounts(AllocTag tag)
+{
+	AllocCounts counts = { sTotalCount[tag].load(), sTotalBytes[tag].load() };
+	return counts;
+}
+
+const char *allocTagName(AllocTag tag)
+{
+	return ALLOC_TAG_NAMES[tag];
+}
+
+void *operator new(size_t size)
+{
+	void *p = trackedAlloc(size);
+	if (p == NULL)
+	{
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void *operator new[](size_t size)
+{
+	void *p = trackedAlloc(size);
+	if (p == NULL)
+	{
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void *operator new(size_t size, const std::nothrow_t &)
+{
+	return trackedAlloc(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &)
+{
+	return trackedAlloc(size);
+}
+
+void operator delete(void *p)
+{
+	free(p);
+}
+
+void operator delete[](void *p)
+{
+	free(p);
+}
+
+void operator delete(void *p, const std::nothrow_t &)
+{
+	free(p);
+}
+
+void operator delete[](void *p, const std::nothrow_t &)
+{
+	free(p);
+}
+
+//Sized forms, called by C++14 compilers when the size is known
+void operator delete(void *p, size_t)
+{
+	free(p);
+}
+
+void operator delete[](void *p, size_t)
+{
+	free(p);
+}
+
+#endif
@@ -0,0 +1,103 @@
+#pragma once
+
+/*
+* Allocation tracking for finding and keeping out heap use in the frame loop.
+* Builds with FROG_TRACK_ALLOCS replace the global operator new and delete and
+* count allocations and bytes per frame and per subsystem; other builds get
+* empty inline versions, so the calls can stay in place.
+*/
+
+//Frames at the start of a round allowed to allocate while caches fill
+const int ALLOC_WARMUP_FRAMES = 120;
+
+enum AllocTag
+{
+	ALLOC_OTHER,
+	ALLOC_GAME,
+	ALLOC_RENDER,
+	ALLOC_AUDIO,
+	ALLOC_ASSETS,
+	ALLOC_JOBS,
+	ALLOC_TAG_COUNT
+};
+
+struct AllocCounts
+{
+	unsigned long long count;
+	unsigned long long bytes;
+};
+
+#if defined(FROG_TRACK_ALLOCS)
+
+//Charges allocations on this thread to a subsystem while in scope
+class AllocScope
+{
+public:
+	AllocScope(AllocTag tag);
+	~AllocScope();
+
+private:
+	int mPrevious;
+};
+
+//True when allocations are being counted
+bool allocTrackingEnabled();
+
+//Starts counting a new frame
+void allocFrameBegin();
+
+//Allocations since allocFrameBegin, from every thread
+AllocCounts allocFrameCounts(AllocTag tag);
+
+//Allocations since allocFrameBegin over every subsystem
+AllocCounts allocFrameCounts();
+
+//Allocations since the program started
+AllocCounts allocTotalCounts(AllocTag tag);
+
+//Name of a subsystem for reports
+const char *allocTagName(AllocTag tag);
+
+#else
+
+class AllocScope
+{
+public:
+	AllocScope(AllocTag)
+	{
+	}
+};
+
+inline bool allocTrackingEnabled()
+{
+	return false;
+}
+
+inline void allocFrameBegin()
+{
+}
+
+inline AllocCounts allocFrameCounts(AllocTag)
+{
+	AllocCounts counts = { 0, 0 };
+	return counts;
+}
+
+inline AllocCounts allocFrameCounts()
+{
+	AllocCounts counts = { 0, 0 };
+	return counts;
+}
+
+inline AllocCounts allocTotalCounts(AllocTag)
+{
+	AllocCounts counts = { 0, 0 };
+	return counts;
+}
+
+inline const char *allocTagName(AllocTag)
+{
+	return "";
+}
+
+#endif
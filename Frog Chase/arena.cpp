@@ -0,0 +1,92 @@
+#include "arena.h"
+#include <new>
+#include <stdint.h>
+
+Arena::Arena(size_t blockSize)
+{
+	//Initialize
+	mBlockSize = blockSize;
+	mCurrent = 0;
+	mOffset = 0;
+	mUsed = 0;
+	mPeak = 0;
+	mCapacity = 0;
+}
+
+Arena::~Arena()
+{
+	//Deallocate
+	free();
+}
+
+void *Arena::allocate(size_t bytes, size_t align)
+{
+	for (;;)
+	{
+		//Bump within the current block, or move on to the next one that fits
+		while (mCurrent < mBlocks.size())
+		{
+			Block &block = mBlocks[mCurrent];
+			uintptr_t base = reinterpret_cast<uintptr_t>(block.data);
+			size_t start = static_cast<size_t>(((base + mOffset + align - 1) & ~static_cast<uintptr_t>(align - 1)) - base);
+			if (start + bytes <= block.size)
+			{
+				mUsed += start + bytes - mOffset;
+				mPeak = mUsed > mPeak ? mUsed : mPeak;
+				mOffset = start + bytes;
+				return block.data + start;
+			}
+
+			//The rest of this block is lost until the next reset
+			mUsed += block.size - mOffset;
+			mCurrent++;
+			mOffset = 0;
+		}
+
+		//Out of blocks, add one big enough for this allocation
+		Block block;
+		block.size = bytes + align > mBlockSize ? bytes + align : mBlockSize;
+		block.data = new (std::nothrow) char[block.size];
+		if (block.data == NULL)
+		{
+			return NULL;
+		}
+		mBlocks.push_back(block);
+		mCapacity += block.size;
+		mCurrent = mBlocks.size() - 1;
+		mOffset = 0;
+	}
+}
+
+void Arena::reset()
+{
+	mCurrent = 0;
+	mOffset = 0;
+	mUsed = 0;
+}
+
+void Arena::free()
+{
+	for (size_t i = 0; i < mBlocks.size(); i++)
+	{
+		delete[] mBlocks[i].data;
+	}
+	mBlocks.clear();
+	mCapacity = 0;
+	reset();
+}
+
+size_t Arena::getUsed()
+{
+	return mUsed;
+}
+
+size_t Arena::getPeak()
+{
+	return mPeak;
+}
+
+size_t Arena::getCapacity()
+{
+	return mCapacity;
+}
@@ -0,0 +1,125 @@
+#pragma once
+#include <stddef.h>
+#include <vector>
+
+/*
+* Bump allocator for state that lives exactly as long as something else, such
+* as a round of the game. Allocation is a pointer bump, freeing one object does
+* nothing, and reset() releases everything at once while keeping the blocks, so
+* memory stays at the size of the largest round however many rounds are played.
+*/
+
+//Size of each block the arena asks the heap for
+const size_t ARENA_BLOCK_SIZE = 64 * 1024;
+
+//Alignment of allocations that don't ask for one
+const size_t ARENA_DEFAULT_ALIGN = 16;
+
+class Arena
+{
+public:
+	//Initializes variables
+	Arena(size_t blockSize = ARENA_BLOCK_SIZE);
+
+	//Deallocates memory
+	~Arena();
+
+	//Returns bytes aligned to align, a power of two
+	void *allocate(size_t bytes, size_t align = ARENA_DEFAULT_ALIGN);
+
+	//Releases every allocation at once, keeping the blocks for reuse
+	void reset();
+
+	//Gives the blocks back to the heap
+	void free();
+
+	//Bytes handed out since the last reset, padding included
+	size_t getUsed();
+
+	//Most bytes in use at once since the arena was made
+	size_t getPeak();
+
+	//Bytes held in blocks
+	size_t getCapacity();
+
+private:
+	struct Block
+	{
+		char *data;
+		size_t size;
+	};
+
+	size_t mBlockSize;
+	std::vector<Block> mBlocks;
+
+	//Block being bumped and how far into it
+	size_t mCurrent;
+	size_t mOffset;
+
+	size_t mUsed;
+	size_t mPeak;
+	size_t mCapacity;
+};
+
+/*
+* Standard allocator that takes its memory from an arena, for containers
+* that are thrown away with the arena
+*/
+template<class T>
+class ArenaAllocator
+{
+public:
+	typedef T value_type;
+	typedef T *pointer;
+	typedef const T *const_pointer;
+	typedef T &reference;
+	typedef const T &const_reference;
+	typedef size_t size_type;
+	typedef ptrdiff_t difference_type;
+
+	template<class U>
+	struct rebind
+	{
+		typedef ArenaAllocator<U> other;
+	};
+
+	ArenaAllocator(Arena &arena) : mArena(&arena)
+	{
+	}
+
+	template<class U>
+	ArenaAllocator(const ArenaAllocator<U> &other) : mArena(other.getArena())
+	{
+	}
+
+	T *allocate(size_t count)
+	{
+		size_t align = __alignof(T) > ARENA_DEFAULT_ALIGN ? __alignof(T) : ARENA_DEFAULT_ALIGN;
+		return static_cast<T *>(mArena->allocate(count * sizeof(T), align));
+	}
+
+	void deallocate(T *, size_t)
+	{
+		//Freed with the whole arena
+	}
+
+	Arena *getArena() const
+	{
+		return mArena;
+	}
+
+	template<class U>
+	bool operator==(const ArenaAllocator<U> &other) const
+	{
+		return mArena == other.getArena();
+	}
+
+	template<class U>
+	bool operator!=(const ArenaAllocator<U> &other) const
+	{
+		return mArena != other.getArena();
+	}
+
+private:
+	Arena *mArena;
+};
@@ -0,0 +1,219 @@
+#include "audio.h"
+#include <stdio.h>
+#include "alloctrack.h"
+
+AudioSystem gAudio;
+
+AudioSystem::AudioSystem()
+{
+	//Initialize
+	mOpen = false;
+	mFrequency = 0;
+	mFrameBytes = 0;
+	mCallbackBytes = 0;
+	mCallbacks = 0;
+	mTriggerPending = false;
+	mCallbackTicks = 0;
+}
+
+AudioSystem::~AudioSystem()
+{
+	//Deallocate
+	close();
+}
+
+bool AudioSystem::open(int frequency, int samples)
+{
+	close();
+
+	if (samples <= 0)
+	{
+		samples = AUDIO_LOW_LATENCY_SAMPLES;
+	}
+
+	//Some drivers refuse tiny buffers, back off until one is taken
+	while (Mix_OpenAudio(frequency, MIX_DEFAULT_FORMAT, 2, samples) < 0)
+	{
+		if (samples >= AUDIO_MAX_SAMPLES)
+		{
+			return false;
+		}
+		samples *= 2;
+	}
+	mOpen = true;
+
+	Uint16 format = 0;
+	int channels = 0;
+	Mix_QuerySpec(&mFrequency, &format, &channels);
+	mVoices.open();
+
+	//Reserved now so queueing a sound in play doesn't allocate
+	mQueued.reserve(AUDIO_QUEUED_SOUNDS);
+	mFrameBytes = SDL_AUDIO_BITSIZE(format) / 8 * channels;
+
+	//The mixer doesn't say what buffer it got, the callback length does
+	mCallbackBytes = samples * mFrameBytes;
+	Mix_SetPostMix(postMix, this);
+	waitForCallback(250);
+
+	printf("Audio: %d Hz, %d sample buffer, %.1f ms\n", mFrequency, getBufferSamples(), getBufferMs());
+	return true;
+}
+
+void AudioSystem::close()
+{
+	mQueued.clear();
+	if (!mOpen)
+	{
+		return;
+	}
+	Mix_SetPostMix(NULL, NULL);
+	Mix_CloseAudio();
+	mVoices.close();
+	mOpen = false;
+}
+
+int AudioSystem::getFrequency()
+{
+	return mFrequency;
+}
+
+int AudioSystem::getBufferSamples()
+{
+	return mFrameBytes > 0 ? mCallbackBytes / mFrameBytes : 0;
+}
+
+double AudioSystem::getBufferMs()
+{
+	return mFrequency > 0 ? getBufferSamples() * 1000.0 / mFrequency : 0.0;
+}
+
+int AudioSystem::play(Mix_Chunk *chunk, SoundClass soundClass)
+{
+	return mVoices.play(chunk, soundClass);
+}
+
+void AudioSystem::playOnPresent(Mix_Chunk *chunk, SoundClass soundClass)
+{
+	AllocScope scope(ALLOC_AUDIO);
+	if (mOpen && chunk != NULL && mQueued.size() < AUDIO_QUEUED_SOUNDS)
+	{
+		QueuedSound sound;
+		sound.chunk = chunk;
+		sound.soundClass = soundClass;
+		mQueued.push_back(sound);
+	}
+}
+
+void AudioSystem::flush()
+{
+	AllocScope scope(ALLOC_AUDIO);
+	for (size_t i = 0; i < mQueued.size(); i++)
+	{
+		mVoices.play(mQueued[i].chunk, mQueued[i].soundClass);
+	}
+	mQueued.clear();
+}
+
+bool AudioSystem::measureLatency(int trials, AudioLatency &result)
+{
+	result.averageMs = 0.0;
+	result.worstMs = 0.0;
+	result.bufferMs = getBufferMs();
+	if (!mOpen || trials <= 0)
+	{
+		return false;
+	}
+
+	//One buffer of silence, so the test makes no noise
+	std::vector<Uint8> silence(mCallbackBytes, 0);
+	Mix_Chunk *chunk = Mix_QuickLoad_RAW(&silence[0], static_cast<Uint32>(silence.size()));
+	if (chunk == NULL)
+	{
+		return false;
+	}
+
+	double frequency = static_cast<double>(SDL_GetPerformanceFrequency());
+	double total = 0.0;
+	int done = 0;
+	for (int i = 0; i < trials; i++)
+	{
+		//Line the trigger up just after a callback, like a present would
+		if (!waitForCallback(250))
+		{
+			break;
+		}
+
+		//Armed before the chunk starts: Mix_PlayChannel lets go of the audio
+		//lock before it returns, so a callback may mix the chunk before then
+		Uint64 start = SDL_GetPerformanceCounter();
+		mTriggerPending = true;
+		if (Mix_PlayChannel(-1, chunk, 0) < 0)
+		{
+			mTriggerPending = false;
+			break;
+		}
+
+		Uint32 deadline = SDL_GetTicks() + 250;
+		while (mTriggerPending && SDL_GetTicks() < deadline)
+		{
+			SDL_Delay(0);
+		}
+		if (mTriggerPending)
+		{
+			mTriggerPending = false;
+			break;
+		}
+
+		double elapsed = (mCallbackTicks - start) * 1000.0 / frequency;
+		total += elapsed;
+		if (elapsed > result.worstMs)
+		{
+			result.worstMs = elapsed;
+		}
+		done++;
+	}
+
+	Mix_HaltChannel(-1);
+	Mix_FreeChunk(chunk);
+
+	if (done == 0)
+	{
+		return false;
+	}
+	result.averageMs = total / done;
+	return done == trials;
+}
+
+VoiceStats AudioSystem::getVoiceStats()
+{
+	return mVoices.getStats();
+}
+
+void AudioSystem::postMix(void *udata, Uint8 *, int len)
+{
+	AudioSystem *audio = static_cast<AudioSystem *>(udata);
+	if (audio->mTriggerPending)
+	{
+		audio->mCallbackTicks = SDL_GetPerformanceCounter();
+		audio->mTriggerPending = false;
+	}
+	audio->mCallbackBytes = len;
+	audio->mCallbacks++;
+	audio->mVoices.countMix(len / audio->mFrameBytes);
+}
+
+bool AudioSystem::waitForCallback(Uint32 timeoutMs)
+{
+	unsigned seen = mCallbacks;
+	Uint32 deadline = SDL_GetTicks() + timeoutMs;
+	while (mCallbacks == seen)
+	{
+		if (SDL_GetTicks() >= deadline)
+		{
+			return false;
+		}
+		SDL_Delay(0);
+	}
+	return true;
+}
@@ -0,0 +1,115 @@
+#pragma once
+#include <atomic>
+#include <vector>
+#if defined(_MSC_VER)
+#include <SDL.h>
+#include <SDL_mixer.h>
+#elif defined(__clang__)
+#include <SDL2/SDL.h>
+#include <SDL2_mixer/SDL_mixer.h>
+#else
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_mixer.h>
+#endif
+#include "voices.h"
+
+/*
+* Opens the mixer with a device buffer picked at runtime, reports the latency
+* the device actually gave us and holds sound effects back until the frame
+* that shows them is presented.
+*/
+
+//Sample rate asked for unless told otherwise
+const int AUDIO_DEFAULT_FREQUENCY = 44100;
+
+//Device buffer for interactive play, 256 samples is about 5.8 ms at 44.1 kHz
+const int AUDIO_LOW_LATENCY_SAMPLES = 256;
+
+//Largest buffer tried when the device refuses the smaller ones
+const int AUDIO_MAX_SAMPLES = 4096;
+
+//Triggers the loopback test times when none are given
+const int AUDIO_TEST_TRIALS = 20;
+
+//Sounds one frame can hold back for its present, more are dropped
+const size_t AUDIO_QUEUED_SOUNDS = 16;
+
+struct AudioLatency
+{
+	//Trigger to the mixer callback that picked the sound up
+	double averageMs;
+	double worstMs;
+
+	//Length of one device buffer, the sound is still this far from the speaker
+	double bufferMs;
+};
+
+class AudioSystem
+{
+public:
+	//Initializes variables
+	AudioSystem();
+
+	//Deallocates memory
+	~AudioSystem();
+
+	//Opens the mixer, doubling the buffer until the device takes it
+	bool open(int frequency = AUDIO_DEFAULT_FREQUENCY, int samples = AUDIO_LOW_LATENCY_SAMPLES);
+
+	//Closes the mixer and drops anything still queued
+	void close();
+
+	//Sample rate the device runs at
+	int getFrequency();
+
+	//Sample frames per device buffer the mixer callback is handed
+	int getBufferSamples();
+
+	//Length of one device buffer in milliseconds
+	double getBufferMs();
+
+	//Plays a sound effect right away, returns the channel or -1
+	int play(Mix_Chunk *chunk, SoundClass soundClass);
+
+	//Plays a sound effect once the current frame is presented
+	void playOnPresent(Mix_Chunk *chunk, SoundClass soundClass);
+
+	//Plays what was queued for this frame, called right after the present
+	void flush();
+
+	//Times how long triggered sounds wait for the mixer callback
+	bool measureLatency(int trials, AudioLatency &result);
+
+	//Voice pool counters, including what each callback mixed
+	VoiceStats getVoiceStats();
+
+private:
+	//Mixer post-mix hook, runs on the audio thread
+	static void postMix(void *udata, Uint8 *stream, int len);
+
+	//Waits for the next mixer callback, false if none came in time
+	bool waitForCallback(Uint32 timeoutMs);
+
+	bool mOpen;
+	int mFrequency;
+	int mFrameBytes;
+
+	//Filled in by the audio thread
+	std::atomic<int> mCallbackBytes;
+	std::atomic<unsigned> mCallbacks;
+
+	//Set by a trigger, the next callback stamps the time and clears it
+	std::atomic<bool> mTriggerPending;
+	std::atomic<Uint64> mCallbackTicks;
+
+	struct QueuedSound
+	{
+		Mix_Chunk *chunk;
+		SoundClass soundClass;
+	};
+	std::vector<QueuedSound> mQueued;
+
+	VoicePool mVoices;
+};
+
+extern AudioSystem gAudio;
@@ -0,0 +1,327 @@
+#pragma once
+#include "board.h"
+#include "commandring.h"
+
+/*
+* Bitboard form of the game rules for solvers and analysers. A board of
+* W x H tiles is a set of bits, tile (col, row) at bit row * W + col, packed
+* into 64-bit words; the play area's 108 tiles take two. Moving, flood fills
+* and collision are shifts and masks over whole sets at once, so one call
+* advances every frog position in a set. The size is a template parameter,
+* so each board size gets its own fully unrolled code.
+*/
+
+template <int W, int H>
+class BitSet
+{
+public:
+	static const int TILES = W * H;
+	static const int WORDS = (TILES + 63) / 64;
+
+	//Initializes an empty set
+	BitSet()
+	{
+		clear();
+	}
+
+	//Empties the set
+	void clear()
+	{
+		for (int i = 0; i < WORDS; i++)
+		{
+			mWords[i] = 0;
+		}
+	}
+
+	//Adds a tile, tiles outside the board are ignored
+	void set(int col, int row)
+	{
+		if (col >= 0 && col < W && row >= 0 && row < H)
+		{
+			int bit = row * W + col;
+			mWords[bit / 64] |= 1ULL << (bit % 64);
+		}
+	}
+
+	//Removes a tile
+	void reset(int col, int row)
+	{
+		if (col >= 0 && col < W && row >= 0 && row < H)
+		{
+			int bit = row * W + col;
+			mWords[bit / 64] &= ~(1ULL << (bit % 64));
+		}
+	}
+
+	//True when the tile is in the set, false outside the board
+	bool test(int col, int row) const
+	{
+		if (col < 0 || col >= W || row < 0 || row >= H)
+		{
+			return false;
+		}
+		int bit = row * W + col;
+		return (mWords[bit / 64] >> (bit % 64) & 1) != 0;
+	}
+
+	//True when any tile is in the set
+	bool any() const
+	{
+		unsigned long long bits = 0;
+		for (int i = 0; i < WORDS; i++)
+		{
+			bits |= mWords[i];
+		}
+		return bits != 0;
+	}
+
+	//Number of tiles in the set
+	int count() const
+	{
+		int total = 0;
+		for (int i = 0; i < WORDS; i++)
+		{
+			for (unsigned long long bits = mWords[i]; bits != 0; bits &= bits - 1)
+			{
+				total++;
+			}
+		}
+		return total;
+	}
+
+	//Finds the lowest tile in the set; false when it is empty
+	bool first(int &col, int &row) const
+	{
+		for (int i = 0; i < WORDS; i++)
+		{
+			if (mWords[i] != 0)
+			{
+				int bit = i * 64;
+				for (unsigned long long bits = mWords[i]; (bits & 1) == 0; bits >>= 1)
+				{
+					bit++;
+				}
+				col = bit % W;
+				row = bit / W;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	BitSet operator|(const BitSet &other) const
+	{
+		BitSet result;
+		for (int i = 0; i < WORDS; i++)
+		{
+			result.mWords[i] = mWords[i] | other.mWords[i];
+		}
+		return result;
+	}
+
+	BitSet operator&(const BitSet &other) const
+	{
+		BitSet result;
+		for (int i = 0; i < WORDS; i++)
+		{
+			result.mWords[i] = mWords[i] & other.mWords[i];
+		}
+		return result;
+	}
+
+	//Tiles in this set but not in other
+	BitSet without(const BitSet &other) const
+	{
+		BitSet result;
+		for (int i = 0; i < WORDS; i++)
+		{
+			result.mWords[i] = mWords[i] & ~other.mWords[i];
+		}
+		return result;
+	}
+
+	bool operator==(const BitSet &other) const
+	{
+		for (int i = 0; i < WORDS; i++)
+		{
+			if (mWords[i] != other.mWords[i])
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool operator!=(const BitSet &other) const
+	{
+		return !(*this == other);
+	}
+
+	//Every bit moved n places up, bits past the last tile are dropped
+	BitSet shiftedUp(int n) const
+	{
+		BitSet result;
+		int words = n / 64;
+		int bits = n % 64;
+		for (int i = WORDS - 1; i >= words; i--)
+		{
+			unsigned long long value = mWords[i - words] << bits;
+			if (bits != 0 && i - words - 1 >= 0)
+			{
+				value |= mWords[i - words - 1] >> (64 - bits);
+			}
+			result.mWords[i] = value;
+		}
+		result.trim();
+		return result;
+	}
+
+	//Every bit moved n places down, bits below the first tile are dropped
+	BitSet shiftedDown(int n) const
+	{
+		BitSet result;
+		int words = n / 64;
+		int bits = n % 64;
+		for (int i = 0; i + words < WORDS; i++)
+		{
+			unsigned long long value = mWords[i + words] >> bits;
+			if (bits != 0 && i + words + 1 < WORDS)
+			{
+				value |= mWords[i + words + 1] << (64 - bits);
+			}
+			result.mWords[i] = value;
+		}
+		return result;
+	}
+
+	//Raw words, for hashing
+	const unsigned long long *getWords() const
+	{
+		return mWords;
+	}
+
+private:
+	//Clears the unused bits of the last word
+	void trim()
+	{
+		if (TILES % 64 != 0)
+		{
+			mWords[WORDS - 1] &= (1ULL << (TILES % 64)) - 1;
+		}
+	}
+
+	unsigned long long mWords[WORDS];
+};
+
+template <int W, int H>
+class BitEngine
+{
+public:
+	typedef BitSet<W, H> Bits;
+
+	//Initializes an empty board the frog may stand anywhere on
+	BitEngine()
+	{
+		for (int row = 0; row < H; row++)
+		{
+			for (int col = 0; col < W; col++)
+			{
+				playable.set(col, row);
+				if (col > 0)
+				{
+					mNotFirstCol.set(col, row);
+				}
+				if (col < W - 1)
+				{
+					mNotLastCol.set(col, row);
+				}
+			}
+		}
+	}
+
+	//Tiles the frog can't enter
+	Bits rocks;
+
+	//Tiles the frog may stand on at all
+	Bits playable;
+
+	//What stopping on a tile does
+	Bits home;
+	Bits bird;
+	Bits doors;
+	Bits safe;
+
+	//Tiles that are neither rocks nor off limits
+	Bits open() const
+	{
+		return playable.without(rocks);
+	}
+
+	//The set moved one tile, dropping tiles that leave the board
+	Bits shift(const Bits &bits, Command command) const
+	{
+		switch (command)
+		{
+		case COMMAND_UP: return bits.shiftedDown(W);
+		case COMMAND_DOWN: return bits.shiftedUp(W);
+		case COMMAND_LEFT: return (bits & mNotFirstCol).shiftedDown(1);
+		default: return (bits & mNotLastCol).shiftedUp(1);
+		}
+	}
+
+	//Every frog in the set tries a move; the blocked ones stay where they are
+	Bits move(const Bits &frogs, Command command) const
+	{
+		Bits free = open();
+		Bits moved = shift(frogs, command) & free;
+
+		//A frog stays when the tile it would move to isn't free
+		Command back = static_cast<Command>(command ^ 1);
+		Bits stayed = frogs.without(shift(free, back));
+		return moved | stayed;
+	}
+
+	//Every tile reachable from the start tiles by any number of moves
+	Bits reachable(const Bits &start) const
+	{
+		Bits free = open();
+		Bits reached = start & free;
+		for (;;)
+		{
+			Bits grown = reached | shift(reached, COMMAND_UP) | shift(reached, COMMAND_DOWN) | shift(reached, COMMAND_LEFT) | shift(reached, COMMAND_RIGHT);
+			grown = grown & free;
+			if (grown == reached)
+			{
+				return reached;
+			}
+			reached = grown;
+		}
+	}
+
+	//True when any frog in the set is on a rock or off limits
+	bool collides(const Bits &frogs) const
+	{
+		return frogs.without(open()).any();
+	}
+
+private:
+	Bits mNotFirstCol;
+	Bits mNotLastCol;
+};
+
+//The play area, with the command panel column off limits
+class FrogBitEngine : public BitEngine<BOARD_COLS, BOARD_ROWS>
+{
+public:
+	//Initializes an empty play area
+	FrogBitEngine()
+	{
+		for (int row = 0; row < BOARD_ROWS; row++)
+		{
+			for (int col = FROG_COLS; col < BOARD_COLS; col++)
+			{
+				playable.reset(col, row);
+			}
+		}
+	}
+};
@@ -0,0 +1,346 @@
+#include "blitkernels.h"
+#include <string.h>
+#if defined(_MSC_VER)
+#include <SDL.h>
+#else
+#include <SDL2/SDL.h>
+#endif
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define BLIT_X86 1
+#include <emmintrin.h>
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define BLIT_TARGET_SSE2
+#define BLIT_TARGET_AVX2
+#else
+#define BLIT_TARGET_SSE2 __attribute__((target("sse2")))
+#define BLIT_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM) || defined(_M_ARM64)
+#define BLIT_NEON 1
+#include <arm_neon.h>
+#endif
+
+//x / 255 rounded, exact for x in [0, 255 * 255]
+static inline uint32_t div255(uint32_t x)
+{
+	x += 128;
+	return (x + (x >> 8)) >> 8;
+}
+
+static inline uint32_t blendPixel(uint32_t d, uint32_t s)
+{
+	uint32_t a = s >> 24;
+	uint32_t ia = 255 - a;
+	uint32_t r = div255(((s >> 16) & 0xFF) * a + ((d >> 16) & 0xFF) * ia);
+	uint32_t g = div255(((s >> 8) & 0xFF) * a + ((d >> 8) & 0xFF) * ia);
+	uint32_t b = div255((s & 0xFF) * a + (d & 0xFF) * ia);
+	return 0xFF000000u | (r << 16) | (g << 8) | b;
+}
+
+static inline uint32_t bilinearPixel(uint32_t p00, uint32_t p01, uint32_t p10, uint32_t p11, uint32_t fx, uint32_t fy)
+{
+	uint32_t result = 0;
+	for (int shift = 0; shift < 32; shift += 8)
+	{
+		uint32_t top = ((p00 >> shift) & 0xFF) * (256 - fx) + ((p01 >> shift) & 0xFF) * fx;
+		uint32_t bottom = ((p10 >> shift) & 0xFF) * (256 - fx) + ((p11 >> shift) & 0xFF) * fx;
+		uint32_t value = ((top >> 8) * (256 - fy) + (bottom >> 8) * fy) >> 8;
+		result |= value << shift;
+	}
+	return result;
+}
+
+//Scalar kernels
+
+static void copyRowScalar(uint32_t *dst, const uint32_t *src, int count)
+{
+	memcpy(dst, src, count * sizeof(uint32_t));
+}
+
+static void blendRowScalar(uint32_t *dst, const uint32_t *src, int count)
+{
+	for (int i = 0; i < count; i++)
+	{
+		uint32_t s = src[i];
+		uint32_t a = s >> 24;
+		if (a == 255)
+		{
+			dst[i] = s;
+		}
+		else if (a != 0)
+		{
+			dst[i] = blendPixel(dst[i], s);
+		}
+	}
+}
+
+static void nearestRowScalar(uint32_t *dst, const uint32_t *src, const int *xIndex, int count)
+{
+	for (int i = 0; i < count; i++)
+	{
+		dst[i] = src[xIndex[i]];
+	}
+}
+
+static void bilinearRowScalar(uint32_t *dst, const uint32_t *row0, const uint32_t *row1, int fy,
+	const int *x0, const int *x1, const uint8_t *fx, int count)
+{
+	for (int i = 0; i < count; i++)
+	{
+		dst[i] = bilinearPixel(row0[x0[i]], row0[x1[i]], row1[x0[i]], row1[x1[i]], fx[i], fy);
+	}
+}
+
+#if defined(BLIT_X86)
+
+//SSE2 kernels, four pixels per step
+
+BLIT_TARGET_SSE2 static inline __m128i blendHalfSSE2(__m128i s, __m128i d, __m128i alpha255)
+{
+	//Broadcast each pixel's alpha across its four 16-bit channels
+	__m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+	__m128i ia = _mm_sub_epi16(alpha255, a);
+	__m128i x = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(s, a), _mm_mullo_epi16(d, ia)), _mm_set1_epi16(128));
+	return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+BLIT_TARGET_SSE2 static void blendRowSSE2(uint32_t *dst, const uint32_t *src, int count)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i alphaMask = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+	const __m128i alpha255 = _mm_set1_epi16(255);
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+		__m128i alpha = _mm_and_si128(s, alphaMask);
+
+		//Skip fully transparent runs and copy fully opaque ones
+		int transparent = _mm_movemask_epi8(_mm_cmpeq_epi32(alpha, zero));
+		if (transparent == 0xFFFF)
+		{
+			continue;
+		}
+		int opaque = _mm_movemask_epi8(_mm_cmpeq_epi32(alpha, alphaMask));
+		if (opaque == 0xFFFF)
+		{
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), s);
+			continue;
+		}
+
+		__m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst + i));
+		__m128i lo = blendHalfSSE2(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero), alpha255);
+		__m128i hi = blendHalfSSE2(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero), alpha255);
+		__m128i out = _mm_or_si128(_mm_packus_epi16(lo, hi), alphaMask);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), out);
+	}
+	blendRowScalar(dst + i, src + i, count - i);
+}
+
+BLIT_TARGET_SSE2 static void copyRowSSE2(uint32_t *dst, const uint32_t *src, int count)
+{
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i)));
+	}
+	for (; i < count; i++)
+	{
+		dst[i] = src[i];
+	}
+}
+
+BLIT_TARGET_SSE2 static void bilinearRowSSE2(uint32_t *dst, const uint32_t *row0, const uint32_t *row1, int fy,
+	const int *x0, const int *x1, const uint8_t *fx, int count)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i wy = _mm_unpacklo_epi64(_mm_set1_epi16(static_cast<short>(256 - fy)), _mm_set1_epi16(static_cast<short>(fy)));
+	for (int i = 0; i < count; i++)
+	{
+		//Left and right neighbours of both rows, one pixel per 16-bit quad
+		__m128i top = _mm_unpacklo_epi8(_mm_unpacklo_epi32(_mm_cvtsi32_si128(static_cast<int>(row0[x0[i]])),
+			_mm_cvtsi32_si128(static_cast<int>(row0[x1[i]]))), zero);
+		__m128i bottom = _mm_unpacklo_epi8(_mm_unpacklo_epi32(_mm_cvtsi32_si128(static_cast<int>(row1[x0[i]])),
+			_mm_cvtsi32_si128(static_cast<int>(row1[x1[i]]))), zero);
+		__m128i wx = _mm_unpacklo_epi64(_mm_set1_epi16(static_cast<short>(256 - fx[i])), _mm_set1_epi16(static_cast<short>(fx[i])));
+
+		//Horizontal pass, then fold the right half onto the left
+		top = _mm_mullo_epi16(top, wx);
+		bottom = _mm_mullo_epi16(bottom, wx);
+		top = _mm_srli_epi16(_mm_add_epi16(top, _mm_srli_si128(top, 8)), 8);
+		bottom = _mm_srli_epi16(_mm_add_epi16(bottom, _mm_srli_si128(bottom, 8)), 8);
+
+		//Vertical pass
+		__m128i both = _mm_mullo_epi16(_mm_unpacklo_epi64(top, bottom), wy);
+		both = _mm_srli_epi16(_mm_add_epi16(both, _mm_srli_si128(both, 8)), 8);
+		dst[i] = static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_packus_epi16(both, zero)));
+	}
+}
+
+//AVX2 kernels, eight pixels per step
+
+BLIT_TARGET_AVX2 static void blendRowAVX2(uint32_t *dst, const uint32_t *src, int count)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i alphaMask = _mm256_set1_epi32(static_cast<int>(0xFF000000u));
+	const __m256i alpha255 = _mm256_set1_epi16(255);
+	const __m256i half = _mm256_set1_epi16(128);
+	int i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+		__m256i alpha = _mm256_and_si256(s, alphaMask);
+		if (_mm256_testz_si256(alpha, alpha))
+		{
+			continue;
+		}
+		if (static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi32(alpha, alphaMask))) == 0xFFFFFFFFu)
+		{
+			_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), s);
+			continue;
+		}
+
+		__m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(dst + i));
+		__m256i sLo = _mm256_unpacklo_epi8(s, zero);
+		__m256i sHi = _mm256_unpackhi_epi8(s, zero);
+		__m256i dLo = _mm256_unpacklo_epi8(d, zero);
+		__m256i dHi = _mm256_unpackhi_epi8(d, zero);
+		__m256i aLo = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(sLo, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+		__m256i aHi = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(sHi, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+		__m256i lo = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(sLo, aLo), _mm256_mullo_epi16(dLo, _mm256_sub_epi16(alpha255, aLo))), half);
+		__m256i hi = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(sHi, aHi), _mm256_mullo_epi16(dHi, _mm256_sub_epi16(alpha255, aHi))), half);
+		lo = _mm256_srli_epi16(_mm256_add_epi16(lo, _mm256_srli_epi16(lo, 8)), 8);
+		hi = _mm256_srli_epi16(_mm256_add_epi16(hi, _mm256_srli_epi16(hi, 8)), 8);
+		__m256i out = _mm256_or_si256(_mm256_packus_epi16(lo, hi), alphaMask);
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), out);
+	}
+	blendRowSSE2(dst + i, src + i, count - i);
+}
+
+BLIT_TARGET_AVX2 static void nearestRowAVX2(uint32_t *dst, const uint32_t *src, const int *xIndex, int count)
+{
+	int i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256i index = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(xIndex + i));
+		__m256i pixels = _mm256_i32gather_epi32(reinterpret_cast<const int *>(src), index, 4);
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), pixels);
+	}
+	nearestRowScalar(dst + i, src, xIndex + i, count - i);
+}
+
+static bool cpuHasAVX2()
+{
+	//SDL_HasAVX also checks that the OS saves the YMM registers
+	if (!SDL_HasAVX())
+	{
+		return false;
+	}
+#if defined(_MSC_VER)
+	int regs[4];
+	__cpuidex(regs, 7, 0);
+	return (regs[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+
+#endif
+
+#if defined(BLIT_NEON)
+
+//NEON kernels, eight pixels per step
+
+static void blendRowNEON(uint32_t *dst, const uint32_t *src, int count)
+{
+	int i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		uint8x8x4_t s = vld4_u8(reinterpret_cast<const uint8_t *>(src + i));
+		uint8x8_t a = s.val[3];
+		uint64_t alphaBits = vget_lane_u64(vreinterpret_u64_u8(a), 0);
+		if (alphaBits == 0)
+		{
+			continue;
+		}
+		if (alphaBits == 0xFFFFFFFFFFFFFFFFull)
+		{
+			vst4_u8(reinterpret_cast<uint8_t *>(dst + i), s);
+			continue;
+		}
+
+		uint8x8x4_t d = vld4_u8(reinterpret_cast<const uint8_t *>(dst + i));
+		uint8x8_t ia = vmvn_u8(a);
+		for (int c = 0; c < 3; c++)
+		{
+			uint16x8_t x = vmlal_u8(vmull_u8(s.val[c], a), d.val[c], ia);
+			d.val[c] = vrshrn_n_u16(vrsraq_n_u16(x, x, 8), 8);
+		}
+		d.val[3] = vdup_n_u8(255);
+		vst4_u8(reinterpret_cast<uint8_t *>(dst + i), d);
+	}
+	blendRowScalar(dst + i, src + i, count - i);
+}
+
+static void bilinearRowNEON(uint32_t *dst, const uint32_t *row0, const uint32_t *row1, int fy,
+	const int *x0, const int *x1, const uint8_t *fx, int count)
+{
+	for (int i = 0; i < count; i++)
+	{
+		uint32_t topPair[2] = { row0[x0[i]], row0[x1[i]] };
+		uint32_t bottomPair[2] = { row1[x0[i]], row1[x1[i]] };
+		uint16x8_t top = vmovl_u8(vreinterpret_u8_u32(vld1_u32(topPair)));
+		uint16x8_t bottom = vmovl_u8(vreinterpret_u8_u32(vld1_u32(bottomPair)));
+		uint16x8_t wx = vcombine_u16(vdup_n_u16(static_cast<uint16_t>(256 - fx[i])), vdup_n_u16(fx[i]));
+
+		top = vmulq_u16(top, wx);
+		bottom = vmulq_u16(bottom, wx);
+		uint16x4_t t = vshr_n_u16(vadd_u16(vget_low_u16(top), vget_high_u16(top)), 8);
+		uint16x4_t b = vshr_n_u16(vadd_u16(vget_low_u16(bottom), vget_high_u16(bottom)), 8);
+
+		uint16x4_t v = vshr_n_u16(vadd_u16(vmul_n_u16(t, static_cast<uint16_t>(256 - fy)), vmul_n_u16(b, static_cast<uint16_t>(fy))), 8);
+		dst[i] = vget_lane_u32(vreinterpret_u32_u8(vmovn_u16(vcombine_u16(v, v))), 0);
+	}
+}
+
+#endif
+
+const BlitKernels &getScalarBlitKernels()
+{
+	static const BlitKernels scalar = { copyRowScalar, blendRowScalar, nearestRowScalar, bilinearRowScalar, "scalar" };
+	return scalar;
+}
+
+static BlitKernels pickBlitKernels()
+{
+	BlitKernels kernels = getScalarBlitKernels();
+#if defined(BLIT_X86)
+	if (SDL_HasSSE2())
+	{
+		kernels.copyRow = copyRowSSE2;
+		kernels.blendRow = blendRowSSE2;
+		kernels.bilinearRow = bilinearRowSSE2;
+		kernels.name = "SSE2";
+		if (cpuHasAVX2())
+		{
+			kernels.blendRow = blendRowAVX2;
+			kernels.nearestRow = nearestRowAVX2;
+			kernels.name = "AVX2";
+		}
+	}
+#elif defined(BLIT_NEON)
+	kernels.blendRow = blendRowNEON;
+	kernels.bilinearRow = bilinearRowNEON;
+	kernels.name = "NEON";
+#endif
+	return kernels;
+}
+
+const BlitKernels &getBlitKernels()
+{
+	static const BlitKernels best = pickBlitKernels();
+	return best;
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <stdint.h>
+
+/*
+* Row kernels for the CPU compositor. All pixels are ARGB8888 with straight
+* alpha and the destination is always opaque.
+*/
+
+//Copies count opaque pixels
+typedef void (*BlitCopyRowFn)(uint32_t *dst, const uint32_t *src, int count);
+
+//Blends count pixels over the destination using the source alpha
+typedef void (*BlitBlendRowFn)(uint32_t *dst, const uint32_t *src, int count);
+
+//Writes src[xIndex[i]] to dst[i]
+typedef void (*BlitNearestRowFn)(uint32_t *dst, const uint32_t *src, const int *xIndex, int count);
+
+//Filters between two source rows, fy and fx are 0-255 weights of row1 and x1
+typedef void (*BlitBilinearRowFn)(uint32_t *dst, const uint32_t *row0, const uint32_t *row1, int fy,
+	const int *x0, const int *x1, const uint8_t *fx, int count);
+
+struct BlitKernels
+{
+	BlitCopyRowFn copyRow;
+	BlitBlendRowFn blendRow;
+	BlitNearestRowFn nearestRow;
+	BlitBilinearRowFn bilinearRow;
+
+	//Instruction set the kernels were picked for, for logging
+	const char *name;
+};
+
+//Fastest kernels the running CPU supports
+const BlitKernels &getBlitKernels();
+
+//Portable kernels, used where no SIMD set is available
+const BlitKernels &getScalarBlitKernels();
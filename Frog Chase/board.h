@@ -0,0 +1,24 @@
+#pragma once
+
+/*
+* Dimensions of the play area shared by the game, its rules and its tools
+*/
+
+//Screen attributes
+const int SCREEN_WIDTH = 1024;
+const int SCREEN_HEIGHT = 728;
+
+// Scaling the tiles to be 80x80
+const int TILE_SIZE = 80;
+
+//Tiles across and down the play area
+const int BOARD_COLS = 12;
+const int BOARD_ROWS = 9;
+
+//Where the frog's top left corner sits inside its tile
+const int FROG_OFFSET_X = 20;
+const int FROG_OFFSET_Y = 30;
+
+//Tiles the frog can stand on; the command panel covers the last column
+const int FROG_COLS = 11;
+const int FROG_ROWS = 9;
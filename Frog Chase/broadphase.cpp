@@ -0,0 +1,109 @@
+#include "broadphase.h"
+#include <math.h>
+
+SweepAndPrune::SweepAndPrune()
+{
+	mSorted = true;
+	mRemoved = 0;
+}
+
+int SweepAndPrune::add(const Box &box)
+{
+	int handle;
+	if (!mFreeHandles.empty())
+	{
+		handle = mFreeHandles.back();
+		mFreeHandles.pop_back();
+	}
+	else
+	{
+		handle = static_cast<int>(mPosition.size());
+		mPosition.push_back(-1);
+	}
+
+	//Goes on the end, the next sort moves it into place
+	Proxy proxy;
+	proxy.handle = handle;
+	proxy.removed = false;
+	mPosition[handle] = static_cast<int>(mProxies.size());
+	mProxies.push_back(proxy);
+	update(handle, box);
+	return handle;
+}
+
+void SweepAndPrune::remove(int handle)
+{
+	//Counting a proxy twice would make the next sort drop a live one too
+	if (handle < 0 || handle >= static_cast<int>(mPosition.size()) || mPosition[handle] < 0 || mProxies[mPosition[handle]].removed)
+	{
+		return;
+	}
+	Proxy &proxy = mProxies[mPosition[handle]];
+
+	//Sorts to the end, where the next sort drops it
+	proxy.removed = true;
+	proxy.minX = INFINITY;
+	proxy.maxX = INFINITY;
+	proxy.minY = INFINITY;
+	proxy.maxY = -INFINITY;
+	mRemoved++;
+	mSorted = false;
+}
+
+void SweepAndPrune::update(int handle, const Box &box)
+{
+	if (handle < 0 || handle >= static_cast<int>(mPosition.size()) || mPosition[handle] < 0 || mProxies[mPosition[handle]].removed)
+	{
+		return;
+	}
+	Proxy &proxy = mProxies[mPosition[handle]];
+	proxy.minX = box.x;
+	proxy.maxX = box.x + box.w;
+	proxy.minY = box.y;
+	proxy.maxY = box.y + box.h;
+	mSorted = false;
+}
+
+int SweepAndPrune::getCount() const
+{
+	return static_cast<int>(mProxies.size()) - mRemoved;
+}
+
+void SweepAndPrune::sort()
+{
+	if (mSorted)
+	{
+		return;
+	}
+
+	//Insertion sort, linear when the list is nearly in order already
+	for (size_t i = 1; i < mProxies.size(); i++)
+	{
+		if (!(mProxies[i].minX < mProxies[i - 1].minX))
+		{
+			continue;
+		}
+
+		Proxy moving = mProxies[i];
+		size_t j = i;
+		while (j > 0 && moving.minX < mProxies[j - 1].minX)
+		{
+			mProxies[j] = mProxies[j - 1];
+			mPosition[mProxies[j].handle] = static_cast<int>(j);
+			j--;
+		}
+		mProxies[j] = moving;
+		mPosition[moving.handle] = static_cast<int>(j);
+	}
+
+	//Removed proxies have an infinite left edge, so they're all at the end
+	while (mRemoved > 0)
+	{
+		int handle = mProxies.back().handle;
+		mPosition[handle] = -1;
+		mFreeHandles.push_back(handle);
+		mProxies.pop_back();
+		mRemoved--;
+	}
+	mSorted = true;
+}
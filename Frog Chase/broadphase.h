@@ -0,0 +1,83 @@
+#pragma once
+#include <stddef.h>
+#include <vector>
+#include "collision.h"
+
+/*
+* Sort-and-sweep broad phase for moving entities. Boxes are kept sorted by
+* their left edge; since entities move a little each frame the order is
+* repaired with an insertion sort, which is close to free when few boxes
+* swap places. Sweeping the sorted list then only compares boxes whose x
+* ranges overlap and hands each candidate pair to a narrow phase.
+*/
+class SweepAndPrune
+{
+public:
+	//Initializes variables
+	SweepAndPrune();
+
+	//Adds an entity, returns the handle used to update or remove it
+	int add(const Box &box);
+
+	//Removes an entity, its handle may be reused; removing it again does nothing
+	void remove(int handle);
+
+	//Moves an entity's box, ignored once the entity is removed
+	void update(int handle, const Box &box);
+
+	//Number of entities
+	int getCount() const;
+
+	//Calls narrow(handleA, handleB) for every pair whose boxes overlap
+	template <class NarrowPhase>
+	void findPairs(NarrowPhase &narrow);
+
+private:
+	struct Proxy
+	{
+		float minX;
+		float maxX;
+		float minY;
+		float maxY;
+		int handle;
+
+		//Waiting for the next sort to drop it
+		bool removed;
+	};
+
+	//Repairs the order after moves, then drops removed entities off the end
+	void sort();
+
+	//Proxies by left edge
+	std::vector<Proxy> mProxies;
+
+	//Where each handle's proxy is in mProxies, -1 when free
+	std::vector<int> mPosition;
+	std::vector<int> mFreeHandles;
+
+	//Nothing moved since the last sort
+	bool mSorted;
+	int mRemoved;
+};
+
+template <class NarrowPhase>
+void SweepAndPrune::findPairs(NarrowPhase &narrow)
+{
+	sort();
+
+	size_t count = mProxies.size();
+	for (size_t i = 0; i < count; i++)
+	{
+		const Proxy &a = mProxies[i];
+
+		//Everything after j starts right of a, so the inner loop stops early
+		for (size_t j = i + 1; j < count && mProxies[j].minX < a.maxX; j++)
+		{
+			const Proxy &b = mProxies[j];
+			if (b.minY < a.maxY && a.minY < b.maxY)
+			{
+				narrow(a.handle, b.handle);
+			}
+		}
+	}
+}
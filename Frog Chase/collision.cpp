@@ -0,0 +1,126 @@
+#include "collision.h"
+#include <math.h>
+
+RockGrid::RockGrid()
+{
+	clear();
+}
+
+void RockGrid::clear()
+{
+	for (int row = 0; row < BOARD_ROWS; row++)
+	{
+		mRows[row] = 0;
+	}
+}
+
+void RockGrid::set(int col, int row)
+{
+	if (col >= 0 && col < BOARD_COLS && row >= 0 && row < BOARD_ROWS)
+	{
+		mRows[row] |= static_cast<unsigned short>(1u << col);
+	}
+}
+
+void RockGrid::reset(int col, int row)
+{
+	if (col >= 0 && col < BOARD_COLS && row >= 0 && row < BOARD_ROWS)
+	{
+		mRows[row] &= static_cast<unsigned short>(~(1u << col));
+	}
+}
+
+bool RockGrid::isSolid(int col, int row) const
+{
+	if (col < 0 || col >= BOARD_COLS || row < 0 || row >= BOARD_ROWS)
+	{
+		return false;
+	}
+	return (mRows[row] >> col & 1u) != 0;
+}
+
+//Entry and exit times of one axis, infinite when the axis doesn't move
+static void axisTimes(float start, float size, float move, float obstacle, float obstacleSize, float &entry, float &exit)
+{
+	float nearGap = move >= 0.0f ? obstacle - (start + size) : (obstacle + obstacleSize) - start;
+	float farGap = move >= 0.0f ? (obstacle + obstacleSize) - start : obstacle - (start + size);
+	if (move != 0.0f)
+	{
+		entry = nearGap / move;
+		exit = farGap / move;
+		return;
+	}
+
+	//Standing still on this axis: always inside the slab or never
+	bool inside = start + size > obstacle && start < obstacle + obstacleSize;
+	entry = inside ? -INFINITY : INFINITY;
+	exit = inside ? INFINITY : -INFINITY;
+}
+
+SweepHit sweepBox(const Box &a, float dx, float dy, const Box &b)
+{
+	SweepHit hit;
+	hit.time = 1.0f;
+	hit.normalX = 0;
+	hit.normalY = 0;
+
+	float entryX, exitX, entryY, exitY;
+	axisTimes(a.x, a.w, dx, b.x, b.w, entryX, exitX);
+	axisTimes(a.y, a.h, dy, b.y, b.h, entryY, exitY);
+
+	float entry = entryX > entryY ? entryX : entryY;
+	float exit = exitX < exitY ? exitX : exitY;
+
+	//No contact inside the move, or already overlapping at the start
+	if (entry > exit || entry < 0.0f || entry >= 1.0f)
+	{
+		return hit;
+	}
+
+	hit.time = entry;
+	if (entryX > entryY)
+	{
+		hit.normalX = dx > 0.0f ? -1 : 1;
+	}
+	else
+	{
+		hit.normalY = dy > 0.0f ? -1 : 1;
+	}
+	return hit;
+}
+
+SweepHit sweepGrid(const Box &a, float dx, float dy, const RockGrid &grid)
+{
+	SweepHit best;
+	best.time = 1.0f;
+	best.normalX = 0;
+	best.normalY = 0;
+
+	//Only tiles under the box's path can be touched
+	float left = dx < 0.0f ? a.x + dx : a.x;
+	float right = dx > 0.0f ? a.x + a.w + dx : a.x + a.w;
+	float top = dy < 0.0f ? a.y + dy : a.y;
+	float bottom = dy > 0.0f ? a.y + a.h + dy : a.y + a.h;
+	int firstCol = static_cast<int>(floorf(left / TILE_SIZE));
+	int lastCol = static_cast<int>(floorf(right / TILE_SIZE));
+	int firstRow = static_cast<int>(floorf(top / TILE_SIZE));
+	int lastRow = static_cast<int>(floorf(bottom / TILE_SIZE));
+
+	for (int row = firstRow; row <= lastRow; row++)
+	{
+		for (int col = firstCol; col <= lastCol; col++)
+		{
+			if (!grid.isSolid(col, row))
+			{
+				continue;
+			}
+			Box tile = { static_cast<float>(col * TILE_SIZE), static_cast<float>(row * TILE_SIZE), static_cast<float>(TILE_SIZE), static_cast<float>(TILE_SIZE) };
+			SweepHit hit = sweepBox(a, dx, dy, tile);
+			if (hit.time < best.time)
+			{
+				best = hit;
+			}
+		}
+	}
+	return best;
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include "board.h"
+
+/*
+* Swept axis-aligned box collision. Instead of moving and checking the
+* destination, a move is traced from start to end and stops at the first
+* contact, so no move can step over a rock however large it is.
+*/
+
+//Axis-aligned box in pixels
+struct Box
+{
+	float x;
+	float y;
+	float w;
+	float h;
+};
+
+//Where a swept move first touched something
+struct SweepHit
+{
+	//Fraction of the move made before contact, 1 when nothing was hit
+	float time;
+
+	//Direction pushing back out of the obstacle, zero when nothing was hit
+	int normalX;
+	int normalY;
+};
+
+//Which tiles hold a rock, one bit per column
+class RockGrid
+{
+public:
+	//Initializes an empty grid
+	RockGrid();
+
+	//Removes every rock
+	void clear();
+
+	//Puts a rock on a tile, tiles outside the board are ignored
+	void set(int col, int row);
+
+	//Takes the rock off a tile
+	void reset(int col, int row);
+
+	//True when the tile holds a rock
+	bool isSolid(int col, int row) const;
+
+private:
+	unsigned short mRows[BOARD_ROWS];
+};
+
+/**
+* Sweeps a moving box against a still one
+* @param a The moving box at the start of the move
+* @param dx The horizontal distance moved
+* @param dy The vertical distance moved
+* @param b The still box
+* @return the time and normal of contact; boxes that already overlap are not hits
+*/
+SweepHit sweepBox(const Box &a, float dx, float dy, const Box &b);
+
+/**
+* Sweeps a moving box against every rock of a grid of TILE_SIZE tiles
+* @param a The moving box at the start of the move
+* @param dx The horizontal distance moved
+* @param dy The vertical distance moved
+* @param grid The rocks
+* @return the earliest contact
+*/
+SweepHit sweepGrid(const Box &a, float dx, float dy, const RockGrid &grid);
@@ -0,0 +1,141 @@
+#include "collisionmask.h"
+
+CollisionMask::CollisionMask()
+{
+	mWidth = 0;
+	mHeight = 0;
+	mWordsPerRow = 0;
+}
+
+void CollisionMask::build(SDL_Surface *surface, int threshold)
+{
+	mWidth = 0;
+	mHeight = 0;
+	mWordsPerRow = 0;
+	mBits.clear();
+	if (surface == NULL || surface->format->format != SDL_PIXELFORMAT_ARGB8888)
+	{
+		return;
+	}
+
+	mWidth = surface->w;
+	mHeight = surface->h;
+	mWordsPerRow = (mWidth + 63) / 64;
+	mBits.assign(mWordsPerRow * mHeight, 0);
+
+	SDL_LockSurface(surface);
+	for (int y = 0; y < mHeight; y++)
+	{
+		const Uint32 *row = reinterpret_cast<const Uint32 *>(static_cast<const Uint8 *>(surface->pixels) + y * surface->pitch);
+		Uint64 *bits = &mBits[y * mWordsPerRow];
+		for (int x = 0; x < mWidth; x++)
+		{
+			if (static_cast<int>(row[x] >> 24) >= threshold)
+			{
+				bits[x >> 6] |= static_cast<Uint64>(1) << (x & 63);
+			}
+		}
+	}
+	SDL_UnlockSurface(surface);
+}
+
+void CollisionMask::buildScaled(const CollisionMask &source, int w, int h)
+{
+	mWidth = w > 0 ? w : 0;
+	mHeight = h > 0 ? h : 0;
+	mWordsPerRow = (mWidth + 63) / 64;
+	mBits.assign(mWordsPerRow * mHeight, 0);
+	if (source.mWidth == 0 || source.mHeight == 0)
+	{
+		return;
+	}
+
+	for (int y = 0; y < mHeight; y++)
+	{
+		int sy = ((2 * y + 1) * source.mHeight) / (2 * mHeight);
+		Uint64 *bits = &mBits[y * mWordsPerRow];
+		for (int x = 0; x < mWidth; x++)
+		{
+			int sx = ((2 * x + 1) * source.mWidth) / (2 * mWidth);
+			if (source.isSolid(sx, sy))
+			{
+				bits[x >> 6] |= static_cast<Uint64>(1) << (x & 63);
+			}
+		}
+	}
+}
+
+int CollisionMask::getWidth() const
+{
+	return mWidth;
+}
+
+int CollisionMask::getHeight() const
+{
+	return mHeight;
+}
+
+bool CollisionMask::isSolid(int x, int y) const
+{
+	if (x < 0 || x >= mWidth || y < 0 || y >= mHeight)
+	{
+		return false;
+	}
+	return (mBits[y * mWordsPerRow + (x >> 6)] >> (x & 63) & 1) != 0;
+}
+
+Uint64 CollisionMask::extract(int y, int x) const
+{
+	if (x >= mWidth || x <= -64)
+	{
+		return 0;
+	}
+
+	const Uint64 *row = &mBits[y * mWordsPerRow];
+	if (x < 0)
+	{
+		return row[0] << -x;
+	}
+
+	int word = x >> 6;
+	int shift = x & 63;
+	Uint64 bits = row[word] >> shift;
+	if (shift != 0 && word + 1 < mWordsPerRow)
+	{
+		bits |= row[word + 1] << (64 - shift);
+	}
+	return bits;
+}
+
+bool CollisionMask::overlaps(const CollisionMask &a, int ax, int ay, const CollisionMask &b, int bx, int by)
+{
+	//Broad phase: the boxes have to overlap first
+	int left = ax > bx ? ax : bx;
+	int right = ax + a.mWidth < bx + b.mWidth ? ax + a.mWidth : bx + b.mWidth;
+	int top = ay > by ? ay : by;
+	int bottom = ay + a.mHeight < by + b.mHeight ? ay + a.mHeight : by + b.mHeight;
+	if (left >= right || top >= bottom)
+	{
+		return false;
+	}
+
+	//Narrow phase: walk a's words across the overlap, pulling b's bits into line
+	int firstWord = (left - ax) >> 6;
+	int lastWord = (right - ax - 1) >> 6;
+	for (int y = top; y < bottom; y++)
+	{
+		const Uint64 *rowA = &a.mBits[(y - ay) * a.mWordsPerRow];
+		for (int word = firstWord; word <= lastWord; word++)
+		{
+			if (rowA[word] == 0)
+			{
+				continue;
+			}
+			if ((rowA[word] & b.extract(y - by, word * 64 + ax - bx)) != 0)
+			{
+				return true;
+			}
+		}
+	}
+	return false;
+}
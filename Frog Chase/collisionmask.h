@@ -0,0 +1,47 @@
+#pragma once
+#include <vector>
+#if defined(_MSC_VER)
+#include <SDL.h>
+#else
+#include <SDL2/SDL.h>
+#endif
+
+/*
+* One bit per pixel of a sprite's alpha, 64 pixels to a word. Two masks are
+* tested by shifting one's words into line with the other's and ANDing them,
+* a few dozen word operations for a sprite sized overlap.
+*/
+class CollisionMask
+{
+public:
+	//Alpha at or above which a pixel is solid
+	static const int DEFAULT_THRESHOLD = 128;
+
+	//Initializes an empty mask
+	CollisionMask();
+
+	//Builds the mask from an ARGB8888 surface
+	void build(SDL_Surface *surface, int threshold = DEFAULT_THRESHOLD);
+
+	//Builds a nearest-neighbour scaled copy of another mask
+	void buildScaled(const CollisionMask &source, int w, int h);
+
+	//Gets mask dimensions
+	int getWidth() const;
+	int getHeight() const;
+
+	//True when the pixel is solid, false outside the mask
+	bool isSolid(int x, int y) const;
+
+	//True when a at (ax, ay) and b at (bx, by) share a solid pixel
+	static bool overlaps(const CollisionMask &a, int ax, int ay, const CollisionMask &b, int bx, int by);
+
+private:
+	//64 bits of a row starting at pixel x, zero past either edge
+	Uint64 extract(int y, int x) const;
+
+	int mWidth;
+	int mHeight;
+	int mWordsPerRow;
+	std::vector<Uint64> mBits;
+};
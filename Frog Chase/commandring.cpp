@@ -0,0 +1,124 @@
+#include "commandring.h"
+#include <string.h>
+
+//Word and shift of the slot a free running count maps to
+static unsigned slotWord(unsigned count)
+{
+	return (count % COMMAND_RING_CAPACITY) / COMMANDS_PER_WORD;
+}
+
+static unsigned slotShift(unsigned count)
+{
+	return (count % COMMANDS_PER_WORD) * 2;
+}
+
+CommandRing::CommandRing()
+{
+	//Initialize
+	memset(mWords, 0, sizeof(mWords));
+	mHead = 0;
+	mTail = 0;
+}
+
+bool CommandRing::push(Command command)
+{
+	if (full())
+	{
+		return false;
+	}
+	unsigned &word = mWords[slotWord(mHead)];
+	unsigned shift = slotShift(mHead);
+	word = (word & ~(3u << shift)) | (static_cast<unsigned>(command) << shift);
+	mHead++;
+	return true;
+}
+
+bool CommandRing::pop(Command &command)
+{
+	if (empty())
+	{
+		return false;
+	}
+	command = peek(0);
+	mTail++;
+	return true;
+}
+
+Command CommandRing::peek(unsigned index) const
+{
+	unsigned count = mTail + index;
+	return static_cast<Command>((mWords[slotWord(count)] >> slotShift(count)) & 3);
+}
+
+unsigned CommandRing::size() const
+{
+	return mHead - mTail;
+}
+
+bool CommandRing::empty() const
+{
+	return mHead == mTail;
+}
+
+bool CommandRing::full() const
+{
+	return mHead - mTail == COMMAND_RING_CAPACITY;
+}
+
+void CommandRing::clear()
+{
+	mTail = mHead;
+}
+
+ConcurrentCommandRing::ConcurrentCommandRing()
+	: mHead(0), mTail(0)
+{
+	for (unsigned i = 0; i < COMMAND_RING_CAPACITY / COMMANDS_PER_WORD; i++)
+	{
+		mWords[i].store(0, std::memory_order_relaxed);
+	}
+}
+
+bool ConcurrentCommandRing::push(Command command)
+{
+	unsigned head = mHead.load(std::memory_order_relaxed);
+	if (head - mTail.load(std::memory_order_acquire) == COMMAND_RING_CAPACITY)
+	{
+		return false;
+	}
+
+	//The consumer may be reading other slots of the same word
+	std::atomic<unsigned> &word = mWords[slotWord(head)];
+	unsigned shift = slotShift(head);
+	word.fetch_and(~(3u << shift), std::memory_order_relaxed);
+	word.fetch_or(static_cast<unsigned>(command) << shift, std::memory_order_relaxed);
+
+	//Publishes the slot to the consumer
+	mHead.store(head + 1, std::memory_order_release);
+	return true;
+}
+
+bool ConcurrentCommandRing::pop(Command &command)
+{
+	unsigned tail = mTail.load(std::memory_order_relaxed);
+	if (tail == mHead.load(std::memory_order_acquire))
+	{
+		return false;
+	}
+	unsigned word = mWords[slotWord(tail)].load(std::memory_order_relaxed);
+	command = static_cast<Command>((word >> slotShift(tail)) & 3);
+
+	//Hands the slot back to the producer
+	mTail.store(tail + 1, std::memory_order_release);
+	return true;
+}
+
+unsigned ConcurrentCommandRing::size() const
+{
+	return mHead.load(std::memory_order_acquire) - mTail.load(std::memory_order_relaxed);
+}
+
+void ConcurrentCommandRing::clear()
+{
+	mTail.store(mHead.load(std::memory_order_acquire), std::memory_order_release);
+}
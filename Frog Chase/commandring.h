@@ -0,0 +1,90 @@
+#pragma once
+#include <atomic>
+
+/*
+* Queued commands packed two bits each into a fixed ring, so a program
+* thousands of steps long takes a few hundred bytes and never touches the
+* heap. ConcurrentCommandRing is the same ring for one thread capturing input
+* while another runs it.
+*/
+
+enum Command
+{
+	COMMAND_UP,
+	COMMAND_DOWN,
+	COMMAND_LEFT,
+	COMMAND_RIGHT
+};
+
+//Commands a ring holds, a power of two; 2048 of them pack into 512 bytes
+const unsigned COMMAND_RING_CAPACITY = 2048;
+
+//Two bits per command
+const unsigned COMMANDS_PER_WORD = 16;
+
+//Tiles each command moves the frog across and down
+const int COMMAND_DX[] = { 0, 0, -1, 1 };
+const int COMMAND_DY[] = { -1, 1, 0, 0 };
+
+//What the HUD shows for each command
+const char COMMAND_SYMBOLS[] = { '^', 'v', '<', '>' };
+
+class CommandRing
+{
+public:
+	//Initializes variables
+	CommandRing();
+
+	//Adds a command at the back; false when the ring is full
+	bool push(Command command);
+
+	//Removes the oldest command; false when the ring is empty
+	bool pop(Command &command);
+
+	//The command index places from the front, 0 being the next to run
+	Command peek(unsigned index) const;
+
+	//Number of commands queued
+	unsigned size() const;
+
+	bool empty() const;
+	bool full() const;
+
+	//Drops every command
+	void clear();
+
+private:
+	unsigned mWords[COMMAND_RING_CAPACITY / COMMANDS_PER_WORD];
+
+	//Free running counts of commands pushed and popped
+	unsigned mHead;
+	unsigned mTail;
+};
+
+class ConcurrentCommandRing
+{
+public:
+	//Initializes variables
+	ConcurrentCommandRing();
+
+	//Producer thread only: adds a command; false when the ring is full
+	bool push(Command command);
+
+	//Consumer thread only: removes the oldest command; false when empty
+	bool pop(Command &command);
+
+	//Number of commands queued, exact only on the consumer thread
+	unsigned size() const;
+
+	//Consumer thread only: drops every command pushed so far
+	void clear();
+
+private:
+	//Packed commands; the producer only writes slots the consumer has freed,
+	//but the slots share words so every access is atomic
+	std::atomic<unsigned> mWords[COMMAND_RING_CAPACITY / COMMANDS_PER_WORD];
+
+	//Written only by the producer, then only by the consumer
+	std::atomic<unsigned> mHead;
+	std::atomic<unsigned> mTail;
+};
@@ -0,0 +1,476 @@
+#include "compositor.h"
+#include <algorithm>
+#include <string.h>
+#include "alloctrack.h"
+#include "imagescan.h"
+#include "jobs.h"
+
+Compositor gCompositor;
+
+Compositor::Compositor()
+{
+	//Initialize
+	mRenderer = NULL;
+	mTarget = NULL;
+	mWidth = 0;
+	mHeight = 0;
+	mActive = false;
+	mLinear = false;
+	mKernels = &getScalarBlitKernels();
+	mBandHeight = 0;
+	mRedrawnPixels = 0;
+}
+
+Compositor::~Compositor()
+{
+	//Deallocate
+	free();
+}
+
+bool Compositor::init(SDL_Renderer *ren, int w, int h)
+{
+	free();
+
+	//Only worth it when SDL would do the work on the CPU anyway
+	SDL_RendererInfo info;
+	if (SDL_GetRendererInfo(ren, &info) != 0 || (info.flags & SDL_RENDERER_SOFTWARE) == 0)
+	{
+		return false;
+	}
+
+	mTarget = SDL_CreateTexture(ren, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, w, h);
+	if (mTarget == NULL)
+	{
+		return false;
+	}
+	mFrame.assign(w * h, 0xFF000000u);
+	mDamage.reset(w, h);
+
+	//Two bands per core keeps the workers busy when the draws are uneven
+	int bands = 2 * (gJobs.getWorkerCount() + 1);
+	mBandHeight = ((h + bands - 1) / bands + 7) & ~7;
+	bands = (h + mBandHeight - 1) / mBandHeight;
+	mBins.assign(bands, std::vector<int>());
+	mBandScratch.assign(bands, RasterScratch());
+
+	const char *quality = SDL_GetHint(SDL_HINT_RENDER_SCALE_QUALITY);
+	mLinear = quality != NULL && (strcmp(quality, "1") == 0 || strcmp(quality, "2") == 0 || strcmp(quality, "linear") == 0 || strcmp(quality, "best") == 0);
+
+	mRenderer = ren;
+	mWidth = w;
+	mHeight = h;
+	mKernels = &getBlitKernels();
+	mActive = true;
+
+	SDL_Log("Software renderer detected, compositing on the CPU with %s kernels", mKernels->name);
+	return true;
+}
+
+void Compositor::free()
+{
+	for (std::map<SDL_Texture *, CpuImage *>::iterator it = mImages.begin(); it != mImages.end(); ++it)
+	{
+		delete it->second;
+	}
+	mImages.clear();
+	mCommands.clear();
+	mLateDraws.clear();
+	mLastCommands.clear();
+	mFrame.clear();
+	mBins.clear();
+	mBandScratch.clear();
+
+	if (mTarget != NULL)
+	{
+		SDL_DestroyTexture(mTarget);
+		mTarget = NULL;
+	}
+	mRenderer = NULL;
+	mActive = false;
+}
+
+bool Compositor::isActive()
+{
+	return mActive;
+}
+
+void Compositor::registerImage(SDL_Texture *tex, SDL_Surface *surface)
+{
+	if (!mActive || tex == NULL || surface == NULL)
+	{
+		return;
+	}
+
+	SDL_Surface *converted = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_ARGB8888, 0);
+	if (converted == NULL)
+	{
+		return;
+	}
+
+	ImageScan scan = scanSurface(converted);
+
+	CpuImage *image = new CpuImage();
+	image->w = converted->w;
+	image->h = converted->h;
+	image->pixels.resize(image->w * image->h);
+	image->opaque = scan.opaque;
+
+	SDL_LockSurface(converted);
+	for (int y = 0; y < image->h; y++)
+	{
+		const Uint32 *row = reinterpret_cast<const Uint32 *>(static_cast<const Uint8 *>(converted->pixels) + y * converted->pitch);
+		memcpy(&image->pixels[y * image->w], row, image->w * sizeof(Uint32));
+	}
+	SDL_UnlockSurface(converted);
+	SDL_FreeSurface(converted);
+
+	//Mostly transparent sprites only blend their visible runs
+	if (scan.transparentPercent >= RLE_TRANSPARENT_PERCENT)
+	{
+		image->rowRuns.resize(image->h + 1);
+		for (int y = 0; y < image->h; y++)
+		{
+			image->rowRuns[y] = static_cast<int>(image->runs.size());
+			const Uint32 *row = &image->pixels[y * image->w];
+			int x = 0;
+			while (x < image->w)
+			{
+				while (x < image->w && (row[x] >> 24) == 0)
+				{
+					x++;
+				}
+				int start = x;
+				while (x < image->w && (row[x] >> 24) != 0)
+				{
+					x++;
+				}
+				if (x > start)
+				{
+					image->runs.push_back(static_cast<Uint16>(start));
+					image->runs.push_back(static_cast<Uint16>(x - start));
+				}
+			}
+		}
+		image->rowRuns[image->h] = static_cast<int>(image->runs.size());
+	}
+
+	unregisterImage(tex);
+	mImages[tex] = image;
+}
+
+void Compositor::unregisterImage(SDL_Texture *tex)
+{
+	std::map<SDL_Texture *, CpuImage *>::iterator it = mImages.find(tex);
+	if (it != mImages.end())
+	{
+		delete it->second;
+		mImages.erase(it);
+
+		//A new image may reuse the address, so old draws can't be trusted
+		mDamage.addAll();
+	}
+}
+
+void Compositor::clear()
+{
+	mCommands.clear();
+	mLateDraws.clear();
+}
+
+bool Compositor::draw(SDL_Texture *tex, const SDL_Rect &dst)
+{
+	AllocScope scope(ALLOC_RENDER);
+	if (!mActive)
+	{
+		return false;
+	}
+
+	std::map<SDL_Texture *, CpuImage *>::iterator it = mImages.find(tex);
+	if (it == mImages.end())
+	{
+		LateDraw late;
+		late.texture = tex;
+		late.dst = dst;
+		mLateDraws.push_back(late);
+		return true;
+	}
+
+	DrawCmd cmd;
+	cmd.image = it->second;
+	cmd.dst = dst;
+	mCommands.push_back(cmd);
+	return true;
+}
+
+void Compositor::present()
+{
+	AllocScope scope(ALLOC_RENDER);
+	if (!mActive)
+	{
+		return;
+	}
+
+	trackDamage();
+	mDamage.finish();
+	mRedrawnPixels = mDamage.getArea();
+
+	if (!mDamage.isEmpty())
+	{
+		binCommands();
+		const std::vector<SDL_Rect> &rects = mDamage.getRects();
+
+		//Every band writes its own rows of the frame, so no locking is needed
+		gJobs.parallelFor(static_cast<int>(mBins.size()), 1, [this, &rects](int begin, int end)
+		{
+			for (int band = begin; band < end; band++)
+			{
+				SDL_Rect bandRect = { 0, band * mBandHeight, mWidth, mBandHeight };
+				for (size_t i = 0; i < rects.size(); i++)
+				{
+					SDL_Rect clip;
+					if (SDL_IntersectRect(&bandRect, &rects[i], &clip))
+					{
+						rasterize(&mFrame[0], mWidth, clip, mBins[band], mBandScratch[band]);
+					}
+				}
+			}
+		});
+
+		for (size_t i = 0; i < rects.size(); i++)
+		{
+			SDL_UpdateTexture(mTarget, &rects[i], &mFrame[rects[i].y * mWidth + rects[i].x], mWidth * sizeof(Uint32));
+		}
+	}
+	SDL_RenderCopy(mRenderer, mTarget, NULL, NULL);
+	for (size_t i = 0; i < mLateDraws.size(); i++)
+	{
+		SDL_RenderCopy(mRenderer, mLateDraws[i].texture, NULL, &mLateDraws[i].dst);
+	}
+	mLateDraws.clear();
+
+	//The next frame is compared against this one
+	mLastCommands.swap(mCommands);
+	mCommands.clear();
+	mDamage.clear();
+}
+
+void Compositor::invalidate(const SDL_Rect &rect)
+{
+	mDamage.add(rect);
+}
+
+void Compositor::invalidateAll()
+{
+	mDamage.addAll();
+}
+
+int Compositor::getRedrawnPixels()
+{
+	return mRedrawnPixels;
+}
+
+void Compositor::trackDamage()
+{
+	//Usually the same draws in the same order with a sprite or two moved
+	if (mCommands.size() == mLastCommands.size())
+	{
+		for (size_t i = 0; i < mCommands.size(); i++)
+		{
+			const DrawCmd &now = mCommands[i];
+			const DrawCmd &before = mLastCommands[i];
+			if (now.image != before.image || now.dst.x != before.dst.x || now.dst.y != before.dst.y || now.dst.w != before.dst.w || now.dst.h != before.dst.h)
+			{
+				mDamage.add(before.dst);
+				mDamage.add(now.dst);
+			}
+		}
+		return;
+	}
+
+	//Draws were added or removed, damage whatever is only in one frame
+	struct
+	{
+		bool operator()(const DrawCmd &a, const DrawCmd &b) const
+		{
+			if (a.image != b.image) return a.image < b.image;
+			if (a.dst.x != b.dst.x) return a.dst.x < b.dst.x;
+			if (a.dst.y != b.dst.y) return a.dst.y < b.dst.y;
+			if (a.dst.w != b.dst.w) return a.dst.w < b.dst.w;
+			return a.dst.h < b.dst.h;
+		}
+	} less;
+
+	mSortedNew = mCommands;
+	mSortedOld = mLastCommands;
+	std::sort(mSortedNew.begin(), mSortedNew.end(), less);
+	std::sort(mSortedOld.begin(), mSortedOld.end(), less);
+
+	size_t i = 0;
+	size_t j = 0;
+	while (i < mSortedNew.size() || j < mSortedOld.size())
+	{
+		if (j == mSortedOld.size() || (i < mSortedNew.size() && less(mSortedNew[i], mSortedOld[j])))
+		{
+			mDamage.add(mSortedNew[i++].dst);
+		}
+		else if (i == mSortedNew.size() || less(mSortedOld[j], mSortedNew[i]))
+		{
+			mDamage.add(mSortedOld[j++].dst);
+		}
+		else
+		{
+			i++;
+			j++;
+		}
+	}
+}
+
+void Compositor::binCommands()
+{
+	for (size_t band = 0; band < mBins.size(); band++)
+	{
+		mBins[band].clear();
+	}
+
+	int lastBand = static_cast<int>(mBins.size()) - 1;
+	for (size_t i = 0; i < mCommands.size(); i++)
+	{
+		const SDL_Rect &dst = mCommands[i].dst;
+		if (dst.w <= 0 || dst.h <= 0 || dst.y >= mHeight || dst.y + dst.h <= 0)
+		{
+			continue;
+		}
+		int first = dst.y > 0 ? dst.y / mBandHeight : 0;
+		int last = (dst.y + dst.h - 1) / mBandHeight;
+		if (last > lastBand)
+		{
+			last = lastBand;
+		}
+
+		//Commands stay in submission order inside each band
+		for (int band = first; band <= last; band++)
+		{
+			mBins[band].push_back(static_cast<int>(i));
+		}
+	}
+}
+
+void Compositor::rasterize(Uint32 *pixels, int pitch, const SDL_Rect &clip, const std::vector<int> &commands, RasterScratch &scratch)
+{
+	//Same black SDL_RenderClear would give us
+	for (int y = clip.y; y < clip.y + clip.h; y++)
+	{
+		Uint32 *row = pixels + y * pitch + clip.x;
+		for (int x = 0; x < clip.w; x++)
+		{
+			row[x] = 0xFF000000u;
+		}
+	}
+
+	for (size_t i = 0; i < commands.size(); i++)
+	{
+		const DrawCmd &cmd = mCommands[commands[i]];
+		SDL_Rect area;
+		if (SDL_IntersectRect(&cmd.dst, &clip, &area))
+		{
+			drawImage(pixels, pitch, *cmd.image, cmd.dst, area, scratch);
+		}
+	}
+}
+
+void Compositor::drawImage(Uint32 *pixels, int pitch, const CpuImage &image, const SDL_Rect &dst, const SDL_Rect &area, RasterScratch &scratch)
+{
+	BlitCopyRowFn put = image.opaque ? mKernels->copyRow : mKernels->blendRow;
+
+	//Drawn at its own size with run lists, only the visible runs are blended
+	if (image.w == dst.w && image.h == dst.h && !image.rowRuns.empty())
+	{
+		int left = area.x - dst.x;
+		int right = left + area.w;
+		for (int y = area.y; y < area.y + area.h; y++)
+		{
+			int sy = y - dst.y;
+			Uint32 *out = pixels + y * pitch;
+			const Uint32 *src = &image.pixels[sy * image.w];
+			for (int r = image.rowRuns[sy]; r < image.rowRuns[sy + 1]; r += 2)
+			{
+				int start = image.runs[r] > left ? image.runs[r] : left;
+				int end = image.runs[r] + image.runs[r + 1] < right ? image.runs[r] + image.runs[r + 1] : right;
+				if (end > start)
+				{
+					mKernels->blendRow(out + dst.x + start, src + start, end - start);
+				}
+			}
+		}
+		return;
+	}
+
+	//Drawn at its own size, the rows go straight to the frame
+	if (image.w == dst.w && image.h == dst.h)
+	{
+		for (int y = area.y; y < area.y + area.h; y++)
+		{
+			put(pixels + y * pitch + area.x, &image.pixels[(y - dst.y) * image.w + (area.x - dst.x)], area.w);
+		}
+		return;
+	}
+
+	if (static_cast<int>(scratch.row.size()) < area.w)
+	{
+		scratch.x0.resize(area.w);
+		scratch.x1.resize(area.w);
+		scratch.fx.resize(area.w);
+		scratch.row.resize(area.w);
+	}
+
+	if (!mLinear)
+	{
+		//Sample the source pixel under each destination pixel's centre
+		for (int i = 0; i < area.w; i++)
+		{
+			scratch.x0[i] = ((2 * (area.x + i - dst.x) + 1) * image.w) / (2 * dst.w);
+		}
+		for (int y = area.y; y < area.y + area.h; y++)
+		{
+			int sy = ((2 * (y - dst.y) + 1) * image.h) / (2 * dst.h);
+			mKernels->nearestRow(&scratch.row[0], &image.pixels[sy * image.w], &scratch.x0[0], area.w);
+			put(pixels + y * pitch + area.x, &scratch.row[0], area.w);
+		}
+		return;
+	}
+
+	//Source positions in 24.8 fixed point, offset by half a pixel
+	for (int i = 0; i < area.w; i++)
+	{
+		int u = ((2 * (area.x + i - dst.x) + 1) * image.w * 256) / (2 * dst.w) - 128;
+		if (u < 0)
+		{
+			u = 0;
+		}
+		int x0 = u >> 8;
+		if (x0 > image.w - 1)
+		{
+			x0 = image.w - 1;
+		}
+		scratch.x0[i] = x0;
+		scratch.x1[i] = x0 + 1 < image.w ? x0 + 1 : x0;
+		scratch.fx[i] = static_cast<Uint8>(u & 0xFF);
+	}
+	for (int y = area.y; y < area.y + area.h; y++)
+	{
+		int v = ((2 * (y - dst.y) + 1) * image.h * 256) / (2 * dst.h) - 128;
+		if (v < 0)
+		{
+			v = 0;
+		}
+		int y0 = v >> 8;
+		if (y0 > image.h - 1)
+		{
+			y0 = image.h - 1;
+		}
+		int y1 = y0 + 1 < image.h ? y0 + 1 : y0;
+		mKernels->bilinearRow(&scratch.row[0], &image.pixels[y0 * image.w], &image.pixels[y1 * image.w], v & 0xFF,
+			&scratch.x0[0], &scratch.x1[0], &scratch.fx[0], area.w);
+		put(pixels + y * pitch + area.x, &scratch.row[0], area.w);
+	}
+}
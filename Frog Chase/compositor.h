@@ -0,0 +1,148 @@
+#pragma once
+#include <map>
+#include <vector>
+#if defined(_MSC_VER)
+#include <SDL.h>
+#else
+#include <SDL2/SDL.h>
+#endif
+#include "blitkernels.h"
+#include "damage.h"
+
+/*
+* CPU compositing path for renderers without a GPU behind them. Draws are
+* recorded during the frame and compared with the previous frame's draws; only
+* the regions that changed are rasterised, in parallel horizontal bands with
+* the SIMD row kernels, and uploaded to a streaming texture that is then copied
+* to the screen in one go.
+*/
+
+//CPU copy of a texture's pixels in ARGB8888
+struct CpuImage
+{
+	std::vector<Uint32> pixels;
+	int w;
+	int h;
+
+	//No pixel has alpha below 255, so rows can be copied instead of blended
+	bool opaque;
+
+	//Run-length spans of visible pixels for mostly transparent images:
+	//row y's spans are runs[rowRuns[y]] up to runs[rowRuns[y + 1]],
+	//each a start and a length. Empty when the image isn't encoded.
+	std::vector<int> rowRuns;
+	std::vector<Uint16> runs;
+};
+
+//Per-thread buffers used while rasterising
+struct RasterScratch
+{
+	std::vector<int> x0;
+	std::vector<int> x1;
+	std::vector<Uint8> fx;
+	std::vector<Uint32> row;
+};
+
+class Compositor
+{
+public:
+	//Initializes variables
+	Compositor();
+
+	//Deallocates memory
+	~Compositor();
+
+	//Turns the CPU path on when the renderer is a software one
+	bool init(SDL_Renderer *ren, int w, int h);
+
+	//Deallocates the frame texture and every image
+	void free();
+
+	//True when draws go through the compositor instead of SDL_RenderCopy
+	bool isActive();
+
+	//Keeps a CPU copy of the surface a texture was created from
+	void registerImage(SDL_Texture *tex, SDL_Surface *surface);
+
+	//Forgets a texture's CPU copy
+	void unregisterImage(SDL_Texture *tex);
+
+	//Starts a new frame
+	void clear();
+
+	//Records a draw, returns false when the compositor is off. Textures
+	//without a CPU copy are drawn over the finished frame by present.
+	bool draw(SDL_Texture *tex, const SDL_Rect &dst);
+
+	//Rasterises the frame and copies it to the renderer
+	void present();
+
+	//Forces a region to be recomposited next frame
+	void invalidate(const SDL_Rect &rect);
+
+	//Forces the whole frame to be recomposited next frame
+	void invalidateAll();
+
+	//Pixels recomposited by the last present
+	int getRedrawnPixels();
+
+private:
+	struct DrawCmd
+	{
+		const CpuImage *image;
+		SDL_Rect dst;
+	};
+
+	struct LateDraw
+	{
+		SDL_Texture *texture;
+		SDL_Rect dst;
+	};
+
+	//Damages the old and new area of every draw that differs from last frame
+	void trackDamage();
+
+	//Sorts the recorded commands into the bands they overlap
+	void binCommands();
+
+	//Draws the listed commands, limited to clip
+	void rasterize(Uint32 *pixels, int pitch, const SDL_Rect &clip, const std::vector<int> &commands, RasterScratch &scratch);
+
+	//Draws one image scaled into dst, limited to area
+	void drawImage(Uint32 *pixels, int pitch, const CpuImage &image, const SDL_Rect &dst, const SDL_Rect &area, RasterScratch &scratch);
+
+	SDL_Renderer *mRenderer;
+	SDL_Texture *mTarget;
+	int mWidth;
+	int mHeight;
+	bool mActive;
+
+	//Follows SDL_HINT_RENDER_SCALE_QUALITY
+	bool mLinear;
+
+	const BlitKernels *mKernels;
+	std::map<SDL_Texture *, CpuImage *> mImages;
+	std::vector<DrawCmd> mCommands;
+
+	//Draws of textures with no CPU copy, copied after the frame so it
+	//doesn't paint over them
+	std::vector<LateDraw> mLateDraws;
+
+	//What the frame in mFrame was built from
+	std::vector<DrawCmd> mLastCommands;
+	std::vector<DrawCmd> mSortedNew;
+	std::vector<DrawCmd> mSortedOld;
+
+	DamageTracker mDamage;
+	int mRedrawnPixels;
+
+	//The frame in system memory, uploaded with SDL_UpdateTexture
+	std::vector<Uint32> mFrame;
+
+	//Horizontal bands, each rasterised by one job
+	int mBandHeight;
+	std::vector<std::vector<int> > mBins;
+	std::vector<RasterScratch> mBandScratch;
+};
+
+extern Compositor gCompositor;
@@ -0,0 +1,147 @@
+#include "damage.h"
+
+static int rectArea(const SDL_Rect &r)
+{
+	return r.w * r.h;
+}
+
+static SDL_Rect rectUnion(const SDL_Rect &a, const SDL_Rect &b)
+{
+	SDL_Rect result;
+	SDL_UnionRect(&a, &b, &result);
+	return result;
+}
+
+DamageTracker::DamageTracker()
+{
+	mScreen.x = 0;
+	mScreen.y = 0;
+	mScreen.w = 0;
+	mScreen.h = 0;
+	mFull = true;
+}
+
+void DamageTracker::reset(int w, int h)
+{
+	mScreen.w = w;
+	mScreen.h = h;
+	mFullRect.assign(1, mScreen);
+	addAll();
+}
+
+void DamageTracker::add(const SDL_Rect &rect)
+{
+	if (mFull)
+	{
+		return;
+	}
+
+	SDL_Rect clipped;
+	if (SDL_IntersectRect(&rect, &mScreen, &clipped))
+	{
+		mRects.push_back(clipped);
+	}
+}
+
+void DamageTracker::addAll()
+{
+	mFull = true;
+	mRects.clear();
+}
+
+void DamageTracker::finish()
+{
+	if (mFull)
+	{
+		return;
+	}
+
+	//Join rectangles whose bounding box costs no more than drawing both
+	bool merged = true;
+	while (merged)
+	{
+		merged = false;
+		for (size_t i = 0; i < mRects.size() && !merged; i++)
+		{
+			for (size_t j = i + 1; j < mRects.size(); j++)
+			{
+				if (rectArea(rectUnion(mRects[i], mRects[j])) <= rectArea(mRects[i]) + rectArea(mRects[j]))
+				{
+					merge(i, j);
+					merged = true;
+					break;
+				}
+			}
+		}
+	}
+
+	//Too many left, join the pairs that waste the fewest pixels
+	while (mRects.size() > static_cast<size_t>(MAX_RECTS))
+	{
+		size_t bestI = 0;
+		size_t bestJ = 1;
+		int bestWaste = -1;
+		for (size_t i = 0; i < mRects.size(); i++)
+		{
+			for (size_t j = i + 1; j < mRects.size(); j++)
+			{
+				int waste = rectArea(rectUnion(mRects[i], mRects[j])) - rectArea(mRects[i]) - rectArea(mRects[j]);
+				if (bestWaste < 0 || waste < bestWaste)
+				{
+					bestWaste = waste;
+					bestI = i;
+					bestJ = j;
+				}
+			}
+		}
+		merge(bestI, bestJ);
+	}
+
+	if (getArea() * 100 > rectArea(mScreen) * FULL_REDRAW_PERCENT)
+	{
+		addAll();
+	}
+}
+
+void DamageTracker::clear()
+{
+	mFull = false;
+	mRects.clear();
+}
+
+bool DamageTracker::isEmpty()
+{
+	return !mFull && mRects.empty();
+}
+
+bool DamageTracker::isFull()
+{
+	return mFull;
+}
+
+const std::vector<SDL_Rect> &DamageTracker::getRects()
+{
+	return mFull ? mFullRect : mRects;
+}
+
+int DamageTracker::getArea()
+{
+	if (mFull)
+	{
+		return rectArea(mScreen);
+	}
+
+	int area = 0;
+	for (size_t i = 0; i < mRects.size(); i++)
+	{
+		area += rectArea(mRects[i]);
+	}
+	return area;
+}
+
+void DamageTracker::merge(size_t i, size_t j)
+{
+	mRects[i] = rectUnion(mRects[i], mRects[j]);
+	mRects[j] = mRects.back();
+	mRects.pop_back();
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <vector>
+#if defined(_MSC_VER)
+#include <SDL.h>
+#else
+#include <SDL2/SDL.h>
+#endif
+
+/*
+* Collects the screen regions that changed between two frames and merges them
+* into a few rectangles, so only those get recomposited and uploaded.
+*/
+class DamageTracker
+{
+public:
+	//Most rectangles kept after merging
+	static const int MAX_RECTS = 16;
+
+	//Percentage of the screen above which a full redraw is cheaper
+	static const int FULL_REDRAW_PERCENT = 50;
+
+	//Initializes variables
+	DamageTracker();
+
+	//Sets the screen bounds and marks everything damaged
+	void reset(int w, int h);
+
+	//Marks a region as changed, clipped to the screen
+	void add(const SDL_Rect &rect);
+
+	//Marks the whole screen as changed
+	void addAll();
+
+	//Merges the rectangles and decides whether to redraw everything
+	void finish();
+
+	//Forgets all damage once the frame is drawn
+	void clear();
+
+	//True when nothing changed
+	bool isEmpty();
+
+	//True when the whole screen has to be redrawn
+	bool isFull();
+
+	//Rectangles to redraw after finish()
+	const std::vector<SDL_Rect> &getRects();
+
+	//Pixels covered by the rectangles
+	int getArea();
+
+private:
+	//Joins rectangle j into i and removes j
+	void merge(size_t i, size_t j);
+
+	SDL_Rect mScreen;
+	std::vector<SDL_Rect> mRects;
+	std::vector<SDL_Rect> mFullRect;
+	bool mFull;
+};
@@ -0,0 +1,395 @@
+#include "distancefield.h"
+
+DistanceField::DistanceField()
+{
+	//Initialize
+	for (int cell = 0; cell < FIELD_CELLS; cell++)
+	{
+		mBlocked[cell] = false;
+		mTriggers[cell].action = TRIGGER_NONE;
+		mTriggers[cell].targetCol = 0;
+		mTriggers[cell].targetRow = 0;
+		mDistance[cell] = FIELD_UNREACHABLE;
+		mMarked[cell] = false;
+	}
+	mDoorCount = 0;
+	mChangedCount = 0;
+	mSeedCount = 0;
+	mRepaired = 0;
+}
+
+void DistanceField::rebuild(const MoveBoard &board, const Level &level)
+{
+	mDoorCount = 0;
+	for (int row = 0; row < FROG_ROWS; row++)
+	{
+		for (int col = 0; col < FROG_COLS; col++)
+		{
+			int cell = row * FROG_COLS + col;
+			mBlocked[cell] = board.isBlocked(col, row);
+			mTriggers[cell] = level.getTrigger(col, row);
+			mDistance[cell] = FIELD_UNREACHABLE;
+			if (mTriggers[cell].action == TRIGGER_TELEPORT)
+			{
+				mDoors[mDoorCount++] = cell;
+			}
+		}
+	}
+
+	//Every home is a seed at 0 and the rest fills outward from them
+	mRepaired = 0;
+	mSeedCount = 0;
+	for (int cell = 0; cell < FIELD_CELLS; cell++)
+	{
+		if (isHome(cell))
+		{
+			mSeeds[mSeedCount] = cell;
+			mSeedKeys[mSeedCount] = 0;
+			mSeedCount++;
+		}
+	}
+	lower();
+}
+
+void DistanceField::setBlocked(int col, int row, bool blocked)
+{
+	if (col < 0 || col >= FROG_COLS || row < 0 || row >= FROG_ROWS)
+	{
+		return;
+	}
+	int cell = row * FROG_COLS + col;
+	if (mBlocked[cell] == blocked)
+	{
+		mRepaired = 0;
+		return;
+	}
+	mBlocked[cell] = blocked;
+
+	mChangedCount = 0;
+	noteChange(cell);
+	repair();
+}
+
+void DistanceField::setTrigger(int col, int row, const CellTrigger &trigger)
+{
+	if (col < 0 || col >= FROG_COLS || row < 0 || row >= FROG_ROWS)
+	{
+		return;
+	}
+	int cell = row * FROG_COLS + col;
+
+	//Doors that led here may stop being usable, so note them before and after
+	mChangedCount = 0;
+	noteChange(cell);
+	bool wasDoor = mTriggers[cell].action == TRIGGER_TELEPORT;
+	mTriggers[cell] = trigger;
+	bool isDoor = trigger.action == TRIGGER_TELEPORT;
+	if (wasDoor && !isDoor)
+	{
+		for (int i = 0; i < mDoorCount; i++)
+		{
+			if (mDoors[i] == cell)
+			{
+				mDoors[i] = mDoors[--mDoorCount];
+				break;
+			}
+		}
+	}
+	else if (isDoor && !wasDoor)
+	{
+		mDoors[mDoorCount++] = cell;
+	}
+	repair();
+}
+
+int DistanceField::getDistance(int col, int row) const
+{
+	if (col < 0 || col >= FROG_COLS || row < 0 || row >= FROG_ROWS)
+	{
+		return FIELD_UNREACHABLE;
+	}
+	return mDistance[row * FROG_COLS + col];
+}
+
+int DistanceField::getHint(int col, int row) const
+{
+	int distance = getDistance(col, row);
+	if (distance == 0 || distance == FIELD_UNREACHABLE)
+	{
+		return HINT_NONE;
+	}
+
+	//Any move a step closer is on a shortest way home
+	for (int command = COMMAND_UP; command <= COMMAND_RIGHT; command++)
+	{
+		if (getDistance(col + COMMAND_DX[command], row + COMMAND_DY[command]) == distance - 1 && isOpen((row + COMMAND_DY[command]) * FROG_COLS + col + COMMAND_DX[command]))
+		{
+			return command;
+		}
+	}
+	int target = doorTarget(row * FROG_COLS + col);
+	if (target >= 0 && mDistance[target] == distance - 1)
+	{
+		return HINT_ENTER;
+	}
+	return HINT_NONE;
+}
+
+int DistanceField::getRepaired() const
+{
+	return mRepaired;
+}
+
+bool DistanceField::isOpen(int cell) const
+{
+	return !mBlocked[cell];
+}
+
+bool DistanceField::isHome(int cell) const
+{
+	return !mBlocked[cell] && mTriggers[cell].action == TRIGGER_HOME;
+}
+
+int DistanceField::doorTarget(int cell) const
+{
+	const CellTrigger &trigger = mTriggers[cell];
+	if (trigger.action != TRIGGER_TELEPORT || mBlocked[cell])
+	{
+		return -1;
+	}
+	if (trigger.targetCol < 0 || trigger.targetCol >= FROG_COLS || trigger.targetRow < 0 || trigger.targetRow >= FROG_ROWS)
+	{
+		return -1;
+	}
+
+	//Like the solver, only doors to a tile the frog survives on count
+	int target = trigger.targetRow * FROG_COLS + trigger.targetCol;
+	int action = mTriggers[target].action;
+	if (mBlocked[target] || (action != TRIGGER_SAFE && action != TRIGGER_HOME))
+	{
+		return -1;
+	}
+	return target;
+}
+
+int DistanceField::bestThrough(int cell) const
+{
+	if (mBlocked[cell])
+	{
+		return FIELD_UNREACHABLE;
+	}
+	if (isHome(cell))
+	{
+		return 0;
+	}
+
+	int best = FIELD_UNREACHABLE;
+	int col = cell % FROG_COLS;
+	int row = cell / FROG_COLS;
+	for (int command = COMMAND_UP; command <= COMMAND_RIGHT; command++)
+	{
+		int distance = getDistance(col + COMMAND_DX[command], row + COMMAND_DY[command]);
+		if (distance + 1 < best && isOpen((row + COMMAND_DY[command]) * FROG_COLS + col + COMMAND_DX[command]))
+		{
+			best = distance + 1;
+		}
+	}
+	int target = doorTarget(cell);
+	if (target >= 0 && mDistance[target] + 1 < best)
+	{
+		best = mDistance[target] + 1;
+	}
+	return best;
+}
+
+bool DistanceField::isSupported(int cell) const
+{
+	if (isHome(cell))
+	{
+		return true;
+	}
+	if (mBlocked[cell])
+	{
+		return false;
+	}
+
+	int distance = mDistance[cell];
+	int col = cell % FROG_COLS;
+	int row = cell / FROG_COLS;
+	for (int command = COMMAND_UP; command <= COMMAND_RIGHT; command++)
+	{
+		int nextCol = col + COMMAND_DX[command];
+		int nextRow = row + COMMAND_DY[command];
+		if (nextCol < 0 || nextCol >= FROG_COLS || nextRow < 0 || nextRow >= FROG_ROWS)
+		{
+			continue;
+		}
+		int next = nextRow * FROG_COLS + nextCol;
+		if (!mMarked[next] && isOpen(next) && mDistance[next] + 1 == distance)
+		{
+			return true;
+		}
+	}
+	int target = doorTarget(cell);
+	return target >= 0 && !mMarked[target] && mDistance[target] + 1 == distance;
+}
+
+template<typename Visit> void DistanceField::forEachSource(int cell, Visit visit) const
+{
+	//Moves go both ways, so the open neighbours are the sources
+	if (!mBlocked[cell])
+	{
+		int col = cell % FROG_COLS;
+		int row = cell / FROG_COLS;
+		for (int command = COMMAND_UP; command <= COMMAND_RIGHT; command++)
+		{
+			int nextCol = col + COMMAND_DX[command];
+			int nextRow = row + COMMAND_DY[command];
+			if (nextCol >= 0 && nextCol < FROG_COLS && nextRow >= 0 && nextRow < FROG_ROWS && isOpen(nextRow * FROG_COLS + nextCol))
+			{
+				visit(nextRow * FROG_COLS + nextCol);
+			}
+		}
+	}
+	for (int i = 0; i < mDoorCount; i++)
+	{
+		const CellTrigger &trigger = mTriggers[mDoors[i]];
+		if (trigger.targetRow * FROG_COLS + trigger.targetCol == cell && doorTarget(mDoors[i]) == cell)
+		{
+			visit(mDoors[i]);
+		}
+	}
+}
+
+void DistanceField::noteChange(int cell)
+{
+	//The tile itself, its neighbours' moves onto it and the doors leading to it
+	int col = cell % FROG_COLS;
+	int row = cell / FROG_COLS;
+	mChanged[mChangedCount++] = cell;
+	for (int command = COMMAND_UP; command <= COMMAND_RIGHT; command++)
+	{
+		int nextCol = col + COMMAND_DX[command];
+		int nextRow = row + COMMAND_DY[command];
+		if (nextCol >= 0 && nextCol < FROG_COLS && nextRow >= 0 && nextRow < FROG_ROWS)
+		{
+			mChanged[mChangedCount++] = nextRow * FROG_COLS + nextCol;
+		}
+	}
+	for (int i = 0; i < mDoorCount; i++)
+	{
+		const CellTrigger &trigger = mTriggers[mDoors[i]];
+		if (trigger.targetRow * FROG_COLS + trigger.targetCol == cell && mChangedCount < FIELD_CELLS)
+		{
+			mChanged[mChangedCount++] = mDoors[i];
+		}
+	}
+}
+
+void DistanceField::repair()
+{
+	mRepaired = 0;
+
+	//Cut loose every tile whose way home at its distance went through the change
+	int lostCount = 0;
+	for (int i = 0; i < mChangedCount; i++)
+	{
+		int cell = mChanged[i];
+		if (!mMarked[cell] && mDistance[cell] != FIELD_UNREACHABLE && !isSupported(cell))
+		{
+			mMarked[cell] = true;
+			mLost[lostCount++] = cell;
+		}
+	}
+	for (int i = 0; i < lostCount; i++)
+	{
+		int lost = mLost[i];
+		forEachSource(lost, [&](int source)
+		{
+			if (!mMarked[source] && mDistance[source] == mDistance[lost] + 1 && !isSupported(source))
+			{
+				mMarked[source] = true;
+				mLost[lostCount++] = source;
+			}
+		});
+	}
+	for (int i = 0; i < lostCount; i++)
+	{
+		mMarked[mLost[i]] = false;
+		mDistance[mLost[i]] = FIELD_UNREACHABLE;
+	}
+
+	//Refill the cut tiles and lower the changed ones from what's left
+	mSeedCount = 0;
+	for (int pass = 0; pass < 2; pass++)
+	{
+		const int *cells = pass == 0 ? mLost : mChanged;
+		int count = pass == 0 ? lostCount : mChangedCount;
+		for (int i = 0; i < count && mSeedCount < FIELD_CELLS; i++)
+		{
+			int key = bestThrough(cells[i]);
+			if (key < mDistance[cells[i]])
+			{
+				mSeeds[mSeedCount] = cells[i];
+				mSeedKeys[mSeedCount] = key;
+				mSeedCount++;
+			}
+		}
+	}
+	lower();
+	mRepaired += lostCount;
+}
+
+void DistanceField::lower()
+{
+	//Few seeds, so insertion sort them by distance
+	for (int i = 1; i < mSeedCount; i++)
+	{
+		int seed = mSeeds[i];
+		int key = mSeedKeys[i];
+		int j = i - 1;
+		for (; j >= 0 && mSeedKeys[j] > key; j--)
+		{
+			mSeeds[j + 1] = mSeeds[j];
+			mSeedKeys[j + 1] = mSeedKeys[j];
+		}
+		mSeeds[j + 1] = seed;
+		mSeedKeys[j + 1] = key;
+	}
+
+	//Every press costs one, so the sorted seeds and a FIFO of lowered
+	//tiles together hand out tiles in order of distance
+	int seed = 0;
+	int head = 0;
+	int tail = 0;
+	while (seed < mSeedCount || head < tail)
+	{
+		int cell;
+		if (seed < mSeedCount && (head == tail || mSeedKeys[seed] <= mDistance[mQueue[head]]))
+		{
+			cell = mSeeds[seed];
+			int key = mSeedKeys[seed++];
+			if (key >= mDistance[cell])
+			{
+				continue;
+			}
+			mDistance[cell] = static_cast<unsigned short>(key);
+			mRepaired++;
+		}
+		else
+		{
+			cell = mQueue[head++];
+		}
+
+		int distance = mDistance[cell] + 1;
+		forEachSource(cell, [&](int source)
+		{
+			if (distance < mDistance[source] && tail < FIELD_CELLS)
+			{
+				mDistance[source] = static_cast<unsigned short>(distance);
+				mQueue[tail++] = source;
+				mRepaired++;
+			}
+		});
+	}
+}
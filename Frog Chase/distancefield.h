@@ -0,0 +1,92 @@
+#pragma once
+#include "board.h"
+#include "level.h"
+#include "program.h"
+
+/*
+* Distance home from every tile the frog can stand on, counted the way the
+* solver counts it: one per arrow and one per enter press at a door. The
+* field is kept up to date as rocks and doors change by repairing only the
+* tiles whose distance the change touched: tiles that lost their way home are
+* cut loose and refilled from their neighbours, and tiles that gained a
+* shorter way are lowered outward from the change. Reading a tile's distance
+* or its best next press never searches.
+*/
+
+//Distance of a tile with no way home
+const int FIELD_UNREACHABLE = 0xFFFF;
+
+//Hints besides the four arrows: press enter at a door, or nothing to do
+const int HINT_ENTER = 4;
+const int HINT_NONE = -1;
+
+const int FIELD_CELLS = FROG_COLS * FROG_ROWS;
+
+class DistanceField
+{
+public:
+	//Initializes a field with no way home anywhere
+	DistanceField();
+
+	//Takes the rocks and triggers of a new layout and fills every distance
+	void rebuild(const MoveBoard &board, const Level &level);
+
+	//Puts a rock on a tile or takes it off, repairing the distances that change
+	void setBlocked(int col, int row, bool blocked);
+
+	//Changes what stopping on a tile does, repairing the distances that change
+	void setTrigger(int col, int row, const CellTrigger &trigger);
+
+	//Presses from a tile home, FIELD_UNREACHABLE if there's no way
+	int getDistance(int col, int row) const;
+
+	//Best next press from a tile: a Command, HINT_ENTER or HINT_NONE
+	int getHint(int col, int row) const;
+
+	//Tiles the last change or rebuild touched
+	int getRepaired() const;
+
+private:
+	bool isOpen(int cell) const;
+	bool isHome(int cell) const;
+
+	//Tile a usable door leads to, -1 if cell isn't one
+	int doorTarget(int cell) const;
+
+	//Distance through the cell's best move or door, from its neighbours' distances
+	int bestThrough(int cell) const;
+
+	//True while some move or door still gets the cell home at its distance
+	bool isSupported(int cell) const;
+
+	//Calls visit for every tile with a move or door onto cell
+	template<typename Visit> void forEachSource(int cell, Visit visit) const;
+
+	//Repairs the field after the tiles in mChanged had their moves or doors change
+	void repair();
+
+	//Lowers distances outward from the seeds, in order of distance
+	void lower();
+
+	//Notes the tiles whose moves depend on the tile at cell
+	void noteChange(int cell);
+
+	bool mBlocked[FIELD_CELLS];
+	CellTrigger mTriggers[FIELD_CELLS];
+	unsigned short mDistance[FIELD_CELLS];
+
+	//Tiles holding a door, usable or not
+	int mDoors[FIELD_CELLS];
+	int mDoorCount;
+
+	//Scratch space for repairs, sized so a repair never allocates
+	bool mMarked[FIELD_CELLS];
+	int mChanged[FIELD_CELLS];
+	int mChangedCount;
+	int mLost[FIELD_CELLS];
+	int mSeeds[FIELD_CELLS];
+	int mSeedKeys[FIELD_CELLS];
+	int mSeedCount;
+	int mQueue[FIELD_CELLS];
+	int mRepaired;
+};
@@ -0,0 +1,1153 @@
+#include "fuzz.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <utility>
+#if defined(_MSC_VER)
+#include <SDL.h>
+#else
+#include <SDL2/SDL.h>
+#endif
+#include "broadphase.h"
+#include "collision.h"
+#include "collisionmask.h"
+#include "commandring.h"
+#include "distancefield.h"
+#include "imagescan.h"
+#include "level.h"
+#include "program.h"
+#include "sprite.h"
+#include "zobrist.h"
+
+static const char *FAILURE_NAMES[] = { "ok", "off board", "on rock", "ring", "plan", "program", "field", "hint", "mask", "layout", "pairs" };
+
+//Words a fuzzed program is written with
+static const char *DIRECTION_WORDS[] = { "up", "down", "left", "right" };
+static const char *COUNT_WORDS[] = { "0", "1", "2", "3", "9", "65535", "65536" };
+static const char *JUNK_WORDS[] = { "?", "else", "{", "}", "blocked", "repeat", "# note\n", "\n" };
+
+//Repeat counts, mostly ones that run the block so the nesting is reached
+static const char *REPEAT_WORDS[] = { "2", "3", "9", "1", "2", "3", "0", "65536" };
+
+static const int COUNT_WORD_COUNT = sizeof(COUNT_WORDS) / sizeof(COUNT_WORDS[0]);
+static const int JUNK_WORD_COUNT = sizeof(JUNK_WORDS) / sizeof(JUNK_WORDS[0]);
+
+//Deepest nesting a fuzzed program is written with, well past PROGRAM_MAX_DEPTH
+static const int FUZZ_PROGRAM_NESTING = 64;
+
+//Size of the frog image the masks stand in for
+static const int FUZZ_FROG_WIDTH = 35;
+static const int FUZZ_FROG_HEIGHT = 43;
+
+//Biggest case the driver makes
+static const size_t FUZZ_MAX_CASE = 4096;
+
+//What an action byte does, by its value modulo 8
+enum FuzzAction
+{
+	ACTION_UP,
+	ACTION_DOWN,
+	ACTION_LEFT,
+	ACTION_RIGHT,
+	ACTION_ENTER,
+
+	//tile: puts a rock on the tile or takes it off
+	ACTION_ROCK,
+
+	//tile, action, target: changes what stopping on the tile does
+	ACTION_TRIGGER,
+
+	//statements: compiles a program and queues the moves it makes
+	ACTION_PROGRAM
+};
+
+//splitmix64, so a case replays the same everywhere
+static unsigned long long nextRandom(unsigned long long &state)
+{
+	state += 0x9E3779B97F4A7C15ULL;
+	unsigned long long z = state;
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+static int rollRandom(unsigned long long &state, int min, int max)
+{
+	return min + static_cast<int>(nextRandom(state) % static_cast<unsigned long long>(max - min));
+}
+
+static void addFeature(FuzzCoverage *coverage, unsigned kind, unsigned a, unsigned b)
+{
+	if (coverage == NULL)
+	{
+		return;
+	}
+	unsigned feature = (kind * 0x9E3779B1u ^ a * 0x85EBCA6Bu ^ b * 0xC2B2AE35u) & (FUZZ_FEATURES - 1);
+	unsigned char bit = static_cast<unsigned char>(1u << (feature & 7));
+	if ((coverage->bits[feature >> 3] & bit) == 0)
+	{
+		coverage->bits[feature >> 3] |= bit;
+		coverage->count++;
+	}
+}
+
+//Pixel position of the frog standing on a tile
+static int tileX(int col)
+{
+	return col * TILE_SIZE + FROG_OFFSET_X;
+}
+
+static int tileY(int row)
+{
+	return row * TILE_SIZE + FROG_OFFSET_Y;
+}
+
+//Makes an image like the game's: a solid shape in a transparent border, with stray pixels around the alpha threshold
+static SDL_Surface *makeImage(unsigned long long &random, int w, int h)
+{
+	SDL_Surface *surface = SDL_CreateRGBSurface(0, w, h, 32, 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000);
+	if (surface == NULL)
+	{
+		return NULL;
+	}
+	static const Uint32 STRAY_ALPHA[] = { 0, 1, 127, 128, 254, 255 };
+	int left = rollRandom(random, 0, w / 2 + 1);
+	int top = rollRandom(random, 0, h / 2 + 1);
+	int right = rollRandom(random, left, w + 1);
+	int bottom = rollRandom(random, top, h + 1);
+	int stray = rollRandom(random, 0, 5);
+
+	SDL_LockSurface(surface);
+	for (int y = 0; y < h; y++)
+	{
+		Uint32 *row = reinterpret_cast<Uint32 *>(static_cast<Uint8 *>(surface->pixels) + y * surface->pitch);
+		for (int x = 0; x < w; x++)
+		{
+			Uint32 alpha = x >= left && x < right && y >= top && y < bottom ? 255 : 0;
+			if (stray > 0 && rollRandom(random, 0, 16) < stray)
+			{
+				alpha = STRAY_ALPHA[rollRandom(random, 0, 6)];
+			}
+			row[x] = alpha << 24 | 0x336633;
+		}
+	}
+	SDL_UnlockSurface(surface);
+	return surface;
+}
+
+//Checks a mask, the alpha scan and the trimmed copy against the pixels, the way a texture load uses them
+static FuzzFailure checkImage(SDL_Surface *surface, const CollisionMask &mask)
+{
+	ImageScan scan = scanSurface(surface);
+	int left = surface->w;
+	int right = -1;
+	int top = surface->h;
+	int bottom = -1;
+	bool opaque = true;
+	bool matches = mask.getWidth() == surface->w && mask.getHeight() == surface->h;
+
+	SDL_LockSurface(surface);
+	for (int y = 0; y < surface->h && matches; y++)
+	{
+		const Uint32 *row = reinterpret_cast<const Uint32 *>(static_cast<const Uint8 *>(surface->pixels) + y * surface->pitch);
+		for (int x = 0; x < surface->w; x++)
+		{
+			Uint32 alpha = row[x] >> 24;
+			if (mask.isSolid(x, y) != (alpha >= CollisionMask::DEFAULT_THRESHOLD))
+			{
+				matches = false;
+			}
+			opaque = opaque && alpha == 255;
+			if (alpha != 0)
+			{
+				left = x < left ? x : left;
+				right = x > right ? x : right;
+				top = y < top ? y : top;
+				bottom = y > bottom ? y : bottom;
+			}
+		}
+	}
+	SDL_UnlockSurface(surface);
+	if (!matches || scan.opaque != opaque || (right < 0 ? scan.bounds.w != 0 : scan.bounds.x != left || scan.bounds.y != top || scan.bounds.w != right - left + 1 || scan.bounds.h != bottom - top + 1))
+	{
+		return FUZZ_MASK;
+	}
+	if (right < 0)
+	{
+		return FUZZ_OK;
+	}
+
+	//The trimmed copy keeps the same pixels and has nothing left to trim
+	SDL_Surface *trimmed = cropSurface(surface, scan.bounds);
+	if (trimmed == NULL)
+	{
+		return FUZZ_OK;
+	}
+	ImageScan rescan = scanSurface(trimmed);
+	matches = rescan.bounds.x == 0 && rescan.bounds.y == 0 && rescan.bounds.w == trimmed->w && rescan.bounds.h == trimmed->h;
+	SDL_LockSurface(surface);
+	SDL_LockSurface(trimmed);
+	for (int y = 0; y < trimmed->h && matches; y++)
+	{
+		const Uint8 *src = static_cast<const Uint8 *>(surface->pixels) + (scan.bounds.y + y) * surface->pitch + scan.bounds.x * 4;
+		const Uint8 *dst = static_cast<const Uint8 *>(trimmed->pixels) + y * trimmed->pitch;
+		matches = memcmp(src, dst, trimmed->w * 4) == 0;
+	}
+	SDL_UnlockSurface(trimmed);
+	SDL_UnlockSurface(surface);
+	SDL_FreeSurface(trimmed);
+	return matches ? FUZZ_OK : FUZZ_MASK;
+}
+
+//Checks the shifted word test against comparing the masks pixel by pixel
+static FuzzFailure checkOverlap(const CollisionMask &a, const CollisionMask &b, int dx, int dy)
+{
+	bool overlap = false;
+	for (int y = 0; y < a.getHeight() && !overlap; y++)
+	{
+		for (int x = 0; x < a.getWidth() && !overlap; x++)
+		{
+			overlap = a.isSolid(x, y) && b.isSolid(x - dx, y - dy);
+		}
+	}
+	return CollisionMask::overlaps(a, 0, 0, b, dx, dy) == overlap ? FUZZ_OK : FUZZ_MASK;
+}
+
+//Makes the frog's mask and a rock tile's from fuzzed images, the way the game loads them
+static FuzzFailure buildMasks(unsigned long long &random, CollisionMask &frogMask, CollisionMask &rockMask)
+{
+	FuzzFailure failure = FUZZ_OK;
+	SDL_Surface *frog = makeImage(random, FUZZ_FROG_WIDTH, FUZZ_FROG_HEIGHT);
+	frogMask.build(frog);
+	if (frog != NULL)
+	{
+		failure = checkImage(frog, frogMask);
+		SDL_FreeSurface(frog);
+	}
+
+	//Rock images come in any size and are scaled to a tile
+	CollisionMask source;
+	SDL_Surface *rock = makeImage(random, rollRandom(random, 1, 2 * TILE_SIZE), rollRandom(random, 1, 2 * TILE_SIZE));
+	source.build(rock);
+	if (rock != NULL)
+	{
+		if (failure == FUZZ_OK)
+		{
+			failure = checkImage(rock, source);
+		}
+		SDL_FreeSurface(rock);
+	}
+	rockMask.buildScaled(source, TILE_SIZE, TILE_SIZE);
+
+	for (int i = 0; i < 8 && failure == FUZZ_OK; i++)
+	{
+		failure = checkOverlap(frogMask, rockMask, rollRandom(random, -TILE_SIZE, FUZZ_FROG_WIDTH + 1), rollRandom(random, -TILE_SIZE, FUZZ_FROG_HEIGHT + 1));
+	}
+	return failure;
+}
+
+//Sets up a round the way main does: random rocks, three cards and the house
+static void buildLayout(unsigned long long &random, RockGrid &rocks, Sprite &frog, MoveBoard &board, Level &level)
+{
+	rocks.clear();
+	for (int i = 0; i < 40; i++)
+	{
+		int row = rollRandom(random, 3, 8);
+		int col = rollRandom(random, 1, 9);
+		if (row != 5 && col != 5 && col != 9)
+		{
+			rocks.set(col, row);
+		}
+	}
+	buildMoveBoard(frog, board);
+
+	int cards[3][2];
+	for (int i = 0; i < 3; i++)
+	{
+		cards[i][0] = rollRandom(random, 1, 3);
+		cards[i][1] = rollRandom(random, 2, 8);
+	}
+	level.reset();
+	level.setTrigger(cards[2][1], cards[2][0], TRIGGER_TELEPORT, 0, 6);
+	level.setTrigger(cards[1][1], cards[1][0], TRIGGER_TELEPORT, 0, 5);
+	level.setTrigger(cards[0][1], cards[0][0], TRIGGER_BIRD);
+	level.setTrigger(7, 3, TRIGGER_HOME);
+}
+
+//Moves the frog sprite through the commands from a tile, counting the moves a rock or the edge stopped
+static unsigned stepSprite(Sprite &frog, const CommandRing &commands, int col, int row)
+{
+	unsigned blocked = 0;
+	frog.setPositions(tileX(col), tileY(row));
+	for (unsigned i = 0; i < commands.size(); i++)
+	{
+		int x = frog.getPositionX();
+		int y = frog.getPositionY();
+		frog.runCommand(commands.peek(i));
+		if (frog.getPositionX() == x && frog.getPositionY() == y)
+		{
+			blocked++;
+		}
+	}
+	return blocked;
+}
+
+//Checks planMoves against moving the sprite the way the game does
+static FuzzFailure checkPlan(const CommandRing &commands, Sprite &frog, int col, int row, const ProgramResult &plan, const std::vector<MoveRun> &runs)
+{
+	unsigned blocked = stepSprite(frog, commands, col, row);
+	if (frog.getPositionX() != tileX(plan.col) || frog.getPositionY() != tileY(plan.row) || plan.moves != commands.size() || plan.blockedMoves != blocked)
+	{
+		return FUZZ_PLAN;
+	}
+
+	//The runs replay the moves that weren't dropped, never two the same way in a row
+	unsigned moved = 0;
+	for (size_t i = 0; i < runs.size(); i++)
+	{
+		if (runs[i].count <= 0 || (i > 0 && runs[i].command == runs[i - 1].command))
+		{
+			return FUZZ_PLAN;
+		}
+		moved += runs[i].count;
+	}
+	return moved == plan.moves - plan.blockedMoves ? FUZZ_OK : FUZZ_PLAN;
+}
+
+//Writes a block of statements from the case bytes. The low five bits of a
+//byte pick the statement and the high three its details; repeats come up
+//most, so programs nest past the interpreter's limit instead of staying
+//shallow. deepest is the most repeat counters the program needs at once.
+static void writeBlock(const unsigned char *data, size_t size, size_t &at, int depth, int repeats, int &deepest, std::string &source)
+{
+	deepest = repeats > deepest ? repeats : deepest;
+	while (at < size)
+	{
+		unsigned char byte = data[at++];
+		int statement = byte % 32;
+		int detail = byte >> 5;
+		if (statement == 0)
+		{
+			return;
+		}
+
+		if (statement < 20)
+		{
+			if (depth >= FUZZ_PROGRAM_NESTING)
+			{
+				return;
+			}
+			if (statement < 15)
+			{
+				//A repeat, or from 13 up a stack of them many deep at once
+				int levels = statement < 13 || at >= size ? 1 : 1 + data[at++] % 32;
+				levels = depth + levels > FUZZ_PROGRAM_NESTING ? FUZZ_PROGRAM_NESTING - depth : levels;
+				for (int i = 0; i < levels; i++)
+				{
+					source += "repeat ";
+					source += REPEAT_WORDS[detail];
+					source += " { ";
+				}
+				writeBlock(data, size, at, depth + levels, repeats + levels, deepest, source);
+				for (int i = 0; i < levels; i++)
+				{
+					source += "} ";
+				}
+				continue;
+			}
+			source += (detail & 4) != 0 ? "if free " : "if blocked ";
+			source += DIRECTION_WORDS[detail % 4];
+			source += " { ";
+			writeBlock(data, size, at, depth + 1, repeats, deepest, source);
+			source += "} ";
+			if (statement >= 18)
+			{
+				source += "else { ";
+				writeBlock(data, size, at, depth + 1, repeats, deepest, source);
+				source += "} ";
+			}
+		}
+		else if (statement < 30)
+		{
+			//A move, as a word or an arrow, sometimes with a count
+			if (statement < 25)
+			{
+				source += DIRECTION_WORDS[detail % 4];
+			}
+			else
+			{
+				source += COMMAND_SYMBOLS[detail % 4];
+			}
+			if ((detail & 4) != 0 && at < size)
+			{
+				//A counted move needs a counter of its own
+				source += ' ';
+				source += COUNT_WORDS[data[at++] % COUNT_WORD_COUNT];
+				deepest = repeats + 1 > deepest ? repeats + 1 : deepest;
+			}
+			source += ' ';
+		}
+		else if (statement == 30)
+		{
+			//Arrows packed together, like vvv>
+			for (int i = 0; i <= detail && at < size; i++)
+			{
+				source += COMMAND_SYMBOLS[data[at++] % 4];
+			}
+			source += ' ';
+		}
+		else
+		{
+			source += JUNK_WORDS[detail % JUNK_WORD_COUNT];
+			source += ' ';
+		}
+	}
+}
+
+//Checks the repaired field against fresh, built from scratch, and the hint from the frog's tile
+static FuzzFailure checkField(const DistanceField &field, DistanceField &fresh, const MoveBoard &board, const Level &level, int col, int row)
+{
+	fresh.rebuild(board, level);
+	for (int r = 0; r < FROG_ROWS; r++)
+	{
+		for (int c = 0; c < FROG_COLS; c++)
+		{
+			if (field.getDistance(c, r) != fresh.getDistance(c, r))
+			{
+				return FUZZ_FIELD;
+			}
+		}
+	}
+
+	int distance = field.getDistance(col, row);
+	int hint = field.getHint(col, row);
+	if (hint == HINT_NONE)
+	{
+		return distance == 0 || distance == FIELD_UNREACHABLE ? FUZZ_OK : FUZZ_HINT;
+	}
+	int nextCol = col;
+	int nextRow = row;
+	if (hint == HINT_ENTER)
+	{
+		nextCol = level.getTrigger(col, row).targetCol;
+		nextRow = level.getTrigger(col, row).targetRow;
+	}
+	else
+	{
+		nextCol += COMMAND_DX[hint];
+		nextRow += COMMAND_DY[hint];
+	}
+	return !board.isBlocked(nextCol, nextRow) && field.getDistance(nextCol, nextRow) == distance - 1 ? FUZZ_OK : FUZZ_HINT;
+}
+
+//Compares the ring with a plain copy of what went in
+static bool ringMatches(const CommandRing &commands, const unsigned char *expected, unsigned count)
+{
+	if (commands.size() != count || commands.empty() != (count == 0) || commands.full() != (count == COMMAND_RING_CAPACITY))
+	{
+		return false;
+	}
+	for (unsigned i = 0; i < count; i++)
+	{
+		if (commands.peek(i) != expected[i])
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+//Empties the input ring, checking it gives back what went in, in order
+static bool drainMatches(ConcurrentCommandRing &shared, const unsigned char *expected, unsigned count)
+{
+	if (shared.size() != count)
+	{
+		return false;
+	}
+	Command command;
+	for (unsigned i = 0; i < count; i++)
+	{
+		if (!shared.pop(command) || command != expected[i])
+		{
+			return false;
+		}
+	}
+	return !shared.pop(command) && shared.size() == 0;
+}
+
+void clearCoverage(FuzzCoverage &coverage)
+{
+	memset(coverage.bits, 0, sizeof(coverage.bits));
+	coverage.count = 0;
+}
+
+FuzzFailure runFuzzCase(const unsigned char *data, size_t size, FuzzCoverage *coverage, unsigned long long *steps, FILE *log)
+{
+	unsigned long long random = 0;
+	for (size_t i = 0; i < FUZZ_SEED_BYTES && i < size; i++)
+	{
+		random |= static_cast<unsigned long long>(data[i]) << (8 * i);
+	}
+
+	RockGrid rocks;
+	CollisionMask frogMask;
+	CollisionMask rockMask;
+	Sprite frog;
+	MoveBoard board;
+	Level level;
+	DistanceField field;
+	DistanceField fresh;
+	CommandRing commands;
+	ConcurrentCommandRing shared;
+	std::vector<MoveRun> runs;
+	unsigned char expected[COMMAND_RING_CAPACITY];
+	unsigned expectedCount = 0;
+	unsigned long long stepCount = 0;
+	int col = 0;
+	int row = 0;
+	int round = 0;
+
+	if (log != NULL)
+	{
+		fprintf(log, "round 0, seed %016llx\n", random);
+	}
+	FuzzFailure failure = buildMasks(random, frogMask, rockMask);
+	frog.setColliderSize(frogMask.getWidth(), frogMask.getHeight());
+	frog.setMask(&frogMask);
+	frog.setRocks(&rocks, &rockMask);
+	buildLayout(random, rocks, frog, board, level);
+	field.rebuild(board, level);
+	unsigned long long layoutKey = gZobrist.layout(board, level);
+	addFeature(coverage, 9, board.isBlocked(4, 4) ? 1 : 0, rocks.isSolid(4, 4) ? 1 : 0);
+	size_t at = FUZZ_SEED_BYTES;
+	while (at < size && failure == FUZZ_OK)
+	{
+		int action = data[at++] % 8;
+		stepCount++;
+		addFeature(coverage, 0, action, commands.full() ? 1 : 0);
+
+		switch (action)
+		{
+		case ACTION_UP:
+		case ACTION_DOWN:
+		case ACTION_LEFT:
+		case ACTION_RIGHT:
+		{
+			//A full ring drops the press, like the game does
+			bool pushed = commands.push(static_cast<Command>(action));
+			if (pushed != (expectedCount < COMMAND_RING_CAPACITY) || shared.push(static_cast<Command>(action)) != pushed)
+			{
+				failure = FUZZ_RING;
+			}
+			else if (pushed)
+			{
+				expected[expectedCount++] = static_cast<unsigned char>(action);
+			}
+			if (log != NULL)
+			{
+				fprintf(log, "%c", COMMAND_SYMBOLS[action]);
+			}
+			break;
+		}
+
+		case ACTION_ENTER:
+		{
+			if (commands.empty())
+			{
+				break;
+			}
+			if (!ringMatches(commands, expected, expectedCount) || !drainMatches(shared, expected, expectedCount))
+			{
+				failure = FUZZ_RING;
+				break;
+			}
+			ProgramResult plan = planMoves(commands, board, col, row, runs);
+			failure = checkPlan(commands, frog, col, row, plan, runs);
+			stepCount += plan.moves;
+			commands.clear();
+			expectedCount = 0;
+			if (failure != FUZZ_OK)
+			{
+				break;
+			}
+			if (plan.col < 0 || plan.col >= FROG_COLS || plan.row < 0 || plan.row >= FROG_ROWS)
+			{
+				failure = FUZZ_OFF_BOARD;
+				break;
+			}
+			if ((plan.col != col || plan.row != row) && frog.touchesRock(tileX(plan.col), tileY(plan.row)))
+			{
+				failure = FUZZ_ON_ROCK;
+				break;
+			}
+			col = plan.col;
+			row = plan.row;
+
+			//The trigger under the frog, and under every tile a door takes it to
+			int teleports = 0;
+			int trigger = level.getTrigger(col, row).action;
+			while (trigger == TRIGGER_TELEPORT && teleports < FUZZ_MAX_TELEPORTS)
+			{
+				const CellTrigger &door = level.getTrigger(col, row);
+				col = door.targetCol;
+				row = door.targetRow;
+				teleports++;
+				if (col < 0 || col >= FROG_COLS || row < 0 || row >= FROG_ROWS)
+				{
+					failure = FUZZ_OFF_BOARD;
+					break;
+				}
+				trigger = level.getTrigger(col, row).action;
+			}
+			addFeature(coverage, 1, trigger, teleports);
+			addFeature(coverage, 2, row * FROG_COLS + col, plan.blockedMoves > 0 ? 1 : 0);
+			addFeature(coverage, 3, runs.size() < 16 ? static_cast<unsigned>(runs.size()) : 16, trigger);
+			if (log != NULL)
+			{
+				fprintf(log, " enter: %u moves, %u blocked, on %d,%d, trigger %d after %d doors\n", plan.moves, plan.blockedMoves, col, row, trigger, teleports);
+			}
+			if (failure != FUZZ_OK || trigger == TRIGGER_SAFE)
+			{
+				break;
+			}
+
+			//Home, the pelican, the open or a door loop end the round; the next starts over
+			round++;
+			col = 0;
+			row = 0;
+			buildLayout(random, rocks, frog, board, level);
+			field.rebuild(board, level);
+			layoutKey = gZobrist.layout(board, level);
+			addFeature(coverage, 4, round < 8 ? round : 8, 0);
+			if (log != NULL)
+			{
+				fprintf(log, "round %d\n", round);
+			}
+			break;
+		}
+
+		case ACTION_ROCK:
+		{
+			int cell = (at < size ? data[at++] : 0) % FIELD_CELLS;
+			int rockCol = cell % FROG_COLS;
+			int rockRow = cell / FROG_COLS;
+			//Like the editor: the grid changes, then the frog's mask decides if the tile blocks
+			bool placed = !rocks.isSolid(rockCol, rockRow);
+			if (placed)
+			{
+				rocks.set(rockCol, rockRow);
+			}
+			else
+			{
+				rocks.reset(rockCol, rockRow);
+			}
+			bool blocked = frog.touchesRock(tileX(rockCol), tileY(rockRow));
+			if (blocked != board.isBlocked(rockCol, rockRow))
+			{
+				layoutKey ^= gZobrist.rock(rockCol, rockRow);
+			}
+			if (blocked)
+			{
+				board.block(rockCol, rockRow);
+			}
+			else
+			{
+				board.unblock(rockCol, rockRow);
+			}
+			field.setBlocked(rockCol, rockRow, blocked);
+			failure = layoutKey == gZobrist.layout(board, level) ? checkField(field, fresh, board, level, col, row) : FUZZ_LAYOUT;
+			addFeature(coverage, 5, (placed ? 2 : 0) + (blocked ? 1 : 0), field.getRepaired() < 32 ? field.getRepaired() : 32);
+			if (log != NULL)
+			{
+				fprintf(log, "\n%s rock %d,%d, %s, %d tiles repaired\n", placed ? "put" : "took", rockCol, rockRow, blocked ? "blocking" : "passable", field.getRepaired());
+			}
+			break;
+		}
+
+		case ACTION_TRIGGER:
+		{
+			int cell = (at < size ? data[at++] : 0) % FIELD_CELLS;
+			int kind = (at < size ? data[at++] : 0) % (TRIGGER_TELEPORT + 1);
+			int target = (at < size ? data[at++] : 0) % FIELD_CELLS;
+			int triggerCol = cell % FROG_COLS;
+			int triggerRow = cell / FROG_COLS;
+
+			//Doors only ever lead onto the board
+			layoutKey ^= gZobrist.trigger(triggerCol, triggerRow, level.getTrigger(triggerCol, triggerRow));
+			level.setTrigger(triggerCol, triggerRow, static_cast<TriggerAction>(kind), target % FROG_COLS, target / FROG_COLS);
+			layoutKey ^= gZobrist.trigger(triggerCol, triggerRow, level.getTrigger(triggerCol, triggerRow));
+			field.setTrigger(triggerCol, triggerRow, level.getTrigger(triggerCol, triggerRow));
+			failure = layoutKey == gZobrist.layout(board, level) ? checkField(field, fresh, board, level, col, row) : FUZZ_LAYOUT;
+			addFeature(coverage, 6, kind, field.getRepaired() < 32 ? field.getRepaired() : 32);
+			if (log != NULL)
+			{
+				fprintf(log, "\ntrigger %d on %d,%d to %d,%d, %d tiles repaired\n", kind, triggerCol, triggerRow, target % FROG_COLS, target / FROG_COLS, field.getRepaired());
+			}
+			break;
+		}
+
+		case ACTION_PROGRAM:
+		{
+			std::string source;
+			int deepest = 0;
+			writeBlock(data, size, at, 0, 0, deepest, source);
+
+			Program program;
+			bool compiled = program.compile(source.c_str());
+			addFeature(coverage, 7, compiled ? 1 : 0, compiled ? static_cast<unsigned>(program.getCode().size() & 63) : static_cast<unsigned char>(program.getError()[0]));
+			addFeature(coverage, 10, compiled ? 1 : 0, deepest);
+			if (log != NULL)
+			{
+				fprintf(log, "\nprogram \"%s\": %s\n", source.c_str(), compiled ? "compiled" : program.getError());
+			}
+			if (!compiled)
+			{
+				break;
+			}
+
+			//Like the P key it starts where the queued moves end, and its end
+			//tile must match moving the sprite through the moves it traced
+			ProgramResult queued = planMoves(commands, board, col, row, runs);
+			CommandRing trace;
+			ProgramResult result = program.run(board, queued.col, queued.row, FUZZ_PROGRAM_BUDGET, &trace);
+			stepCount += result.steps;
+			addFeature(coverage, 8, result.status, result.moves < 64 ? result.moves : 64);
+			if (result.moves <= COMMAND_RING_CAPACITY)
+			{
+				unsigned blocked = stepSprite(frog, trace, queued.col, queued.row);
+				if (trace.size() != result.moves || frog.getPositionX() != tileX(result.col) || frog.getPositionY() != tileY(result.row) || blocked != result.blockedMoves)
+				{
+					failure = FUZZ_PROGRAM;
+					break;
+				}
+			}
+
+			//Queued like the P key does, all of it or none when it doesn't fit
+			bool fits = result.moves <= COMMAND_RING_CAPACITY - commands.size();
+			addFeature(coverage, 11, fits ? 1 : 0, 0);
+			for (unsigned i = 0; fits && i < trace.size(); i++)
+			{
+				if (!commands.push(trace.peek(i)) || !shared.push(trace.peek(i)))
+				{
+					failure = FUZZ_RING;
+				}
+				expected[expectedCount++] = static_cast<unsigned char>(trace.peek(i));
+			}
+			if (failure != FUZZ_OK || !ringMatches(commands, expected, expectedCount) || shared.size() != expectedCount)
+			{
+				failure = FUZZ_RING;
+				break;
+			}
+
+			//The whole queue then ends where the program did
+			if (fits)
+			{
+				ProgramResult plan = planMoves(commands, board, col, row, runs);
+				if (plan.col != result.col || plan.row != result.row)
+				{
+					failure = FUZZ_PROGRAM;
+				}
+			}
+			break;
+		}
+		}
+
+		if (failure == FUZZ_OK && (col < 0 || col >= FROG_COLS || row < 0 || row >= FROG_ROWS))
+		{
+			failure = FUZZ_OFF_BOARD;
+		}
+	}
+
+	if (log != NULL)
+	{
+		fprintf(log, "\n%s\n", fuzzFailureName(failure));
+	}
+	if (steps != NULL)
+	{
+		*steps += stepCount;
+	}
+	return failure;
+}
+
+unsigned shrinkFuzzCase(std::vector<unsigned char> &data, FuzzFailure failure)
+{
+	unsigned runs = 0;
+	if (data.size() <= FUZZ_SEED_BYTES)
+	{
+		return runs;
+	}
+
+	//Drop ever smaller chunks of actions while the case fails the same way
+	std::vector<unsigned char> candidate;
+	for (size_t chunk = (data.size() - FUZZ_SEED_BYTES + 1) / 2; chunk > 0; chunk /= 2)
+	{
+		size_t at = FUZZ_SEED_BYTES;
+		while (at + chunk <= data.size())
+		{
+			candidate.assign(data.begin(), data.begin() + at);
+			candidate.insert(candidate.end(), data.begin() + at + chunk, data.end());
+			runs++;
+			if (runFuzzCase(&candidate[0], candidate.size(), NULL) == failure)
+			{
+				data.swap(candidate);
+			}
+			else
+			{
+				at += chunk;
+			}
+		}
+	}
+
+	//Then lower what's left, small values read best in a replay
+	for (size_t i = FUZZ_SEED_BYTES; i < data.size(); i++)
+	{
+		unsigned char original = data[i];
+		for (unsigned char value = original % 8; value < original; value += 8)
+		{
+			data[i] = value;
+			runs++;
+			if (runFuzzCase(&data[0], data.size(), NULL) == failure)
+			{
+				original = value;
+				break;
+			}
+		}
+		data[i] = original;
+	}
+	return runs;
+}
+
+const char *fuzzFailureName(FuzzFailure failure)
+{
+	return failure >= FUZZ_OK && failure < FUZZ_FAILURE_COUNT ? FAILURE_NAMES[failure] : "unknown";
+}
+
+//Makes the next case: a fresh random one, or a mutation of one that found something new
+static void makeCase(unsigned long long &random, const std::vector<std::vector<unsigned char> > &corpus, std::vector<unsigned char> &input)
+{
+	if (corpus.empty() || nextRandom(random) % 4 == 0)
+	{
+		input.resize(FUZZ_SEED_BYTES + 16 + nextRandom(random) % 496);
+		for (size_t i = 0; i < input.size(); i++)
+		{
+			input[i] = static_cast<unsigned char>(nextRandom(random));
+		}
+		return;
+	}
+
+	input = corpus[nextRandom(random) % corpus.size()];
+	int mutations = 1 + static_cast<int>(nextRandom(random) % 4);
+	for (int m = 0; m < mutations; m++)
+	{
+		size_t at = nextRandom(random) % input.size();
+		switch (nextRandom(random) % 5)
+		{
+		case 0:
+			input[at] ^= static_cast<unsigned char>(1u << (nextRandom(random) % 8));
+			break;
+		case 1:
+			input[at] = static_cast<unsigned char>(nextRandom(random));
+			break;
+		case 2:
+			if (input.size() < FUZZ_MAX_CASE)
+			{
+				input.insert(input.begin() + at, static_cast<unsigned char>(nextRandom(random)));
+			}
+			break;
+		case 3:
+			if (input.size() > FUZZ_SEED_BYTES + 1 && at >= FUZZ_SEED_BYTES)
+			{
+				input.erase(input.begin() + at);
+			}
+			break;
+		default:
+		{
+			//Splice in the tail of another case that found something
+			const std::vector<unsigned char> &other = corpus[nextRandom(random) % corpus.size()];
+			size_t from = FUZZ_SEED_BYTES + nextRandom(random) % (other.size() - FUZZ_SEED_BYTES + 1);
+			if (at >= FUZZ_SEED_BYTES && at + (other.size() - from) <= FUZZ_MAX_CASE)
+			{
+				input.resize(at);
+				input.insert(input.end(), other.begin() + from, other.end());
+			}
+			break;
+		}
+		}
+	}
+}
+
+//Wraps inner in depth nested "repeat 1 { }" blocks
+static std::string nestProgram(int depth, const char *inner)
+{
+	std::string source;
+	for (int i = 0; i < depth; i++)
+	{
+		source += "repeat 1 { ";
+	}
+	source += inner;
+	for (int i = 0; i < depth; i++)
+	{
+		source += " }";
+	}
+	return source;
+}
+
+//Programs that once broke the interpreter, checked before every fuzzing run
+static FuzzFailure checkRegressions()
+{
+	MoveBoard board;
+
+	//A counted move inside the deepest repeat needed one counter more than
+	//the interpreter has, so it must not compile
+	Program program;
+	if (program.compile(nestProgram(PROGRAM_MAX_DEPTH, "right 2").c_str()))
+	{
+		return FUZZ_PROGRAM;
+	}
+
+	//One level up it still fits and moves the frog two tiles
+	if (!program.compile(nestProgram(PROGRAM_MAX_DEPTH - 1, "right 2").c_str()))
+	{
+		return FUZZ_PROGRAM;
+	}
+	ProgramResult result = program.run(board, 0, 0);
+	return result.status == PROGRAM_FINISHED && result.col == 2 && result.row == 0 ? FUZZ_OK : FUZZ_PROGRAM;
+}
+
+//Streams commands from an input thread to this one through the ring, the
+//way it is meant to be used, and checks none are lost or reordered
+static FuzzFailure checkConcurrentRing(unsigned long long seed)
+{
+	static const unsigned COMMANDS = 1 << 20;
+	ConcurrentCommandRing shared;
+	std::thread producer([&shared, seed]()
+	{
+		unsigned long long random = seed;
+		for (unsigned i = 0; i < COMMANDS; i++)
+		{
+			Command command = static_cast<Command>(nextRandom(random) & 3);
+			while (!shared.push(command))
+			{
+				std::this_thread::yield();
+			}
+		}
+	});
+
+	unsigned long long random = seed;
+	bool matches = true;
+	for (unsigned i = 0; i < COMMANDS; i++)
+	{
+		Command command;
+		while (!shared.pop(command))
+		{
+			std::this_thread::yield();
+		}
+		matches = matches && command == static_cast<Command>(nextRandom(random) & 3);
+	}
+	producer.join();
+	return matches && shared.size() == 0 ? FUZZ_OK : FUZZ_RING;
+}
+
+//Collects the pairs the broad phase reports, smaller handle first
+struct PairCollector
+{
+	std::vector<std::pair<int, int> > pairs;
+
+	void operator()(int a, int b)
+	{
+		pairs.push_back(a < b ? std::make_pair(a, b) : std::make_pair(b, a));
+	}
+};
+
+//Moves, adds and removes boxes, removing some twice, and checks after every
+//step that sweep and prune finds exactly the pairs testing every pair finds
+static FuzzFailure checkBroadPhase(unsigned long long seed)
+{
+	static const int BOXES = 48;
+	SweepAndPrune broadPhase;
+	Box boxes[BOXES];
+	int handles[BOXES];
+	bool live[BOXES];
+	int liveCount = 0;
+	for (int i = 0; i < BOXES; i++)
+	{
+		live[i] = false;
+	}
+
+	unsigned long long random = seed;
+	for (int step = 0; step < 4096; step++)
+	{
+		int i = rollRandom(random, 0, BOXES);
+		int action = rollRandom(random, 0, 8);
+		if (!live[i] || action == 0)
+		{
+			//Small steps like a frame's movement, sometimes a jump anywhere
+			Box box;
+			box.x = live[i] && action != 0 ? boxes[i].x + rollRandom(random, -8, 9) : static_cast<float>(rollRandom(random, 0, SCREEN_WIDTH));
+			box.y = live[i] && action != 0 ? boxes[i].y + rollRandom(random, -8, 9) : static_cast<float>(rollRandom(random, 0, SCREEN_HEIGHT));
+			box.w = static_cast<float>(rollRandom(random, 1, 2 * TILE_SIZE));
+			box.h = static_cast<float>(rollRandom(random, 1, 2 * TILE_SIZE));
+			if (!live[i])
+			{
+				handles[i] = broadPhase.add(box);
+				live[i] = true;
+				liveCount++;
+			}
+			else
+			{
+				broadPhase.update(handles[i], box);
+			}
+			boxes[i] = box;
+		}
+		else if (action == 1)
+		{
+			broadPhase.remove(handles[i]);
+			if (rollRandom(random, 0, 2) == 0)
+			{
+				broadPhase.remove(handles[i]);
+			}
+			live[i] = false;
+			liveCount--;
+		}
+		else
+		{
+			boxes[i].x += rollRandom(random, -8, 9);
+			boxes[i].y += rollRandom(random, -8, 9);
+			broadPhase.update(handles[i], boxes[i]);
+		}
+
+		PairCollector found;
+		broadPhase.findPairs(found);
+		PairCollector expected;
+		for (int a = 0; a < BOXES; a++)
+		{
+			for (int b = a + 1; b < BOXES; b++)
+			{
+				if (live[a] && live[b] && boxes[a].x < boxes[b].x + boxes[b].w && boxes[b].x < boxes[a].x + boxes[a].w &&
+					boxes[a].y < boxes[b].y + boxes[b].h && boxes[b].y < boxes[a].y + boxes[a].h)
+				{
+					expected(handles[a], handles[b]);
+				}
+			}
+		}
+		std::sort(found.pairs.begin(), found.pairs.end());
+		std::sort(expected.pairs.begin(), expected.pairs.end());
+		if (found.pairs != expected.pairs || broadPhase.getCount() != liveCount)
+		{
+			return FUZZ_PAIRS;
+		}
+	}
+	return FUZZ_OK;
+}
+
+int runFuzzer(unsigned long long seed, int seconds, const char *crashFile)
+{
+	FuzzFailure regression = checkRegressions();
+	if (regression == FUZZ_OK)
+	{
+		regression = checkConcurrentRing(seed);
+	}
+	if (regression == FUZZ_OK)
+	{
+		regression = checkBroadPhase(seed);
+	}
+	if (regression != FUZZ_OK)
+	{
+		printf("Regression check failed (%s)\n", fuzzFailureName(regression));
+		return 8;
+	}
+
+	FuzzCoverage coverage;
+	clearCoverage(coverage);
+	std::vector<std::vector<unsigned char> > corpus;
+	std::vector<unsigned char> input;
+	unsigned long long random = seed;
+	unsigned long long cases = 0;
+	unsigned long long steps = 0;
+	FuzzFailure failure = FUZZ_OK;
+
+	Uint64 start = SDL_GetPerformanceCounter();
+	Uint64 stop = start + static_cast<Uint64>(seconds) * SDL_GetPerformanceFrequency();
+	while (failure == FUZZ_OK)
+	{
+		if ((cases & 1023) == 0 && SDL_GetPerformanceCounter() >= stop)
+		{
+			break;
+		}
+		makeCase(random, corpus, input);
+		unsigned before = coverage.count;
+		failure = runFuzzCase(&input[0], input.size(), &coverage, &steps);
+		cases++;
+
+		//Cases that reach something new are worth mutating further
+		if (coverage.count != before)
+		{
+			corpus.push_back(input);
+		}
+	}
+	double elapsed = (SDL_GetPerformanceCounter() - start) / static_cast<double>(SDL_GetPerformanceFrequency());
+	printf("Fuzzed %llu cases, %llu steps in %.1f s: %.2f M steps/s, %u features, %u cases in the corpus\n", cases, steps, elapsed, steps / elapsed / 1e6, coverage.count, static_cast<unsigned>(corpus.size()));
+	if (failure == FUZZ_OK)
+	{
+		return 0;
+	}
+
+	size_t original = input.size();
+	unsigned runs = shrinkFuzzCase(input, failure);
+	printf("Case failed (%s), shrunk from %u to %u bytes in %u runs:\n", fuzzFailureName(failure), static_cast<unsigned>(original), static_cast<unsigned>(input.size()), runs);
+	runFuzzCase(&input[0], input.size(), NULL, NULL, stdout);
+
+	FILE *file = fopen(crashFile, "wb");
+	if (file == NULL || fwrite(&input[0], 1, input.size(), file) != input.size())
+	{
+		printf("Failed to save the case to %s\n", crashFile);
+	}
+	else
+	{
+		printf("Saved the case to %s, replay it with --fuzz-replay\n", crashFile);
+	}
+	if (file != NULL)
+	{
+		fclose(file);
+	}
+	return 8;
+}
+
+int replayFuzzCase(const char *file)
+{
+	FILE *in = fopen(file, "rb");
+	if (in == NULL)
+	{
+		printf("Failed to open %s\n", file);
+		return 8;
+	}
+	std::vector<unsigned char> data;
+	unsigned char buffer[4096];
+	size_t read;
+	while ((read = fread(buffer, 1, sizeof(buffer), in)) > 0)
+	{
+		data.insert(data.end(), buffer, buffer + read);
+	}
+	fclose(in);
+
+	//An empty case still plays a round with the zero seed
+	data.resize(data.size() > FUZZ_SEED_BYTES ? data.size() : FUZZ_SEED_BYTES);
+	return runFuzzCase(&data[0], data.size(), NULL, NULL, stdout) == FUZZ_OK ? 0 : 8;
+}
+
+#ifdef FROG_FUZZER
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	FuzzFailure failure = runFuzzCase(data, size, NULL);
+	if (failure != FUZZ_OK)
+	{
+		//Let libFuzzer save the case; --fuzz-replay prints it
+		fprintf(stderr, "Fuzz case failed: %s\n", fuzzFailureName(failure));
+		abort();
+	}
+	return 0;
+}
+#endif
@@ -0,0 +1,134 @@
+#pragma once
+#include <stddef.h>
+#include <stdio.h>
+#include <vector>
+
+/*
+* Headless fuzzing of the game rules. A case is an 8 byte seed for the layout
+* and the frog and rock images, then a stream of actions: arrows, enter,
+* editor rock and trigger changes, and typed-in command programs. runFuzzCase
+* replays a case against the same collision masks, Sprite, MoveBoard, Level,
+* command rings, interpreter and hint field the game uses, checking after
+* every action that the pieces still agree with each other. Programs are
+* written by a grammar that favours repeat blocks, so they nest past
+* PROGRAM_MAX_DEPTH.
+*
+* runFuzzer is the standalone driver: it mutates a corpus of cases that reach
+* new features, shrinks the first failing case to a minimal replay and saves
+* it. Before that it streams commands through a ConcurrentCommandRing from a
+* second thread, build with -fsanitize=thread to check the ring's ordering,
+* and compares the sweep and prune broad phase with testing every pair.
+*
+* Built with FROG_FUZZER defined, fuzz.cpp also has a libFuzzer entry point;
+* link it with the headless modules only, for example
+*
+*   clang++ -DFROG_FUZZER -fsanitize=fuzzer,address,undefined fuzz.cpp
+*       program.cpp level.cpp commandring.cpp distancefield.cpp sprite.cpp
+*       collision.cpp collisionmask.cpp imagescan.cpp zobrist.cpp broadphase.cpp
+*       -lSDL2 -lSDL2_image
+*/
+
+//Bytes of layout seed at the start of every case
+const size_t FUZZ_SEED_BYTES = 8;
+
+//Instructions a fuzzed program may run before it is stopped
+const unsigned FUZZ_PROGRAM_BUDGET = 4096;
+
+//Doors followed in one enter press before the frog is taken as stuck
+const int FUZZ_MAX_TELEPORTS = 8;
+
+//Features the coverage map tracks, a power of two
+const unsigned FUZZ_FEATURES = 1 << 14;
+
+enum FuzzFailure
+{
+	FUZZ_OK,
+
+	//The frog left the tiles it can stand on
+	FUZZ_OFF_BOARD,
+
+	//A move or a door put the frog on a rock
+	FUZZ_ON_ROCK,
+
+	//The command ring lost, reordered or made up a command
+	FUZZ_RING,
+
+	//planMoves disagrees with moving the sprite one command at a time
+	FUZZ_PLAN,
+
+	//A program's end tile disagrees with moving the sprite through its trace
+	FUZZ_PROGRAM,
+
+	//The repaired hint field disagrees with one built from scratch
+	FUZZ_FIELD,
+
+	//A hint doesn't lead a step closer to home
+	FUZZ_HINT,
+
+	//A collision mask or an image scan disagrees with the pixels it came from
+	FUZZ_MASK,
+
+	//The layout key kept up edit by edit disagrees with hashing the layout
+	FUZZ_LAYOUT,
+
+	//The broad phase missed an overlapping pair or made one up
+	FUZZ_PAIRS,
+
+	FUZZ_FAILURE_COUNT
+};
+
+//Features a case reached, one bit each
+struct FuzzCoverage
+{
+	unsigned char bits[FUZZ_FEATURES / 8];
+	unsigned count;
+};
+
+/**
+* Empties a coverage map
+* @param coverage The map to clear
+*/
+void clearCoverage(FuzzCoverage &coverage);
+
+/**
+* Replays one case against the headless game rules
+* @param data The case: a layout seed, then actions
+* @param size Bytes in data
+* @param coverage Features reached are added here, or nullptr to skip tracking
+* @param steps Actions and moves run are added here, or nullptr
+* @param log Each action is printed here as it runs, or nullptr
+* @return the first invariant broken, FUZZ_OK if none was
+*/
+FuzzFailure runFuzzCase(const unsigned char *data, size_t size, FuzzCoverage *coverage, unsigned long long *steps = NULL, FILE *log = NULL);
+
+/**
+* Shrinks a failing case while it keeps failing the same way
+* @param data The case, replaced by the smallest one found
+* @param failure How the case fails
+* @return cases run while shrinking
+*/
+unsigned shrinkFuzzCase(std::vector<unsigned char> &data, FuzzFailure failure);
+
+/**
+* Short name of a failure for logs
+* @param failure The failure
+* @return the name
+*/
+const char *fuzzFailureName(FuzzFailure failure);
+
+/**
+* Fuzzes the game rules until time runs out or a case fails; a failing case is
+* shrunk, printed as a replay and saved
+* @param seed Seed for the fuzzer's own choices
+* @param seconds How long to run
+* @param crashFile Where a failing case is saved
+* @return 0 when nothing failed, otherwise the exit code for the failure
+*/
+int runFuzzer(unsigned long long seed, int seconds, const char *crashFile);
+
+/**
+* Replays a saved case, printing every action
+* @param file The case file
+* @return 0 when the case passes, otherwise the exit code for the failure
+*/
+int replayFuzzCase(const char *file);
@@ -0,0 +1,390 @@
+#include "grader.h"
+#include <stdio.h>
+#include <string.h>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+#if defined(_MSC_VER)
+#include <SDL.h>
+#else
+#include <SDL2/SDL.h>
+#endif
+#include "distancefield.h"
+#include "jobs.h"
+
+//Distinct pairs each grading job takes
+static const int GRADE_GRAIN = 32;
+
+static const char *OUTCOME_NAMES[] = { "home", "pelican", "door", "hidden", "caught", "timeout", "error" };
+
+//FNV-1a, continuing from hash
+static unsigned long long hashBytes(unsigned long long hash, const void *data, size_t size)
+{
+	const unsigned char *bytes = static_cast<const unsigned char *>(data);
+	for (size_t i = 0; i < size; i++)
+	{
+		hash = (hash ^ bytes[i]) * 1099511628211ULL;
+	}
+	return hash;
+}
+
+static const unsigned long long HASH_SEED = 14695981039346656037ULL;
+
+//Strips trailing spaces and carriage returns left by other platforms
+static void trimRight(std::string &line)
+{
+	while (!line.empty() && (line[line.size() - 1] == '\r' || line[line.size() - 1] == ' ' || line[line.size() - 1] == '\t'))
+	{
+		line.erase(line.size() - 1);
+	}
+}
+
+//Checks a parsed level and fills in its doors and hash
+static bool finishLevel(GradeLevel &level, const std::vector<std::string> &rows, const int doors[26][2], const char *file)
+{
+	if (level.startCol < 0)
+	{
+		printf("%s: level %s has no F for the frog\n", file, level.name.c_str());
+		return false;
+	}
+
+	unsigned long long hash = HASH_SEED;
+	for (int row = 0; row < FROG_ROWS; row++)
+	{
+		for (int col = 0; col < FROG_COLS; col++)
+		{
+			char tile = col < static_cast<int>(rows[row].size()) ? rows[row][col] : '.';
+			if (tile >= 'a' && tile <= 'z')
+			{
+				const int *target = doors[tile - 'a'];
+				if (target[0] < 0)
+				{
+					printf("%s: level %s has door %c without a door line\n", file, level.name.c_str(), tile);
+					return false;
+				}
+				level.triggers.setTrigger(col, row, TRIGGER_TELEPORT, target[0], target[1]);
+				hash = hashBytes(hash, target, 2 * sizeof(int));
+			}
+			hash = hashBytes(hash, &tile, 1);
+		}
+	}
+	level.hash = hash;
+
+	//Not an error, but no program can pass it; the field follows doors too
+	DistanceField field;
+	field.rebuild(level.board, level.triggers);
+	if (field.getDistance(level.startCol, level.startRow) == FIELD_UNREACHABLE)
+	{
+		printf("%s: warning: home can't be reached in level %s\n", file, level.name.c_str());
+	}
+	return true;
+}
+
+bool loadLevels(const char *file, std::vector<GradeLevel> &levels)
+{
+	std::ifstream in(file);
+	if (!in)
+	{
+		printf("Failed to open level set %s\n", file);
+		return false;
+	}
+
+	levels.clear();
+	std::vector<std::string> rows;
+	int doors[26][2];
+	bool inLevel = false;
+	int lineNumber = 0;
+	std::string line;
+	for (;;)
+	{
+		bool more = static_cast<bool>(std::getline(in, line));
+		lineNumber++;
+		if (more)
+		{
+			trimRight(line);
+		}
+
+		//A new level or the end of the file closes the one being read
+		if (inLevel && (!more || line.compare(0, 6, "level ") == 0))
+		{
+			if (static_cast<int>(rows.size()) < FROG_ROWS)
+			{
+				printf("%s: level %s has %d rows, not %d\n", file, levels.back().name.c_str(), static_cast<int>(rows.size()), FROG_ROWS);
+				return false;
+			}
+			if (!finishLevel(levels.back(), rows, doors, file))
+			{
+				return false;
+			}
+			inLevel = false;
+		}
+		if (!more)
+		{
+			break;
+		}
+		if (line.empty() || line.compare(0, 2, "//") == 0)
+		{
+			continue;
+		}
+
+		if (line.compare(0, 6, "level ") == 0)
+		{
+			levels.push_back(GradeLevel());
+			GradeLevel &level = levels.back();
+			level.name = line.substr(6);
+			level.startCol = -1;
+			level.startRow = -1;
+			level.triggers.reset();
+
+			//Only the tiles in the file count, not the game's built-in layout
+			for (int row = 0; row < BOARD_ROWS; row++)
+			{
+				for (int col = 0; col < BOARD_COLS; col++)
+				{
+					level.triggers.setTrigger(col, row, TRIGGER_NONE);
+				}
+			}
+			rows.clear();
+			memset(doors, -1, sizeof(doors));
+			inLevel = true;
+			continue;
+		}
+		if (!inLevel)
+		{
+			printf("%s:%d: expected a level line\n", file, lineNumber);
+			return false;
+		}
+
+		GradeLevel &level = levels.back();
+		char letter;
+		int col, row;
+		if (sscanf(line.c_str(), "door %c %d %d", &letter, &col, &row) == 3)
+		{
+			if (letter < 'a' || letter > 'z' || col < 0 || col >= FROG_COLS || row < 0 || row >= FROG_ROWS)
+			{
+				printf("%s:%d: bad door line\n", file, lineNumber);
+				return false;
+			}
+			doors[letter - 'a'][0] = col;
+			doors[letter - 'a'][1] = row;
+			continue;
+		}
+		if (static_cast<int>(rows.size()) == FROG_ROWS)
+		{
+			printf("%s:%d: level %s has too many rows\n", file, lineNumber, level.name.c_str());
+			return false;
+		}
+
+		row = static_cast<int>(rows.size());
+		for (col = 0; col < static_cast<int>(line.size()) && col < FROG_COLS; col++)
+		{
+			switch (line[col])
+			{
+			case '#': level.board.block(col, row); break;
+			case 'F': level.startCol = col; level.startRow = row; level.triggers.setTrigger(col, row, TRIGGER_SAFE); break;
+			case 'S': level.triggers.setTrigger(col, row, TRIGGER_SAFE); break;
+			case 'H': level.triggers.setTrigger(col, row, TRIGGER_HOME); break;
+			case 'P': level.triggers.setTrigger(col, row, TRIGGER_BIRD); break;
+			case '.': break;
+			default:
+				if (line[col] < 'a' || line[col] > 'z')
+				{
+					printf("%s:%d: unknown tile '%c'\n", file, lineNumber, line[col]);
+					return false;
+				}
+				break;
+			}
+		}
+		rows.push_back(line);
+	}
+	return true;
+}
+
+bool loadSubmissions(const char *file, std::vector<Submission> &submissions)
+{
+	std::ifstream in(file);
+	if (!in)
+	{
+		printf("Failed to open submissions %s\n", file);
+		return false;
+	}
+
+	submissions.clear();
+	std::string line;
+	while (std::getline(in, line))
+	{
+		trimRight(line);
+		size_t colon = line.find(':');
+		if (line.empty() || line[0] == '#' || colon == std::string::npos)
+		{
+			continue;
+		}
+
+		submissions.push_back(Submission());
+		Submission &submission = submissions.back();
+		submission.student = line.substr(0, colon);
+		submission.compiled = submission.program.compile(line.c_str() + colon + 1);
+		if (!submission.compiled)
+		{
+			printf("%s: %s\n", submission.student.c_str(), submission.program.getError());
+		}
+		const std::vector<unsigned char> &code = submission.program.getCode();
+		submission.hash = hashBytes(HASH_SEED, &code[0], code.size());
+	}
+	return true;
+}
+
+size_t gradeClass(const std::vector<GradeLevel> &levels, const std::vector<Submission> &submissions, std::vector<GradeResult> &results)
+{
+	//Each distinct program is run once per distinct level
+	std::vector<size_t> programOf(submissions.size());
+	std::vector<size_t> uniquePrograms;
+	std::unordered_map<unsigned long long, size_t> programIndex;
+	for (size_t i = 0; i < submissions.size(); i++)
+	{
+		unsigned long long key = submissions[i].compiled ? submissions[i].hash : 0;
+		std::unordered_map<unsigned long long, size_t>::iterator it = programIndex.find(key);
+		if (it == programIndex.end())
+		{
+			it = programIndex.insert(std::make_pair(key, uniquePrograms.size())).first;
+			uniquePrograms.push_back(i);
+		}
+		programOf[i] = it->second;
+	}
+
+	std::vector<size_t> levelOf(levels.size());
+	std::vector<size_t> uniqueLevels;
+	std::unordered_map<unsigned long long, size_t> levelIndex;
+	for (size_t i = 0; i < levels.size(); i++)
+	{
+		std::unordered_map<unsigned long long, size_t>::iterator it = levelIndex.find(levels[i].hash);
+		if (it == levelIndex.end())
+		{
+			it = levelIndex.insert(std::make_pair(levels[i].hash, uniqueLevels.size())).first;
+			uniqueLevels.push_back(i);
+		}
+		levelOf[i] = it->second;
+	}
+
+	//Every job writes its own slots, so no locking
+	size_t levelCount = uniqueLevels.size();
+	std::vector<GradeResult> memo(uniquePrograms.size() * levelCount);
+	gJobs.parallelFor(static_cast<int>(memo.size()), GRADE_GRAIN, [&](int begin, int end)
+	{
+		for (int i = begin; i < end; i++)
+		{
+			const Submission &submission = submissions[uniquePrograms[i / levelCount]];
+			const GradeLevel &level = levels[uniqueLevels[i % levelCount]];
+			GradeResult &result = memo[i];
+			if (!submission.compiled)
+			{
+				result.outcome = GRADE_ERROR;
+				result.moves = 0;
+				result.steps = 0;
+				continue;
+			}
+
+			ProgramResult run = submission.program.run(level.board, level.startCol, level.startRow);
+			result.moves = run.moves;
+			result.steps = run.steps;
+			if (run.status == PROGRAM_OUT_OF_STEPS)
+			{
+				result.outcome = GRADE_TIMEOUT;
+				continue;
+			}
+			switch (level.triggers.getTrigger(run.col, run.row).action)
+			{
+			case TRIGGER_HOME: result.outcome = GRADE_HOME; break;
+			case TRIGGER_BIRD: result.outcome = GRADE_PELICAN; break;
+			case TRIGGER_TELEPORT: result.outcome = GRADE_DOOR; break;
+			case TRIGGER_SAFE: result.outcome = GRADE_HIDDEN; break;
+			default: result.outcome = GRADE_CAUGHT; break;
+			}
+		}
+	});
+
+	results.resize(submissions.size() * levels.size());
+	for (size_t s = 0; s < submissions.size(); s++)
+	{
+		for (size_t l = 0; l < levels.size(); l++)
+		{
+			results[s * levels.size() + l] = memo[programOf[s] * levelCount + levelOf[l]];
+		}
+	}
+	return memo.size();
+}
+
+//Quotes a CSV field when it needs it
+static std::string csvField(const std::string &text)
+{
+	if (text.find_first_of(",\"\n") == std::string::npos)
+	{
+		return text;
+	}
+	std::string quoted = "\"";
+	for (size_t i = 0; i < text.size(); i++)
+	{
+		if (text[i] == '"')
+		{
+			quoted += '"';
+		}
+		quoted += text[i];
+	}
+	return quoted + "\"";
+}
+
+int runGrader(const char *levelFile, const char *submissionFile, const char *csvFile)
+{
+	std::vector<GradeLevel> levels;
+	std::vector<Submission> submissions;
+	if (!loadLevels(levelFile, levels) || !loadSubmissions(submissionFile, submissions))
+	{
+		return 6;
+	}
+
+	Uint64 start = SDL_GetPerformanceCounter();
+	std::vector<GradeResult> results;
+	size_t runs = gradeClass(levels, submissions, results);
+	double ms = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+
+	std::ofstream file;
+	if (csvFile != NULL)
+	{
+		file.open(csvFile);
+		if (!file)
+		{
+			printf("Failed to write %s\n", csvFile);
+			return 6;
+		}
+	}
+	std::ostream &out = csvFile != NULL ? static_cast<std::ostream &>(file) : std::cout;
+
+	//One row per student: how many levels they got home on, their total moves, then each level
+	out << "student,passed,moves";
+	for (size_t l = 0; l < levels.size(); l++)
+	{
+		out << ',' << csvField(levels[l].name);
+	}
+	out << '\n';
+	for (size_t s = 0; s < submissions.size(); s++)
+	{
+		const GradeResult *row = &results[s * levels.size()];
+		int passed = 0;
+		unsigned moves = 0;
+		for (size_t l = 0; l < levels.size(); l++)
+		{
+			passed += row[l].outcome == GRADE_HOME ? 1 : 0;
+			moves += row[l].moves;
+		}
+		out << csvField(submissions[s].student) << ',' << passed << ',' << moves;
+		for (size_t l = 0; l < levels.size(); l++)
+		{
+			out << ',' << OUTCOME_NAMES[row[l].outcome];
+		}
+		out << '\n';
+	}
+
+	//The CSV may be on standard output, so the summary goes to standard error
+	fprintf(stderr, "Graded %u students on %u levels in %.2f ms, %u distinct runs\n", static_cast<unsigned>(submissions.size()), static_cast<unsigned>(levels.size()), ms, static_cast<unsigned>(runs));
+	return 0;
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "level.h"
+#include "program.h"
+
+/*
+* Batch grading of a whole class's command programs against a level set.
+* Every program is compiled once and every level parsed once; the distinct
+* (level, program) pairs then run on the shared job system, so students who
+* handed in the same program cost one run per level.
+*
+* A level set is a text file of levels, each a "level <name>" line followed
+* by FROG_ROWS rows of FROG_COLS tiles:
+*
+*   .  open ground       #  rock          F  the frog's start
+*   S  hiding place      H  home          P  door to the pelican
+*   a-z  door to the tile given by a "door <letter> <col> <row>" line
+*
+* Lines starting with // are comments. A submission file has one
+* "student: program" line per student.
+*/
+
+enum GradeOutcome
+{
+	GRADE_HOME,
+	GRADE_PELICAN,
+	GRADE_DOOR,
+	GRADE_HIDDEN,
+	GRADE_CAUGHT,
+	GRADE_TIMEOUT,
+	GRADE_ERROR
+};
+
+struct GradeLevel
+{
+	std::string name;
+	MoveBoard board;
+	Level triggers;
+	int startCol;
+	int startRow;
+
+	//Hash of the level's tiles and doors, equal for identical levels
+	unsigned long long hash;
+};
+
+struct Submission
+{
+	std::string student;
+	Program program;
+	bool compiled;
+
+	//Hash of the compiled code, equal for programs that do the same thing
+	unsigned long long hash;
+};
+
+struct GradeResult
+{
+	GradeOutcome outcome;
+	unsigned moves;
+	unsigned steps;
+};
+
+/**
+* Reads a level set
+* @param file The level set file
+* @param levels Filled with the levels read
+* @return false if the file couldn't be read or a level is malformed
+*/
+bool loadLevels(const char *file, std::vector<GradeLevel> &levels);
+
+/**
+* Reads and compiles a class's submissions; programs that fail to compile are
+* kept and graded as errors
+* @param file The submission file
+* @param submissions Filled with the submissions read
+* @return false if the file couldn't be read
+*/
+bool loadSubmissions(const char *file, std::vector<Submission> &submissions);
+
+/**
+* Grades every submission against every level on gJobs
+* @param levels The level set
+* @param submissions The class's submissions
+* @param results Filled with submission-major results, submissions.size() * levels.size() of them
+* @return the number of distinct (level, program) pairs that were run
+*/
+size_t gradeClass(const std::vector<GradeLevel> &levels, const std::vector<Submission> &submissions, std::vector<GradeResult> &results);
+
+/**
+* Loads, grades and writes one CSV row per student
+* @param levelFile The level set file
+* @param submissionFile The submission file
+* @param csvFile Where the CSV goes, or nullptr for standard output
+* @return 0 on success, otherwise the exit code for the failure
+*/
+int runGrader(const char *levelFile, const char *submissionFile, const char *csvFile);
@@ -0,0 +1,348 @@
+#include "hotreload.h"
+#include <stdio.h>
+#include <sys/stat.h>
+#include "alloctrack.h"
+#include "imagescan.h"
+#include "jobs.h"
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <errno.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+HotReload gHotReload;
+
+//Modification time and size of a file folded together, 0 if it can't be read;
+//the size catches saves within the same second
+static Sint64 fileStamp(const std::string &path)
+{
+	struct stat info;
+	if (stat(path.c_str(), &info) != 0)
+	{
+		return 0;
+	}
+	return static_cast<Sint64>(info.st_mtime) * 1000003 + static_cast<Sint64>(info.st_size);
+}
+
+HotReload::HotReload()
+{
+	//Initialize
+	mRunning = false;
+	mNotify = -1;
+	mChangeHandle = NULL;
+}
+
+HotReload::~HotReload()
+{
+	//Deallocate
+	stop();
+}
+
+bool HotReload::start(const char *dir)
+{
+	stop();
+	mDir = dir;
+
+#if defined(_WIN32)
+	HANDLE handle = FindFirstChangeNotificationA(dir, FALSE, FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME);
+	if (handle == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+	mChangeHandle = handle;
+#elif defined(__linux__)
+	mNotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (mNotify < 0)
+	{
+		return false;
+	}
+
+	//Whole writes and editors that save by renaming a temporary file
+	if (inotify_add_watch(mNotify, dir, IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+	{
+		close(mNotify);
+		mNotify = -1;
+		return false;
+	}
+#endif
+
+	for (size_t i = 0; i < mEntries.size(); i++)
+	{
+		mEntries[i].modified = fileStamp(mDir + "/" + mEntries[i].file);
+	}
+	std::lock_guard<std::mutex> guard(mLock);
+	mRunning = true;
+	return true;
+}
+
+void HotReload::stop()
+{
+	if (!mRunning)
+	{
+		return;
+	}
+
+	//Decodes still running see this and free their own results
+	{
+		std::lock_guard<std::mutex> guard(mLock);
+		mRunning = false;
+		for (size_t i = 0; i < mDecoded.size(); i++)
+		{
+			discard(mDecoded[i]);
+		}
+		mDecoded.clear();
+	}
+
+#if defined(_WIN32)
+	FindCloseChangeNotification(static_cast<HANDLE>(mChangeHandle));
+	mChangeHandle = NULL;
+#elif defined(__linux__)
+	close(mNotify);
+	mNotify = -1;
+#endif
+}
+
+bool HotReload::isRunning()
+{
+	return mRunning;
+}
+
+void HotReload::watchImage(const std::string &file, const std::function<void(SDL_Surface *)> &apply)
+{
+	Entry entry;
+	entry.file = file;
+	entry.applyImage = apply;
+	entry.chunk = NULL;
+	entry.modified = 0;
+	entry.busy = false;
+	entry.dirty = false;
+	mEntries.push_back(entry);
+}
+
+void HotReload::watchSound(const std::string &file, Mix_Chunk **chunk)
+{
+	Entry entry;
+	entry.file = file;
+	entry.chunk = chunk;
+	entry.modified = 0;
+	entry.busy = false;
+	entry.dirty = false;
+	mEntries.push_back(entry);
+}
+
+void HotReload::update()
+{
+	AllocScope scope(ALLOC_ASSETS);
+	if (!mRunning)
+	{
+		return;
+	}
+
+	std::vector<size_t> changed;
+	poll(changed);
+	for (size_t i = 0; i < changed.size(); i++)
+	{
+		Entry &entry = mEntries[changed[i]];
+		if (entry.busy)
+		{
+			entry.dirty = true;
+		}
+		else
+		{
+			decode(changed[i]);
+		}
+	}
+
+	std::vector<Decoded> decoded;
+	{
+		std::lock_guard<std::mutex> guard(mLock);
+		decoded.swap(mDecoded);
+	}
+
+	//The frame hasn't started drawing, so nothing holds the old asset
+	for (size_t i = 0; i < decoded.size(); i++)
+	{
+		Entry &entry = mEntries[decoded[i].entry];
+		if (decoded[i].surface != NULL)
+		{
+			entry.applyImage(decoded[i].surface);
+			printf("Reloaded %s\n", entry.file.c_str());
+		}
+		else if (decoded[i].chunk != NULL)
+		{
+			Mix_FreeChunk(*entry.chunk);
+			*entry.chunk = decoded[i].chunk;
+			printf("Reloaded %s\n", entry.file.c_str());
+		}
+		else
+		{
+			printf("Failed to reload %s\n", entry.file.c_str());
+		}
+
+		entry.busy = false;
+		if (entry.dirty)
+		{
+			entry.dirty = false;
+			decode(decoded[i].entry);
+		}
+	}
+}
+
+bool HotReload::wait(Uint32 ms)
+{
+	AllocScope scope(ALLOC_ASSETS);
+	if (!mRunning)
+	{
+		SDL_Delay(ms);
+		return false;
+	}
+
+	Uint32 start = SDL_GetTicks();
+	for (;;)
+	{
+		{
+			std::lock_guard<std::mutex> guard(mLock);
+			if (!mDecoded.empty())
+			{
+				return true;
+			}
+		}
+
+		Uint32 elapsed = SDL_GetTicks() - start;
+		if (elapsed >= ms)
+		{
+			return false;
+		}
+
+		//Workers don't signal the handle, so wake now and then to look for decodes
+		Uint32 slice = ms - elapsed < HOT_RELOAD_WAIT_SLICE_MS ? ms - elapsed : HOT_RELOAD_WAIT_SLICE_MS;
+		if (waitForChange(slice))
+		{
+			return true;
+		}
+	}
+}
+
+bool HotReload::waitForChange(Uint32 ms)
+{
+#if defined(_WIN32)
+	//Stays signalled until poll asks for the next change
+	return WaitForSingleObject(static_cast<HANDLE>(mChangeHandle), ms) == WAIT_OBJECT_0;
+#elif defined(__linux__)
+	pollfd watch;
+	watch.fd = mNotify;
+	watch.events = POLLIN;
+	watch.revents = 0;
+	return ::poll(&watch, 1, static_cast<int>(ms)) > 0;
+#else
+	for (size_t i = 0; i < mEntries.size(); i++)
+	{
+		Sint64 modified = fileStamp(mDir + "/" + mEntries[i].file);
+		if (modified != 0 && modified != mEntries[i].modified)
+		{
+			return true;
+		}
+	}
+	SDL_Delay(ms);
+	return false;
+#endif
+}
+
+void HotReload::poll(std::vector<size_t> &changed)
+{
+#if defined(__linux__) && !defined(_WIN32)
+	//inotify names the files, so nothing else needs checking
+	char buffer[4096];
+	for (;;)
+	{
+		ssize_t length = read(mNotify, buffer, sizeof(buffer));
+		if (length <= 0)
+		{
+			break;
+		}
+		for (char *p = buffer; p < buffer + length;)
+		{
+			const inotify_event *event = reinterpret_cast<const inotify_event *>(p);
+			if (event->len > 0)
+			{
+				for (size_t i = 0; i < mEntries.size(); i++)
+				{
+					if (mEntries[i].file == event->name)
+					{
+						changed.push_back(i);
+					}
+				}
+			}
+			p += sizeof(inotify_event) + event->len;
+		}
+	}
+#else
+#if defined(_WIN32)
+	//The notification says something changed, the times say what
+	HANDLE handle = static_cast<HANDLE>(mChangeHandle);
+	if (WaitForSingleObject(handle, 0) != WAIT_OBJECT_0)
+	{
+		return;
+	}
+	FindNextChangeNotification(handle);
+#endif
+	for (size_t i = 0; i < mEntries.size(); i++)
+	{
+		Sint64 modified = fileStamp(mDir + "/" + mEntries[i].file);
+		if (modified != 0 && modified != mEntries[i].modified)
+		{
+			mEntries[i].modified = modified;
+			changed.push_back(i);
+		}
+	}
+#endif
+}
+
+void HotReload::decode(size_t index)
+{
+	AllocScope scope(ALLOC_ASSETS);
+	Entry &entry = mEntries[index];
+	entry.busy = true;
+	std::string path = mDir + "/" + entry.file;
+	bool image = entry.chunk == NULL;
+
+	std::function<void()> work = [this, index, path, image]()
+	{
+		Decoded decoded;
+		decoded.entry = index;
+		decoded.surface = image ? decodeImage(path.c_str()) : NULL;
+		decoded.chunk = image ? NULL : Mix_LoadWAV(path.c_str());
+
+		std::lock_guard<std::mutex> guard(mLock);
+		if (mRunning)
+		{
+			mDecoded.push_back(decoded);
+		}
+		else
+		{
+			discard(decoded);
+		}
+	};
+
+	//Without workers a job would wait for the next gJobs.wait, decode here
+	if (gJobs.getWorkerCount() == 0)
+	{
+		work();
+	}
+	else
+	{
+		gJobs.run(work);
+	}
+}
+
+void HotReload::discard(Decoded &decoded)
+{
+	SDL_FreeSurface(decoded.surface);
+	if (decoded.chunk != NULL)
+	{
+		Mix_FreeChunk(decoded.chunk);
+	}
+}
@@ -0,0 +1,107 @@
+#pragma once
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+#if defined(_MSC_VER)
+#include <SDL.h>
+#include <SDL_mixer.h>
+#elif defined(__clang__)
+#include <SDL2/SDL.h>
+#include <SDL2_mixer/SDL_mixer.h>
+#else
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_mixer.h>
+#endif
+
+/*
+* Dev mode asset reloading. The asset directory is watched (inotify on Linux,
+* change notifications on Windows, modification times elsewhere); a changed
+* file is decoded on the job system and the result is swapped in by update()
+* at the start of the next frame. Assets that didn't change are never touched.
+* Frames that idle between moves sleep in wait(), which returns as soon as a
+* file changes or a decode is ready, so an edit shows up without waiting out
+* the idle time.
+*/
+
+//Longest wait() sleeps before checking for finished decodes
+const Uint32 HOT_RELOAD_WAIT_SLICE_MS = 10;
+
+class HotReload
+{
+public:
+	//Initializes variables
+	HotReload();
+
+	//Stops watching
+	~HotReload();
+
+	//Starts watching a directory, false if it can't be watched
+	bool start(const char *dir);
+
+	//Stops watching and drops decodes that haven't been swapped in
+	void stop();
+
+	//True while watching
+	bool isRunning();
+
+	//Reloads an image, apply gets the decoded ARGB8888 surface and owns it
+	void watchImage(const std::string &file, const std::function<void(SDL_Surface *)> &apply);
+
+	//Reloads a sound straight into the chunk pointer the game plays from
+	void watchSound(const std::string &file, Mix_Chunk **chunk);
+
+	//Picks up changes and swaps in finished decodes; call at the top of a frame
+	void update();
+
+	//Sleeps up to ms, returns true early when update() has work to do
+	bool wait(Uint32 ms);
+
+private:
+	struct Entry
+	{
+		std::string file;
+		std::function<void(SDL_Surface *)> applyImage;
+		Mix_Chunk **chunk;
+
+		//File stamp, for watchers that can't say which file changed
+		Sint64 modified;
+
+		//A decode is running, and another change came in meanwhile
+		bool busy;
+		bool dirty;
+	};
+
+	struct Decoded
+	{
+		size_t entry;
+		SDL_Surface *surface;
+		Mix_Chunk *chunk;
+	};
+
+	//Finds the entries whose files changed since the last update
+	void poll(std::vector<size_t> &changed);
+
+	//Sleeps up to ms on the watch handle, true if something in the directory changed
+	bool waitForChange(Uint32 ms);
+
+	//Starts decoding an entry, on a worker when there is one
+	void decode(size_t index);
+
+	//Frees a decode nobody will apply
+	void discard(Decoded &decoded);
+
+	bool mRunning;
+	std::string mDir;
+	std::vector<Entry> mEntries;
+
+	//Decodes waiting for the frame boundary, filled by the workers
+	std::mutex mLock;
+	std::vector<Decoded> mDecoded;
+
+	//Platform watch handles
+	int mNotify;
+	void *mChangeHandle;
+};
+
+extern HotReload gHotReload;
@@ -0,0 +1,265 @@
+#include "hudtext.h"
+#include <string.h>
+#include "alloctrack.h"
+
+TextRenderer gHud;
+
+TextRenderer::TextRenderer()
+{
+	//Initialize
+	mRenderer = NULL;
+	mAtlas = NULL;
+	mLineHeight = 0;
+	memset(mGlyphs, 0, sizeof(mGlyphs));
+	memset(mKerning, 0, sizeof(mKerning));
+}
+
+TextRenderer::~TextRenderer()
+{
+	//Deallocate
+	free();
+}
+
+bool TextRenderer::init(SDL_Renderer *ren, const char *fontFile, int ptSize)
+{
+	free();
+
+	TTF_Font *font = TTF_OpenFont(fontFile, ptSize);
+	if (font == NULL)
+	{
+		return false;
+	}
+
+	mRenderer = ren;
+	mLineHeight = TTF_FontLineSkip(font);
+	int ascent = TTF_FontAscent(font);
+	SDL_Color white = { 255, 255, 255, 255 };
+
+	//Render every glyph and shelf-pack it
+	SDL_Surface *glyphs[HUD_GLYPH_COUNT];
+	int indices[HUD_GLYPH_COUNT];
+	int penX = 0;
+	int penY = 0;
+	int shelf = 0;
+	for (int i = 0; i < HUD_GLYPH_COUNT; i++)
+	{
+		Uint16 ch = static_cast<Uint16>(HUD_FIRST_CHAR + i);
+		int minX = 0, maxX = 0, minY = 0, maxY = 0, advance = 0;
+		TTF_GlyphMetrics(font, ch, &minX, &maxX, &minY, &maxY, &advance);
+		indices[i] = TTF_GlyphIsProvided(font, ch);
+
+		Glyph &glyph = mGlyphs[i];
+		memset(&glyph, 0, sizeof(glyph));
+		glyph.advance = advance;
+		glyph.offsetX = minX;
+		glyph.offsetY = ascent - maxY;
+
+		glyphs[i] = ch == ' ' ? NULL : TTF_RenderGlyph_Blended(font, ch, white);
+		SDL_Surface *converted = glyphs[i] != NULL ? SDL_ConvertSurfaceFormat(glyphs[i], SDL_PIXELFORMAT_ARGB8888, 0) : NULL;
+		SDL_FreeSurface(glyphs[i]);
+		glyphs[i] = converted;
+		if (converted == NULL)
+		{
+			continue;
+		}
+
+		//One pixel of padding so linear filtering doesn't pick up neighbours
+		if (penX + converted->w + 1 > HUD_ATLAS_WIDTH)
+		{
+			penX = 0;
+			penY += shelf + 1;
+			shelf = 0;
+		}
+		glyph.src.x = penX;
+		glyph.src.y = penY;
+		glyph.src.w = converted->w;
+		glyph.src.h = converted->h;
+		penX += converted->w + 1;
+		shelf = converted->h > shelf ? converted->h : shelf;
+	}
+
+	//Kerning pairs, read once instead of on every draw
+	if (TTF_GetFontKerning(font))
+	{
+		for (int i = 0; i < HUD_GLYPH_COUNT; i++)
+		{
+			for (int j = 0; j < HUD_GLYPH_COUNT; j++)
+			{
+				mKerning[i][j] = static_cast<signed char>(TTF_GetFontKerningSize(font, indices[i], indices[j]));
+			}
+		}
+	}
+	TTF_CloseFont(font);
+
+	SDL_Surface *atlas = SDL_CreateRGBSurface(0, HUD_ATLAS_WIDTH, penY + shelf, 32, 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000);
+	if (atlas != NULL)
+	{
+		SDL_FillRect(atlas, NULL, 0);
+
+		//Plain row copies, SDL_BlitSurface would blend the alpha
+		SDL_LockSurface(atlas);
+		for (int i = 0; i < HUD_GLYPH_COUNT; i++)
+		{
+			SDL_Surface *glyph = glyphs[i];
+			if (glyph == NULL)
+			{
+				continue;
+			}
+			SDL_LockSurface(glyph);
+			for (int y = 0; y < glyph->h; y++)
+			{
+				const Uint8 *src = static_cast<const Uint8 *>(glyph->pixels) + y * glyph->pitch;
+				Uint8 *dst = static_cast<Uint8 *>(atlas->pixels) + (mGlyphs[i].src.y + y) * atlas->pitch + mGlyphs[i].src.x * 4;
+				memcpy(dst, src, glyph->w * 4);
+			}
+			SDL_UnlockSurface(glyph);
+		}
+		SDL_UnlockSurface(atlas);
+
+		mAtlas = SDL_CreateTextureFromSurface(ren, atlas);
+		SDL_FreeSurface(atlas);
+	}
+	for (int i = 0; i < HUD_GLYPH_COUNT; i++)
+	{
+		SDL_FreeSurface(glyphs[i]);
+	}
+
+	if (mAtlas == NULL)
+	{
+		free();
+		return false;
+	}
+	SDL_SetTextureBlendMode(mAtlas, SDL_BLENDMODE_BLEND);
+	return true;
+}
+
+void TextRenderer::free()
+{
+	if (mAtlas != NULL)
+	{
+		SDL_DestroyTexture(mAtlas);
+		mAtlas = NULL;
+	}
+	mRenderer = NULL;
+	clear();
+}
+
+bool TextRenderer::isLoaded()
+{
+	return mAtlas != NULL;
+}
+
+int TextRenderer::getLineHeight()
+{
+	return mLineHeight;
+}
+
+int TextRenderer::measure(const char *text)
+{
+	int width = 0;
+	for (size_t i = 0; text[i] != 0; i++)
+	{
+		width += advance(text[i], text[i + 1]);
+	}
+	return width;
+}
+
+int TextRenderer::drawText(const char *text, int x, int y, SDL_Color color, int maxWidth)
+{
+	AllocScope scope(ALLOC_RENDER);
+	if (mAtlas == NULL)
+	{
+		return y;
+	}
+
+	Batch batch;
+	batch.first = mQuads.size();
+	batch.color = color;
+
+	int penX = x;
+	for (size_t i = 0; text[i] != 0; i++)
+	{
+		int step = advance(text[i], text[i + 1]);
+		if (text[i] == '\n' || (maxWidth > 0 && penX > x && penX + step - x > maxWidth))
+		{
+			penX = x;
+			y += mLineHeight;
+			if (text[i] == '\n')
+			{
+				continue;
+			}
+		}
+
+		const Glyph *glyph = findGlyph(text[i]);
+		if (glyph != NULL && glyph->src.w > 0)
+		{
+			Quad quad;
+			quad.src = glyph->src;
+			quad.dst.x = penX + glyph->offsetX;
+			quad.dst.y = y + glyph->offsetY;
+			quad.dst.w = glyph->src.w;
+			quad.dst.h = glyph->src.h;
+			mQuads.push_back(quad);
+		}
+		penX += step;
+	}
+
+	batch.count = mQuads.size() - batch.first;
+	if (batch.count > 0)
+	{
+		mBatches.push_back(batch);
+	}
+	return y + mLineHeight;
+}
+
+void TextRenderer::clear()
+{
+	mQuads.clear();
+	mBatches.clear();
+}
+
+void TextRenderer::flush()
+{
+	AllocScope scope(ALLOC_RENDER);
+	if (mAtlas != NULL)
+	{
+		//Every string uses the same texture, only the colour changes between them
+		for (size_t i = 0; i < mBatches.size(); i++)
+		{
+			const Batch &batch = mBatches[i];
+			SDL_SetTextureColorMod(mAtlas, batch.color.r, batch.color.g, batch.color.b);
+			SDL_SetTextureAlphaMod(mAtlas, batch.color.a);
+			for (size_t q = batch.first; q < batch.first + batch.count; q++)
+			{
+				SDL_RenderCopy(mRenderer, mAtlas, &mQuads[q].src, &mQuads[q].dst);
+			}
+		}
+	}
+	clear();
+}
+
+const TextRenderer::Glyph *TextRenderer::findGlyph(char c)
+{
+	int index = static_cast<unsigned char>(c) - HUD_FIRST_CHAR;
+	if (index < 0 || index >= HUD_GLYPH_COUNT)
+	{
+		return NULL;
+	}
+	return &mGlyphs[index];
+}
+
+int TextRenderer::advance(char c, char next)
+{
+	const Glyph *glyph = findGlyph(c);
+	if (glyph == NULL)
+	{
+		return 0;
+	}
+	int width = glyph->advance;
+	const Glyph *nextGlyph = findGlyph(next);
+	if (nextGlyph != NULL)
+	{
+		width += mKerning[glyph - mGlyphs][nextGlyph - mGlyphs];
+	}
+	return width;
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include <vector>
+#if defined(_MSC_VER)
+#include <SDL.h>
+#include <SDL_ttf.h>
+#elif defined(__clang__)
+#include <SDL2/SDL.h>
+#include <SDL2_ttf/SDL_ttf.h>
+#else
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+#endif
+
+/*
+* HUD text drawn from a glyph atlas. Every printable ASCII glyph is rendered
+* once into a single texture at load, with its advance and the kerning pairs
+* cached, so drawing a string is only layout plus copies from one texture.
+* Text is queued during the frame and drawn over it at present time.
+*/
+
+//First and last characters in the atlas
+const int HUD_FIRST_CHAR = 32;
+const int HUD_LAST_CHAR = 126;
+const int HUD_GLYPH_COUNT = HUD_LAST_CHAR - HUD_FIRST_CHAR + 1;
+
+//Width of the atlas texture, rows are added as needed
+const int HUD_ATLAS_WIDTH = 512;
+
+class TextRenderer
+{
+public:
+	//Initializes variables
+	TextRenderer();
+
+	//Deallocates memory
+	~TextRenderer();
+
+	//Renders the font's glyphs into the atlas
+	bool init(SDL_Renderer *ren, const char *fontFile, int ptSize);
+
+	//Destroys the atlas
+	void free();
+
+	//True once a font is loaded
+	bool isLoaded();
+
+	//Distance between the tops of two lines
+	int getLineHeight();
+
+	//Width of a string on one line
+	int measure(const char *text);
+
+	//Queues a string, wrapped onto new lines past maxWidth unless it is 0;
+	//returns the y below the last line
+	int drawText(const char *text, int x, int y, SDL_Color color, int maxWidth = 0);
+
+	//Drops the queued text
+	void clear();
+
+	//Draws the queued text, one batch per string
+	void flush();
+
+private:
+	struct Glyph
+	{
+		SDL_Rect src;
+		int offsetX;
+		int offsetY;
+		int advance;
+	};
+
+	struct Quad
+	{
+		SDL_Rect src;
+		SDL_Rect dst;
+	};
+
+	struct Batch
+	{
+		size_t first;
+		size_t count;
+		SDL_Color color;
+	};
+
+	//Glyph for a character, NULL if it isn't in the atlas
+	const Glyph *findGlyph(char c);
+
+	//Advance from one character to the next, kerning included
+	int advance(char c, char next);
+
+	SDL_Renderer *mRenderer;
+	SDL_Texture *mAtlas;
+	int mLineHeight;
+	Glyph mGlyphs[HUD_GLYPH_COUNT];
+	signed char mKerning[HUD_GLYPH_COUNT][HUD_GLYPH_COUNT];
+
+	std::vector<Quad> mQuads;
+	std::vector<Batch> mBatches;
+};
+
+extern TextRenderer gHud;
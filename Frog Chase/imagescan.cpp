@@ -0,0 +1,109 @@
+#include "imagescan.h"
+#include <string.h>
+#if defined(_MSC_VER)
+#include <SDL_image.h>
+#elif defined(__clang__)
+#include <SDL2_image/SDL_image.h>
+#else
+#include <SDL2/SDL_image.h>
+#endif
+
+SDL_Surface *decodeImage(const char *file)
+{
+	SDL_Surface *loaded = IMG_Load(file);
+	if (loaded == NULL)
+	{
+		return NULL;
+	}
+	SDL_Surface *surface = SDL_ConvertSurfaceFormat(loaded, SDL_PIXELFORMAT_ARGB8888, 0);
+	SDL_FreeSurface(loaded);
+	return surface;
+}
+
+ImageScan scanSurface(SDL_Surface *surface)
+{
+	ImageScan scan;
+	scan.bounds.x = 0;
+	scan.bounds.y = 0;
+	scan.bounds.w = 0;
+	scan.bounds.h = 0;
+	scan.opaque = false;
+	scan.transparentPercent = 100;
+
+	if (surface == NULL || surface->w <= 0 || surface->h <= 0 || surface->format->format != SDL_PIXELFORMAT_ARGB8888)
+	{
+		return scan;
+	}
+
+	int left = surface->w;
+	int right = -1;
+	int top = surface->h;
+	int bottom = -1;
+	int transparent = 0;
+	bool opaque = true;
+
+	SDL_LockSurface(surface);
+	for (int y = 0; y < surface->h; y++)
+	{
+		const Uint32 *row = reinterpret_cast<const Uint32 *>(static_cast<const Uint8 *>(surface->pixels) + y * surface->pitch);
+		for (int x = 0; x < surface->w; x++)
+		{
+			Uint32 alpha = row[x] >> 24;
+			if (alpha == 0)
+			{
+				transparent++;
+				opaque = false;
+				continue;
+			}
+			if (alpha != 0xFF)
+			{
+				opaque = false;
+			}
+			if (x < left) left = x;
+			if (x > right) right = x;
+			if (y < top) top = y;
+			if (y > bottom) bottom = y;
+		}
+	}
+	SDL_UnlockSurface(surface);
+
+	scan.opaque = opaque;
+	scan.transparentPercent = static_cast<int>((transparent * 100LL) / (surface->w * surface->h));
+	if (right >= 0)
+	{
+		scan.bounds.x = left;
+		scan.bounds.y = top;
+		scan.bounds.w = right - left + 1;
+		scan.bounds.h = bottom - top + 1;
+	}
+	return scan;
+}
+
+SDL_Surface *cropSurface(SDL_Surface *surface, const SDL_Rect &rect)
+{
+	if (surface == NULL || rect.w <= 0 || rect.h <= 0)
+	{
+		return NULL;
+	}
+
+	SDL_PixelFormat *format = surface->format;
+	SDL_Surface *result = SDL_CreateRGBSurface(0, rect.w, rect.h, format->BitsPerPixel, format->Rmask, format->Gmask, format->Bmask, format->Amask);
+	if (result == NULL)
+	{
+		return NULL;
+	}
+
+	//Plain row copies, SDL_BlitSurface would blend the alpha
+	int bytes = format->BytesPerPixel;
+	SDL_LockSurface(surface);
+	SDL_LockSurface(result);
+	for (int y = 0; y < rect.h; y++)
+	{
+		const Uint8 *src = static_cast<const Uint8 *>(surface->pixels) + (rect.y + y) * surface->pitch + rect.x * bytes;
+		Uint8 *dst = static_cast<Uint8 *>(result->pixels) + y * result->pitch;
+		memcpy(dst, src, rect.w * bytes);
+	}
+	SDL_UnlockSurface(result);
+	SDL_UnlockSurface(surface);
+	return result;
+}
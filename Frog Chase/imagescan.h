@@ -0,0 +1,48 @@
+#pragma once
+#if defined(_MSC_VER)
+#include <SDL.h>
+#else
+#include <SDL2/SDL.h>
+#endif
+
+/*
+* Load-time analysis of decoded images, used to skip blending for opaque
+* images and to avoid filling transparent borders.
+*/
+
+//Images with at least this many fully transparent pixels get run lists
+const int RLE_TRANSPARENT_PERCENT = 50;
+
+struct ImageScan
+{
+	//Smallest rectangle holding every pixel that isn't fully transparent
+	SDL_Rect bounds;
+
+	//Every pixel has alpha 255
+	bool opaque;
+
+	//Share of pixels with alpha 0
+	int transparentPercent;
+};
+
+/**
+* Decodes an image file into an ARGB8888 surface; safe to call off the main thread
+* @param file The image file to load
+* @return the new surface, or nullptr if something went wrong
+*/
+SDL_Surface *decodeImage(const char *file);
+
+/**
+* Scans the alpha channel of an ARGB8888 surface
+* @param surface The surface to scan
+* @return what the scan found; bounds is empty for a fully transparent image
+*/
+ImageScan scanSurface(SDL_Surface *surface);
+
+/**
+* Copies part of a surface into a new surface of the same format
+* @param surface The surface to copy from
+* @param rect The part to copy
+* @return the new surface, or nullptr if something went wrong
+*/
+SDL_Surface *cropSurface(SDL_Surface *surface, const SDL_Rect &rect);
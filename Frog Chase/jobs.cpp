@@ -0,0 +1,477 @@
+#include "jobs.h"
+#include "alloctrack.h"
+
+#if defined(_MSC_VER)
+#define JOB_THREAD_LOCAL __declspec(thread)
+#else
+#define JOB_THREAD_LOCAL __thread
+#endif
+
+JobSystem gJobs;
+
+//Index of the worker owning the calling thread, -1 everywhere else
+static JOB_THREAD_LOCAL int tWorkerIndex = -1;
+
+Job::Job(const std::function<void()> &work, bool mainThreadOnly)
+	: mWork(work), mMainThreadOnly(mainThreadOnly), mPendingDeps(1), mUnfinished(1), mFinished(false)
+{
+}
+
+bool Job::isDone()
+{
+	return mUnfinished.load() == 0;
+}
+
+//Chunks of one parallelFor, claimed by whoever gets to them first
+struct ForRange
+{
+	const std::function<void(int begin, int end)> *body;
+	int count;
+	int grain;
+	std::atomic<int> next;
+
+	void run()
+	{
+		for (;;)
+		{
+			int begin = next.fetch_add(grain);
+			if (begin >= count)
+			{
+				return;
+			}
+			int end = begin + grain < count ? begin + grain : count;
+			(*body)(begin, end);
+		}
+	}
+};
+
+JobQueue::JobQueue()
+	: mHead(0), mSize(0)
+{
+}
+
+bool JobQueue::empty()
+{
+	return mSize == 0;
+}
+
+void JobQueue::push_back(const JobHandle &job)
+{
+	if (mSize == mSlots.size())
+	{
+		//Unwrap into a buffer twice the size
+		std::vector<JobHandle> grown(mSlots.empty() ? 16 : mSlots.size() * 2);
+		for (size_t i = 0; i < mSize; i++)
+		{
+			grown[i].swap(mSlots[(mHead + i) % mSlots.size()]);
+		}
+		mSlots.swap(grown);
+		mHead = 0;
+	}
+	mSlots[(mHead + mSize) % mSlots.size()] = job;
+	mSize++;
+}
+
+JobHandle JobQueue::pop_back()
+{
+	JobHandle job;
+	job.swap(mSlots[(mHead + mSize - 1) % mSlots.size()]);
+	mSize--;
+	return job;
+}
+
+JobHandle JobQueue::pop_front()
+{
+	JobHandle job;
+	job.swap(mSlots[mHead]);
+	mHead = (mHead + 1) % mSlots.size();
+	mSize--;
+	return job;
+}
+
+JobSystem::JobSystem()
+	: mNextQueue(0), mQueued(0), mStop(false), mForBusy(false)
+{
+}
+
+JobSystem::~JobSystem()
+{
+	shutdown();
+}
+
+void JobSystem::init(int workers)
+{
+	if (!mWorkers.empty())
+	{
+		return;
+	}
+
+	//One worker per spare core, the main thread is the last one
+	if (workers < 0)
+	{
+		workers = static_cast<int>(std::thread::hardware_concurrency()) - 1;
+		if (workers < 0)
+		{
+			workers = 0;
+		}
+	}
+
+	mMainThread = std::this_thread::get_id();
+	mStop = false;
+
+	//Always keep one queue so a machine with no spare cores still works,
+	//the main thread then drains it inside wait()
+	int queues = workers > 0 ? workers : 1;
+	for (int i = 0; i < queues; i++)
+	{
+		mWorkers.push_back(new Worker());
+	}
+	for (int i = 0; i < workers; i++)
+	{
+		mWorkers[i]->thread = std::thread(&JobSystem::workerLoop, this, i);
+	}
+}
+
+void JobSystem::shutdown()
+{
+	if (mWorkers.empty())
+	{
+		return;
+	}
+
+	//Let queued work finish before stopping
+	while (mQueued.load() > 0)
+	{
+		JobHandle job = takeJob(-1);
+		if (job)
+		{
+			execute(job);
+		}
+	}
+	pumpMainThread();
+
+	{
+		std::lock_guard<std::mutex> lock(mSleepLock);
+		mStop = true;
+	}
+	mWake.notify_all();
+
+	for (size_t i = 0; i < mWorkers.size(); i++)
+	{
+		if (mWorkers[i]->thread.joinable())
+		{
+			mWorkers[i]->thread.join();
+		}
+		delete mWorkers[i];
+	}
+	mWorkers.clear();
+}
+
+JobHandle JobSystem::createJob(const std::function<void()> &work, JobHandle parent)
+{
+	AllocScope scope(ALLOC_JOBS);
+	JobHandle job = std::make_shared<Job>(work, false);
+	if (parent)
+	{
+		parent->mUnfinished++;
+		job->mParent = parent;
+	}
+	return job;
+}
+
+JobHandle JobSystem::createMainThreadJob(const std::function<void()> &work, JobHandle parent)
+{
+	JobHandle job = createJob(work, parent);
+	job->mMainThreadOnly = true;
+	return job;
+}
+
+void JobSystem::addDependency(JobHandle job, JobHandle dependsOn)
+{
+	std::lock_guard<std::mutex> lock(dependsOn->mLock);
+	if (!dependsOn->mFinished)
+	{
+		job->mPendingDeps++;
+		dependsOn->mContinuations.push_back(job);
+	}
+}
+
+void JobSystem::submit(JobHandle job)
+{
+	//The last outstanding dependency (or the submit itself) queues the job
+	if (job->mPendingDeps.fetch_sub(1) == 1)
+	{
+		enqueue(job);
+	}
+}
+
+JobHandle JobSystem::run(const std::function<void()> &work)
+{
+	JobHandle job = createJob(work);
+	submit(job);
+	return job;
+}
+
+JobHandle JobSystem::runOnMainThread(const std::function<void()> &work)
+{
+	JobHandle job = createMainThreadJob(work);
+	submit(job);
+	return job;
+}
+
+void JobSystem::wait(JobHandle job)
+{
+	bool mainThread = isMainThread();
+	while (!job->isDone())
+	{
+		if (mainThread)
+		{
+			pumpMainThread();
+		}
+
+		//Help out instead of blocking
+		JobHandle other = takeJob(tWorkerIndex);
+		if (other)
+		{
+			execute(other);
+		}
+		else
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+
+void JobSystem::parallelFor(int count, int grain, const std::function<void(int begin, int end)> &body)
+{
+	if (count <= 0)
+	{
+		return;
+	}
+	if (grain < 1)
+	{
+		grain = 1;
+	}
+
+	//Not worth a trip through the queues
+	if (count <= grain || mWorkers.empty())
+	{
+		body(0, count);
+		return;
+	}
+
+	ForRange range;
+	range.body = &body;
+	range.count = count;
+	range.grain = grain;
+	range.next = 0;
+
+	//One helper per idle worker at most, the caller claims chunks as well
+	int chunks = (count + grain - 1) / grain;
+	int workers = getWorkerCount();
+	int helpers = chunks - 1 < workers ? chunks - 1 : workers;
+
+	//The main thread runs the same loops every frame, so it reuses its jobs;
+	//the helper lambda holds one pointer and fits std::function's inline buffer
+	bool reuse = isMainThread() && !mForBusy;
+	if (reuse)
+	{
+		mForBusy = true;
+	}
+	std::function<void()> work = [&range]() { range.run(); };
+	JobHandle parent = reuse ? reuseJob(0, std::function<void()>(), JobHandle()) : createJob(std::function<void()>());
+	for (int i = 0; i < helpers; i++)
+	{
+		submit(reuse ? reuseJob(i + 1, work, parent) : createJob(work, parent));
+	}
+	submit(parent);
+
+	range.run();
+	wait(parent);
+	if (reuse)
+	{
+		mForBusy = false;
+	}
+}
+
+void JobSystem::pumpMainThread()
+{
+	for (;;)
+	{
+		JobHandle job;
+		{
+			std::lock_guard<std::mutex> lock(mMainLock);
+			if (mMainQueue.empty())
+			{
+				return;
+			}
+			job = mMainQueue.pop_front();
+		}
+		execute(job);
+	}
+}
+
+int JobSystem::getWorkerCount()
+{
+	int count = 0;
+	for (size_t i = 0; i < mWorkers.size(); i++)
+	{
+		if (mWorkers[i]->thread.joinable())
+		{
+			count++;
+		}
+	}
+	return count;
+}
+
+bool JobSystem::isMainThread()
+{
+	return std::this_thread::get_id() == mMainThread;
+}
+
+void JobSystem::workerLoop(int index)
+{
+	tWorkerIndex = index;
+	while (!mStop.load())
+	{
+		JobHandle job = takeJob(index);
+		if (job)
+		{
+			execute(job);
+			continue;
+		}
+
+		//Nothing to do or steal, park until something is queued
+		std::unique_lock<std::mutex> lock(mSleepLock);
+		mWake.wait(lock, [this]() { return mStop.load() || mQueued.load() > 0; });
+	}
+}
+
+int JobSystem::currentWorker()
+{
+	return tWorkerIndex;
+}
+
+void JobSystem::enqueue(JobHandle job)
+{
+	AllocScope scope(ALLOC_JOBS);
+	if (job->mMainThreadOnly)
+	{
+		std::lock_guard<std::mutex> lock(mMainLock);
+		mMainQueue.push_back(job);
+		return;
+	}
+
+	//Workers keep their own work local, everyone else spreads it out
+	int self = currentWorker();
+	size_t target = self >= 0 ? static_cast<size_t>(self) : mNextQueue.fetch_add(1) % mWorkers.size();
+	{
+		std::lock_guard<std::mutex> lock(mWorkers[target]->lock);
+		mWorkers[target]->queue.push_back(job);
+	}
+	mQueued++;
+
+	{
+		std::lock_guard<std::mutex> lock(mSleepLock);
+	}
+	mWake.notify_one();
+}
+
+JobHandle JobSystem::takeJob(int self)
+{
+	size_t count = mWorkers.size();
+
+	//Own queue first, newest job for cache warmth
+	if (self >= 0)
+	{
+		Worker *own = mWorkers[self];
+		std::lock_guard<std::mutex> lock(own->lock);
+		if (!own->queue.empty())
+		{
+			JobHandle job = own->queue.pop_back();
+			mQueued--;
+			return job;
+		}
+	}
+
+	//Steal the oldest job from someone else
+	size_t start = self >= 0 ? static_cast<size_t>(self) + 1 : 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		Worker *victim = mWorkers[(start + i) % count];
+		std::lock_guard<std::mutex> lock(victim->lock);
+		if (!victim->queue.empty())
+		{
+			JobHandle job = victim->queue.pop_front();
+			mQueued--;
+			return job;
+		}
+	}
+
+	return JobHandle();
+}
+
+void JobSystem::execute(JobHandle job)
+{
+	if (job->mWork)
+	{
+		job->mWork();
+		job->mWork = std::function<void()>();
+	}
+	finish(job);
+}
+
+void JobSystem::finish(JobHandle job)
+{
+	if (job->mUnfinished.fetch_sub(1) != 1)
+	{
+		return;
+	}
+
+	std::vector<JobHandle> continuations;
+	{
+		std::lock_guard<std::mutex> lock(job->mLock);
+		job->mFinished = true;
+		continuations.swap(job->mContinuations);
+	}
+	for (size_t i = 0; i < continuations.size(); i++)
+	{
+		submit(continuations[i]);
+	}
+
+	if (job->mParent)
+	{
+		JobHandle parent = job->mParent;
+		job->mParent.reset();
+		finish(parent);
+	}
+}
+
+JobHandle JobSystem::reuseJob(size_t slot, const std::function<void()> &work, JobHandle parent)
+{
+	AllocScope scope(ALLOC_JOBS);
+	if (slot >= mForJobs.size())
+	{
+		mForJobs.resize(slot + 1);
+	}
+
+	//A worker that just ran it may not have dropped its handle yet
+	JobHandle &job = mForJobs[slot];
+	if (!job || job.use_count() != 1)
+	{
+		job = createJob(work, parent);
+		return job;
+	}
+	std::atomic_thread_fence(std::memory_order_acquire);
+
+	job->mWork = work;
+	job->mPendingDeps = 1;
+	job->mUnfinished = 1;
+	job->mFinished = false;
+	if (parent)
+	{
+		parent->mUnfinished++;
+		job->mParent = parent;
+	}
+	return job;
+}
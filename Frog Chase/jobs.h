@@ -0,0 +1,177 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+* Shared work-stealing job system. Every subsystem (rendering, level generation,
+* solvers, loading) submits work here instead of spawning its own threads.
+*/
+
+class Job;
+typedef std::shared_ptr<Job> JobHandle;
+
+class Job
+{
+public:
+	//Initializes the job with the work it will run
+	Job(const std::function<void()> &work, bool mainThreadOnly);
+
+	//True once the job and all of its children have finished
+	bool isDone();
+
+private:
+	friend class JobSystem;
+
+	//The work to run
+	std::function<void()> mWork;
+
+	//Jobs that touch SDL_Renderer must run on the thread that created it
+	bool mMainThreadOnly;
+
+	//Dependencies still running, plus one until the job is submitted
+	std::atomic<int> mPendingDeps;
+
+	//This job plus any unfinished children
+	std::atomic<int> mUnfinished;
+
+	//Job to notify when this one finishes
+	JobHandle mParent;
+
+	//Jobs waiting on this one, guarded by mLock
+	std::vector<JobHandle> mContinuations;
+	bool mFinished;
+	std::mutex mLock;
+};
+
+//Growable ring of ready jobs; unlike std::deque it keeps its storage once
+//grown, so queueing work in a steady frame never touches the heap
+class JobQueue
+{
+public:
+	//Initializes variables
+	JobQueue();
+
+	//True when no job is queued
+	bool empty();
+
+	//Adds a job, doubling the ring when it is full
+	void push_back(const JobHandle &job);
+
+	//Removes and returns the newest job
+	JobHandle pop_back();
+
+	//Removes and returns the oldest job
+	JobHandle pop_front();
+
+private:
+	std::vector<JobHandle> mSlots;
+	size_t mHead;
+	size_t mSize;
+};
+
+class JobSystem
+{
+public:
+	//Initializes variables
+	JobSystem();
+
+	//Stops the workers
+	~JobSystem();
+
+	//Starts the workers, one per spare core when workers is negative.
+	//Must be called from the thread that owns the SDL_Renderer.
+	void init(int workers = -1);
+
+	//Finishes queued work and joins the workers
+	void shutdown();
+
+	//Creates a job; a parent job is not done until all its children are
+	JobHandle createJob(const std::function<void()> &work, JobHandle parent = JobHandle());
+
+	//Creates a job that only runs on the main thread lane
+	JobHandle createMainThreadJob(const std::function<void()> &work, JobHandle parent = JobHandle());
+
+	//Makes job wait for dependsOn; call before submitting job
+	void addDependency(JobHandle job, JobHandle dependsOn);
+
+	//Queues a job once all of its dependencies have finished
+	void submit(JobHandle job);
+
+	//Creates and submits a job in one call
+	JobHandle run(const std::function<void()> &work);
+
+	//Creates and submits a main thread job in one call
+	JobHandle runOnMainThread(const std::function<void()> &work);
+
+	//Blocks until the job is done, running other jobs meanwhile
+	void wait(JobHandle job);
+
+	//Splits [0, count) into chunks of grain and runs them on every worker
+	void parallelFor(int count, int grain, const std::function<void(int begin, int end)> &body);
+
+	//Runs queued main thread jobs; call once per frame from the main thread
+	void pumpMainThread();
+
+	//Number of worker threads, not counting the main thread
+	int getWorkerCount();
+
+	//True when called from the thread that called init()
+	bool isMainThread();
+
+private:
+	struct Worker
+	{
+		std::thread thread;
+		JobQueue queue;
+		std::mutex lock;
+	};
+
+	//Body of every worker thread
+	void workerLoop(int index);
+
+	//Index of the calling worker, or -1 for non-worker threads
+	int currentWorker();
+
+	//Puts a ready job on a queue
+	void enqueue(JobHandle job);
+
+	//Pops local work, or steals from another worker
+	JobHandle takeJob(int self);
+
+	//Runs a job and finishes it
+	void execute(JobHandle job);
+
+	//Drops the unfinished count and releases parents and continuations
+	void finish(JobHandle job);
+
+	//Refills a pooled parallelFor job, making a new one if a worker still holds it
+	JobHandle reuseJob(size_t slot, const std::function<void()> &work, JobHandle parent);
+
+	std::vector<Worker*> mWorkers;
+	std::thread::id mMainThread;
+
+	//Round robin target for jobs submitted from non-worker threads
+	std::atomic<unsigned> mNextQueue;
+
+	//Jobs queued on worker queues, used to park idle workers
+	std::atomic<int> mQueued;
+	std::atomic<bool> mStop;
+	std::mutex mSleepLock;
+	std::condition_variable mWake;
+
+	//Main thread affinity lane
+	JobQueue mMainQueue;
+	std::mutex mMainLock;
+
+	//Jobs parallelFor reuses on the main thread, slot 0 is the parent
+	std::vector<JobHandle> mForJobs;
+	bool mForBusy;
+};
+
+//The one pool shared by every subsystem
+extern JobSystem gJobs;
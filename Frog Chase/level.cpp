@@ -0,0 +1,68 @@
+#include "level.h"
+
+struct DefaultTrigger
+{
+	int col;
+	int row;
+	CellTrigger trigger;
+};
+
+//The built-in layout: the start, where the two down doors land and the
+//frog house. The doors come from the cards each round
+static const DefaultTrigger DEFAULT_TRIGGERS[] =
+{
+	{ 0, 0, { TRIGGER_SAFE, 0, 0 } },
+	{ 0, 5, { TRIGGER_SAFE, 0, 0 } },
+	{ 0, 6, { TRIGGER_SAFE, 0, 0 } },
+	{ 5, 8, { TRIGGER_HOME, 0, 0 } },
+};
+
+static const CellTrigger NO_TRIGGER = { TRIGGER_NONE, 0, 0 };
+
+Level::Level()
+{
+	reset();
+}
+
+void Level::reset()
+{
+	for (int i = 0; i < BOARD_ROWS * BOARD_COLS; i++)
+	{
+		mCells[i] = NO_TRIGGER;
+	}
+	for (size_t i = 0; i < sizeof(DEFAULT_TRIGGERS) / sizeof(DEFAULT_TRIGGERS[0]); i++)
+	{
+		mCells[DEFAULT_TRIGGERS[i].row * BOARD_COLS + DEFAULT_TRIGGERS[i].col] = DEFAULT_TRIGGERS[i].trigger;
+	}
+}
+
+void Level::setTrigger(int col, int row, TriggerAction action, int targetCol, int targetRow)
+{
+	if (col < 0 || col >= BOARD_COLS || row < 0 || row >= BOARD_ROWS)
+	{
+		return;
+	}
+
+	CellTrigger &cell = mCells[row * BOARD_COLS + col];
+	cell.action = static_cast<unsigned char>(action);
+	cell.targetCol = static_cast<signed char>(targetCol);
+	cell.targetRow = static_cast<signed char>(targetRow);
+}
+
+const CellTrigger &Level::getTrigger(int col, int row) const
+{
+	if (col < 0 || col >= BOARD_COLS || row < 0 || row >= BOARD_ROWS)
+	{
+		return NO_TRIGGER;
+	}
+	return mCells[row * BOARD_COLS + col];
+}
+
+const CellTrigger &Level::getTriggerAt(int x, int y) const
+{
+	if (x < 0 || y < 0)
+	{
+		return NO_TRIGGER;
+	}
+	return getTrigger(x / TILE_SIZE, y / TILE_SIZE);
+}
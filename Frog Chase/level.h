@@ -0,0 +1,55 @@
+#pragma once
+#include <stddef.h>
+#include "board.h"
+
+/*
+* What happens when the frog stops on each tile, one dense table entry per
+* tile so the main loop finds the rule for the frog's tile in one lookup.
+*/
+
+enum TriggerAction
+{
+	//The pelican catches a frog stopped in the open
+	TRIGGER_NONE,
+
+	//Nothing happens, the frog is hidden
+	TRIGGER_SAFE,
+
+	//The frog made it home
+	TRIGGER_HOME,
+
+	//The door leads straight to the pelican
+	TRIGGER_BIRD,
+
+	//The door takes the frog to the target tile
+	TRIGGER_TELEPORT
+};
+
+struct CellTrigger
+{
+	unsigned char action;
+	signed char targetCol;
+	signed char targetRow;
+};
+
+class Level
+{
+public:
+	//Initializes the table with the built-in layout
+	Level();
+
+	//Puts back the triggers every layout has and clears the doors
+	void reset();
+
+	//Sets the trigger of a tile, tiles outside the board are ignored
+	void setTrigger(int col, int row, TriggerAction action, int targetCol = 0, int targetRow = 0);
+
+	//Gets the trigger of a tile, TRIGGER_NONE outside the board
+	const CellTrigger &getTrigger(int col, int row) const;
+
+	//Gets the trigger under a pixel position
+	const CellTrigger &getTriggerAt(int x, int y) const;
+
+private:
+	CellTrigger mCells[BOARD_ROWS * BOARD_COLS];
+};
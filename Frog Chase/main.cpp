@@ -4,6 +4,9 @@
 #include <utility>
 #include <queue>
 #include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <new>
 #if defined(_MSC_VER)
 #include <SDL.h>
 #include <SDL_image.h>
@@ -11,22 +14,97 @@
 #elif defined(__clang__)
 #include <SDL2/SDL.h>
 #include <SDL2_image/SDL_image.h>
+#include <SDL2_mixer/SDL_mixer.h>
 #else
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_image.h>
+#include <SDL2/SDL_mixer.h>
 #endif
+#include "alloctrack.h"
+#include "arena.h"
+#include "audio.h"
+#include "board.h"
+#include "collision.h"
+#include "collisionmask.h"
+#include "commandring.h"
+#include "compositor.h"
+#include "distancefield.h"
+#include "fuzz.h"
+#include "grader.h"
+#include "hotreload.h"
+#include "hudtext.h"
+#include "imagescan.h"
+#include "jobs.h"
+#include "level.h"
+#include "music.h"
+#include "program.h"
+#include "solver.h"
+#include "sprite.h"
+#include "texturecache.h"
 
 /*
 * The Chase Frog Game
 */
-//Screen attributes
-const int SCREEN_WIDTH = 1024;
-const int SCREEN_HEIGHT = 728;
 
-// Scaling the tiles to be 80x80
-const int TILE_SIZE = 80;
+//Replay pacing: a step every 100 ms, sped up so long programs play in about 3 seconds
+const int STEP_DELAY_MS = 100;
+const int MIN_STEP_DELAY_MS = 15;
+const int REPLAY_BUDGET_MS = 3000;
 
-std::multimap<int, int> rocks;
+typedef std::multimap<int, int, std::less<int>, ArenaAllocator<std::pair<const int, int> > > RockMap;
+
+//State that lasts one round; it lives in gRoundArena and is released with it
+struct RoundState
+{
+	RoundState(Arena &arena);
+
+	//Rock positions, row first then column
+	RockMap rocks;
+
+	//Arrow presses waiting for enter
+	CommandRing commands;
+};
+
+RoundState::RoundState(Arena &arena)
+	: rocks(std::less<int>(), ArenaAllocator<std::pair<const int, int> >(arena))
+{
+}
+
+//Memory for the round in play, reused by every round
+Arena gRoundArena;
+RoundState *gRound = NULL;
+
+/**
+* Release the round in play, all of its memory at once
+*/
+void endRound()
+{
+	if (gRound == NULL)
+	{
+		return;
+	}
+	gRound->~RoundState();
+	gRound = NULL;
+
+#ifdef _DEBUG
+	printf("Round arena: %u bytes used, %u peak, %u held\n", static_cast<unsigned>(gRoundArena.getUsed()), static_cast<unsigned>(gRoundArena.getPeak()), static_cast<unsigned>(gRoundArena.getCapacity()));
+#endif
+	gRoundArena.reset();
+}
+/**
+* Start a round with empty state from the round arena
+*/
+void beginRound()
+{
+	endRound();
+	gRound = new (gRoundArena.allocate(sizeof(RoundState))) RoundState(gRoundArena);
+}
+
+//The rocks the frog can bump into
+RockGrid rockGrid;
+
+//Solid pixels of a rock drawn on a tile
+CollisionMask rockMask;
 bool startSprite = false;
 //generate a random number between minimum and maximum
 int roll(int min, int max)
@@ -67,6 +145,12 @@ private:
 };
 
 Card cardHome, cardBird, cardDown1, cardDown2;
+
+//What each tile does to a frog that stops on it
+Level level;
+
+//Distance home from every tile, kept current for the H key's hints
+DistanceField hintField;
 Card::Card()
 {
 	setRandomPositions();
@@ -114,6 +198,9 @@ public:
 	//Loads image at specified path
 	SDL_Texture* loadTexture(const std::string &file, SDL_Renderer *ren);
 
+	//Makes a texture from a decoded ARGB8888 surface, which it takes over
+	SDL_Texture* createTexture(SDL_Surface *surface, SDL_Renderer *ren);
+
 
 	//Deallocates texture
 	void free();
@@ -139,6 +226,9 @@ public:
 	int getCollisionW();
 	int getCollisionH();
 
+	//Gets the per-pixel collision mask of the image
+	const CollisionMask &getMask();
+
 private:
 	//The actual hardware texture
 	SDL_Texture* mTexture;
@@ -146,6 +236,9 @@ private:
 	//Image dimensions
 	int mWidth;
 	int mHeight;
+
+	//Solid pixels of the image
+	CollisionMask mMask;
 };
 
 LTexture::LTexture()
@@ -230,6 +323,10 @@ int LTexture::getCollisionH()
 {
 	return iCollider.h;
 }
+const CollisionMask &LTexture::getMask()
+{
+	return mMask;
+}
 /**
 * Log an SDL error with some error message to the output stream of our choice
 * @param os The output stream to write the message too
@@ -246,18 +343,73 @@ void logSDLError(std::ostream &os, const std::string &msg){
 * @return the loaded texture, or nullptr if something went wrong.
 */
 SDL_Texture* LTexture::loadTexture(const std::string &file, SDL_Renderer *ren){
-	SDL_Texture *texture = IMG_LoadTexture(ren, file.c_str());
-	if (texture == nullptr)
+	SDL_Surface* surface = decodeImage(file.c_str());
+	if (surface == nullptr)
 	{
 		logSDLError(std::cout, "LoadTexture");
+		return nullptr;
+	}
+	return createTexture(surface, ren);
+}
+
+/**
+* Makes a texture from a decoded image and keeps its pixels for the caches
+* @param surface The ARGB8888 image, freed by this call; nullptr is a failed load
+* @param ren The renderer to load the texture onto
+* @return the new texture, or nullptr if something went wrong.
+*/
+SDL_Texture* LTexture::createTexture(SDL_Surface *surface, SDL_Renderer *ren){
+	if (surface == nullptr)
+	{
+		return nullptr;
 	}
 
 	//set collision box dimensions of the image
-	SDL_Surface* loadedSurface = IMG_Load(file.c_str());
-	mWidth = loadedSurface->w;
-	mHeight = loadedSurface->h;
+	mWidth = surface->w;
+	mHeight = surface->h;
 	setCollisionDimensions(mWidth, mHeight);
 
+	//build the pixel mask before the border is trimmed
+	mMask.build(surface);
+
+	//trim the transparent border so it costs no fill rate
+	ImageScan scan = scanSurface(surface);
+	if (!scan.opaque && scan.bounds.w > 0 && (scan.bounds.w < mWidth || scan.bounds.h < mHeight))
+	{
+		SDL_Surface* trimmed = cropSurface(surface, scan.bounds);
+		if (trimmed != nullptr)
+		{
+			SDL_FreeSurface(surface);
+			surface = trimmed;
+		}
+		else
+		{
+			scan.bounds.x = 0;
+			scan.bounds.y = 0;
+		}
+	}
+	else
+	{
+		scan.bounds.x = 0;
+		scan.bounds.y = 0;
+	}
+
+	SDL_Texture *texture = SDL_CreateTextureFromSurface(ren, surface);
+	if (texture == nullptr)
+	{
+		logSDLError(std::cout, "LoadTexture");
+		SDL_FreeSurface(surface);
+		return nullptr;
+	}
+
+	//opaque images don't need blending
+	SDL_SetTextureBlendMode(texture, scan.opaque ? SDL_BLENDMODE_NONE : SDL_BLENDMODE_BLEND);
+
+	//keep the pixels around for the software compositor and the scaled copies
+	gCompositor.registerImage(texture, surface);
+	gTextureCache.registerSource(texture, surface, mWidth, mHeight, scan.bounds.x, scan.bounds.y);
+	SDL_FreeSurface(surface);
+
 	return texture;
 }
 //texture for the house
@@ -280,241 +432,23 @@ void setRandomRockPositions()
 		y = roll(minY, maxY);
 
 
-		if ((x != 9 && y != 5))
+		//Rocks never go on row 5, column 9 or column 5 above the house
+		if (x != 5 && y != 5 && y != 9)
 		{
 			rock.setCollisionDimensionsPos(x, y);
-			rocks.insert(std::pair<int, int>(x, y));
+			gRound->rocks.insert(std::pair<int, int>(x, y));
 
 			//std::cout<<rock.getCollisionX()<<"  "<<rock.getCollisionY()<<std::endl;
 		}
 	}
 
-
-}
-//The sprite that will move around on the screen
-class Sprite
-{
-public:
-	//The dimensions of the sprite
-	static const int SPRITE_WIDTH = 104;
-	static const int SPRITE_HEIGHT = 96;
-
-	//Maximum axis velocity of the sprite
-	static const int SPRITE_VEL = 80;
-
-	//Initializes the variables
-	Sprite();
-
-	//Set the positions of the sprite
-	void setPositions(int x, int y);
-
-	//Get the position X of the sprite
-	int getPositionX();
-
-	//Get the position Y of the sprite
-	int getPositionY();
-
-	//Takes key presses and adjusts the sprite's velocity
-	void handleEvent(SDL_Event& e);
-
-	//Moves the sprite
-	void move();
-
-	//checks all possible collisions
-	bool checkCollisions();
-
-	//checks collision between two bounded boxes
-	bool collisionExists(int x, int y, SDL_Rect b);
-
-
-private:
-	//The X and Y offsets of the sprite
-	int mPosX, mPosY;
-
-	//The velocity of the sprite
-	int mVelX, mVelY;
-
-	//Sprite's collision box
-	SDL_Rect mCollider;
-};
-Sprite::Sprite()
-{
-	//Initialize the offsets
-	mPosX = 0;
-	mPosY = 0;
-
-	//Initialize the velocity
-	mVelX = 0;
-	mVelY = 0;
-
-	//Set collision box dimension
-	mCollider.w = SPRITE_WIDTH;
-	mCollider.h = SPRITE_HEIGHT;
-}
-
-void Sprite::handleEvent(SDL_Event& e)
-{
-	//If a key was pressed
-	if (e.type == SDL_KEYDOWN && e.key.repeat == 0) //&& e.key.repeat == 0
-	{
-		//Adjust the velocity
-		switch (e.key.keysym.sym)
-		{
-		case SDLK_UP: mVelY -= SPRITE_VEL; break;
-		case SDLK_DOWN: mVelY += SPRITE_VEL; break;
-		case SDLK_LEFT: mVelX -= SPRITE_VEL; break;
-		case SDLK_RIGHT: mVelX += SPRITE_VEL; break;
-			//case SDLK_RETURN: startSprite=true;; break;
-		}
-
-	}
-	//If a key was released
-	else if (e.type == SDL_KEYUP && e.key.repeat == 0) //&& e.key.repeat == 0
-	{
-		//Adjust the velocity
-		switch (e.key.keysym.sym)
-		{
-		case SDLK_UP: mVelY += SPRITE_VEL; break;
-		case SDLK_DOWN: mVelY -= SPRITE_VEL; break;
-		case SDLK_LEFT: mVelX += SPRITE_VEL; break;
-		case SDLK_RIGHT: mVelX -= SPRITE_VEL; break;
-			//case SDLK_RETURN: startSprite=true; break;
-		}
-	}
-}
-bool Sprite::collisionExists(int x, int y, SDL_Rect b)
-{
-	//The sides of the rectangles
-	int leftA, leftB;
-	int rightA, rightB;
-	int topA, topB;
-	int bottomA, bottomB;
-
-	//Calculate the sides of rect A
-	leftA = x;
-	rightA = x + b.w;
-	topA = y;
-	bottomA = y + b.h;
-
-	//Calculate the sides of rect B
-	leftB = b.x;
-	rightB = b.x + b.w;
-	topB = b.y;
-	bottomB = b.y + b.h;
-
-	//If any of the sides from A are outside of B
-	if (bottomA <= topB + 67)
-	{
-		return false;
-	}
-
-	if (topA >= bottomB - 67)
-	{
-		return false;
-	}
-
-	if (rightA <= leftB - 50)
-	{
-		return false;
-	}
-
-	if (leftA >= rightB - 50)
-	{
-		return false;
-	}
-
-	//If none of the sides from A are outside B
-	return true;
-}
-
-bool Sprite::checkCollisions()
-{
-	SDL_Rect sprite;
-	sprite.x = mPosX;
-	sprite.y = mPosY;
-	sprite.w = SPRITE_WIDTH;
-	sprite.h = SPRITE_HEIGHT;
-
-	std::vector<int> x(rocks.size());
-	std::vector<int> y(rocks.size());
-	std::multimap<int, int>::iterator it = rocks.begin();
-	while (it != rocks.end())
-	{
-		for (int i = 0; i<x.size(); i++)
-		{
-			x[i] = ((*it).first)*TILE_SIZE;
-			++it;
-		}
-	}
-	std::multimap<int, int>::iterator it2 = rocks.begin();
-	while (it2 != rocks.end())
-	{
-		for (int j = 0; j<y.size(); j++)
-		{
-			y[j] = ((*it2).second)*TILE_SIZE;
-			++it2;
-		}
-	}
-
-	for (int k = 0; k<rocks.size(); k++)
-	{
-		for (int l = 0; l<rocks.size(); l++)
-		{
-			if (collisionExists(y[l], x[k], sprite))
-			{
-				std::cout << "Collision Detected!" << std::endl;
-				return true;
-
-			}
-		}
-	}
-
-	return false;
-}
-
-void Sprite::move()
-{
-	//Move the sprite left or right
-	mPosX += mVelX;
-	mCollider.x = mPosX;
-
-	//If the sprite went too far to the left or right
-	if ((mPosX < 0) || (mPosX + SPRITE_WIDTH > SCREEN_WIDTH - 100) || checkCollisions())
-	{
-		//Move back
-		mPosX -= mVelX;
-		mCollider.x = mPosX;
-	}
-
-	//Move the sprite up or down
-	mPosY += mVelY;
-	mCollider.y = mPosY;
-
-	//If the sprite went too far up or down
-	if ((mPosY < 0) || (mPosY + SPRITE_HEIGHT > SCREEN_HEIGHT + 50) || checkCollisions())
+	rockGrid.clear();
+	for (RockMap::iterator it = gRound->rocks.begin(); it != gRound->rocks.end(); ++it)
 	{
-		//Move back
-		mPosY -= mVelY;
-		mCollider.y = mPosY;
+		rockGrid.set(it->second, it->first);
 	}
 }
 
-void Sprite::setPositions(int x, int y)
-{
-	mPosX = x;
-	mPosY = y;
-}
-
-int Sprite::getPositionX()
-{
-	return mPosX;
-}
-
-int Sprite::getPositionY()
-{
-	return mPosY;
-}
-
 
 
 
@@ -536,7 +470,15 @@ void renderTexture(SDL_Texture *tex, SDL_Renderer *ren, int x, int y, int w, int
 	dst.y = y;
 	dst.w = w;
 	dst.h = h;
-	SDL_RenderCopy(ren, tex, NULL, &dst);
+
+	//Use the copy made at this size when the texture was loaded
+	tex = gTextureCache.resolve(tex, dst);
+
+	//Software renderers composite on the CPU instead
+	if (!gCompositor.draw(tex, dst))
+	{
+		SDL_RenderCopy(ren, tex, NULL, &dst);
+	}
 }
 /**
 * Draw an SDL_Texture to an SDL_Renderer at position x, y, preserving
@@ -548,9 +490,45 @@ void renderTexture(SDL_Texture *tex, SDL_Renderer *ren, int x, int y, int w, int
 */
 void renderTexture(SDL_Texture *tex, SDL_Renderer *ren, int x, int y){
 	int w, h;
-	SDL_QueryTexture(tex, NULL, NULL, &w, &h);
+	gTextureCache.querySize(tex, &w, &h);
 	renderTexture(tex, ren, x, y, w, h);
 }
+/**
+* Clear the renderer, or the CPU frame when the software compositor is active
+* @param ren The renderer to clear
+*/
+void clearFrame(SDL_Renderer *ren){
+	gCompositor.clear();
+	gHud.clear();
+	SDL_RenderClear(ren);
+}
+/**
+* Show everything drawn since the last clearFrame
+* @param ren The renderer to present
+*/
+void presentFrame(SDL_Renderer *ren){
+	gCompositor.present();
+
+	//HUD text goes over the finished frame
+	gHud.flush();
+	SDL_RenderPresent(ren);
+
+	//Start the sounds for this frame now that it is on screen
+	gAudio.flush();
+}
+/**
+* Rebuild the pre-scaled textures when the render scale changes
+* @param e The event to check
+* @param ren The renderer the window draws with
+*/
+void handleWindowEvent(SDL_Event &e, SDL_Renderer *ren){
+	if (e.type == SDL_WINDOWEVENT && e.window.event == SDL_WINDOWEVENT_SIZE_CHANGED)
+	{
+		float scaleX, scaleY;
+		SDL_RenderGetScale(ren, &scaleX, &scaleY);
+		gTextureCache.setScale(scaleX, scaleY);
+	}
+}
 void drawTiles(int xTiles, int yTiles, SDL_Texture *background, SDL_Texture *redTileImage, SDL_Texture *rockImage, SDL_Renderer *renderer)
 {
 	//y is row and x is colummn
@@ -567,12 +545,6 @@ void drawTiles(int xTiles, int yTiles, SDL_Texture *background, SDL_Texture *red
 	renderTexture(redTileImage, renderer, cardDown1.getCardYPos() * TILE_SIZE, cardDown1.getCardXPos() * TILE_SIZE, TILE_SIZE, TILE_SIZE);
 	renderTexture(redTileImage, renderer, cardDown2.getCardYPos() * TILE_SIZE, cardDown2.getCardXPos() * TILE_SIZE, TILE_SIZE, TILE_SIZE);
 
-	for (int i = 0; i<11; i++)
-	{
-		int x = i;
-		int y = 4;
-		renderTexture(rockImage, renderer, x * TILE_SIZE, y * TILE_SIZE, TILE_SIZE, TILE_SIZE);
-	}
 	//int homeX=0;
 	//int homeY=0;
 	//for(std::multimap<int,int>::iterator it=rocks.begin(); it!=rocks.end(); ++it)
@@ -594,17 +566,10 @@ void drawTiles(int xTiles, int yTiles, SDL_Texture *background, SDL_Texture *red
 
 	else
 	{
-		for (std::multimap<int, int>::iterator it = rocks.begin(); it != rocks.end(); ++it)
+		//Only drawn here; erasing while iterating left it pointing at a freed node
+		for (RockMap::iterator it = gRound->rocks.begin(); it != gRound->rocks.end(); ++it)
 		{
-			if ((it->first)*TILE_SIZE != 400 && (it->second)*TILE_SIZE != 720)
-			{
-				renderTexture(rockImage, renderer, (it->second)*TILE_SIZE, (it->first)*TILE_SIZE, TILE_SIZE, TILE_SIZE);
-			}
-			else
-			{
-				rocks.erase(it);
-			}
-
+			renderTexture(rockImage, renderer, (it->second)*TILE_SIZE, (it->first)*TILE_SIZE, TILE_SIZE, TILE_SIZE);
 		}
 	}
 
@@ -616,29 +581,247 @@ void drawImages(SDL_Texture *image, SDL_Texture *image2, SDL_Texture *image3, SD
 	//We need the foreground image's width to properly compute the position
 	//of it's top left corner so that the image will be centered
 	int iW, iH;
-	SDL_QueryTexture(image, NULL, NULL, &iW, &iH);
+	gTextureCache.querySize(image, &iW, &iH);
 	int x = sprite1.getPositionX();//SCREEN_WIDTH / 2 - iW / 2;
 	int y = sprite1.getPositionY();//SCREEN_HEIGHT / 2 - iH / 2;
 	renderTexture(image, renderer, x, y);
 
 	int iW2, iH2;
-	SDL_QueryTexture(image2, NULL, NULL, &iW2, &iH2);
+	gTextureCache.querySize(image2, &iW2, &iH2);
 	int x2 = sprite2.getPositionX();  //805;
 	int y2 = sprite2.getPositionY();//10;
 	renderTexture(image2, renderer, x2, y2);
 
 	int iW3, iH3;
-	SDL_QueryTexture(image3, NULL, NULL, &iW3, &iH3);
+	gTextureCache.querySize(image3, &iW3, &iH3);
 	int x3 = 400;
 	int y3 = 640;
 	renderTexture(image3, renderer, x3, y3);
 
 	int iW4, iH4;
-	SDL_QueryTexture(menuImage, NULL, NULL, &iW4, &iH4);
+	gTextureCache.querySize(menuImage, &iW4, &iH4);
 	int x4 = 880;//815
 	int y4 = 0;//10
 	renderTexture(menuImage, renderer, x4, y4);
 }
+/**
+* Replace a texture with one made from a reloaded image
+* @param owner The LTexture that loaded the image
+* @param slot The texture the game draws with, replaced on success
+* @param surface The decoded image, freed by this call
+* @param ren The renderer to load the texture onto
+*/
+void swapTexture(LTexture &owner, SDL_Texture *&slot, SDL_Surface *surface, SDL_Renderer *ren)
+{
+	SDL_Texture *texture = owner.createTexture(surface, ren);
+	if (texture == nullptr)
+	{
+		return;
+	}
+	gCompositor.unregisterImage(slot);
+	gTextureCache.unregisterSource(slot);
+	SDL_DestroyTexture(slot);
+	slot = texture;
+}
+/**
+* Get the command for an arrow key press
+* @param e The event to check
+* @param command Set to the command when there is one
+* @return false if the event isn't a new arrow key press
+*/
+bool eventCommand(SDL_Event &e, Command &command)
+{
+	if (e.type != SDL_KEYDOWN || e.key.repeat != 0)
+	{
+		return false;
+	}
+	switch (e.key.keysym.sym)
+	{
+	case SDLK_UP: command = COMMAND_UP; return true;
+	case SDLK_DOWN: command = COMMAND_DOWN; return true;
+	case SDLK_LEFT: command = COMMAND_LEFT; return true;
+	case SDLK_RIGHT: command = COMMAND_RIGHT; return true;
+	}
+	return false;
+}
+/**
+* Queue the HUD text under the instructions in the command panel
+* @param commands The moves typed but not run yet
+* @param moves The moves run this round
+* @param roundStart The SDL_GetTicks value when the round started
+* @param outcome Where the last program ends up, or nullptr before one has run
+*/
+void drawHud(const CommandRing &commands, int moves, Uint32 roundStart, const char *outcome)
+{
+	SDL_Color black = { 0, 0, 0, 255 };
+	int x = 895;
+	int y = 640;
+	char line[32];
+
+	Uint32 seconds = (SDL_GetTicks() - roundStart) / 1000;
+	SDL_snprintf(line, sizeof(line), "Time %u:%02u", seconds / 60, seconds % 60);
+	y = gHud.drawText(line, x, y, black);
+
+	SDL_snprintf(line, sizeof(line), "Moves %d", moves);
+	y = gHud.drawText(line, x, y, black);
+
+	//Only the newest commands fit in the panel
+	unsigned count = commands.size();
+	unsigned first = count > 12 ? count - 12 : 0;
+	int length = SDL_snprintf(line, sizeof(line), first > 0 ? "Queued ..." : "Queued ");
+	for (unsigned i = first; i < count; i++)
+	{
+		line[length++] = COMMAND_SYMBOLS[commands.peek(i)];
+	}
+	line[length] = 0;
+	y = gHud.drawText(line, x, y, black, 120);
+
+	if (outcome != NULL)
+	{
+		SDL_snprintf(line, sizeof(line), "Ends %s", outcome);
+		gHud.drawText(line, x, y, black, 120);
+	}
+}
+/**
+* Describe what happens to a frog stopped on a tile
+* @param trigger The tile's trigger
+* @return a few words for the HUD
+*/
+const char *outcomeText(const CellTrigger &trigger)
+{
+	switch (trigger.action)
+	{
+	case TRIGGER_SAFE: return "hidden";
+	case TRIGGER_HOME: return "at home";
+	case TRIGGER_BIRD: return "at the pelican";
+	case TRIGGER_TELEPORT: return "through a door";
+	}
+
+	//Stopping in the open, the pelican catches the frog
+	return "caught";
+}
+/**
+* Put a rock on a tile or take it off, keeping the hints current
+* @param col The tile's column
+* @param row The tile's row
+* @param frog The frog, whose solid pixels decide whether the tile blocks it
+*/
+void toggleRock(int col, int row, Sprite &frog)
+{
+	//Rocks never go on row 5, column 5 or column 9, so those can't be edited
+	if (col < 0 || col >= FROG_COLS || row < 0 || row >= FROG_ROWS || row == 5 || col == 5 || col == 9)
+	{
+		return;
+	}
+
+	bool removed = false;
+	RockMap::iterator it = gRound->rocks.lower_bound(row);
+	while (it != gRound->rocks.end() && it->first == row)
+	{
+		if (it->second == col)
+		{
+			it = gRound->rocks.erase(it);
+			removed = true;
+		}
+		else
+		{
+			++it;
+		}
+	}
+	if (removed)
+	{
+		rockGrid.reset(col, row);
+	}
+	else
+	{
+		gRound->rocks.insert(std::pair<int, int>(row, col));
+		rockGrid.set(col, row);
+	}
+	hintField.setBlocked(col, row, frog.touchesRock(col * TILE_SIZE + FROG_OFFSET_X, row * TILE_SIZE + FROG_OFFSET_Y));
+}
+/**
+* Queue the best next press from the frog's tile over the board
+* @param col The frog's column
+* @param row The frog's row
+*/
+void drawHint(int col, int row)
+{
+	SDL_Color green = { 0, 128, 0, 255 };
+	int hint = hintField.getHint(col, row);
+	if (hint == HINT_NONE)
+	{
+		return;
+	}
+
+	//The arrow goes on the tile to step onto, enter on the door itself
+	char text[2] = { 0, 0 };
+	const char *label = "Enter";
+	if (hint != HINT_ENTER)
+	{
+		col += COMMAND_DX[hint];
+		row += COMMAND_DY[hint];
+		text[0] = COMMAND_SYMBOLS[hint];
+		label = text;
+	}
+	int x = col * TILE_SIZE + (TILE_SIZE - gHud.measure(label)) / 2;
+	int y = row * TILE_SIZE + (TILE_SIZE - gHud.getLineHeight()) / 2;
+	gHud.drawText(label, x, y, green);
+}
+/**
+* Read and compile a command program
+* @param file The program's source file
+* @param program The program to compile into
+* @return false if the file couldn't be read or didn't compile
+*/
+bool loadProgram(const char *file, Program &program)
+{
+	SDL_RWops *rw = SDL_RWFromFile(file, "rb");
+	if (rw == NULL)
+	{
+		printf("Failed to open program %s! SDL Error: %s\n", file, SDL_GetError());
+		return false;
+	}
+	Sint64 size = SDL_RWsize(rw);
+	std::vector<char> source(size > 0 ? static_cast<size_t>(size) + 1 : 1, 0);
+	if (size > 0)
+	{
+		SDL_RWread(rw, &source[0], 1, static_cast<size_t>(size));
+	}
+	SDL_RWclose(rw);
+
+	if (!program.compile(&source[0]))
+	{
+		printf("Program %s: %s\n", file, program.getError());
+		return false;
+	}
+	return true;
+}
+/**
+* Close the allocation counts of one gameplay frame and start the next
+* @param frame The frame of the round that just ended, from 0
+* @return false if a frame past the warm-up allocated outside asset reloads
+*/
+bool checkFrameAllocs(int frame)
+{
+	AllocCounts total = allocFrameCounts();
+	AllocCounts assets = allocFrameCounts(ALLOC_ASSETS);
+	bool clean = frame < ALLOC_WARMUP_FRAMES || total.count == assets.count;
+	if (!clean)
+	{
+		printf("Frame %d allocated %llu times, %llu bytes:", frame, total.count - assets.count, total.bytes - assets.bytes);
+		for (int i = 0; i < ALLOC_TAG_COUNT; i++)
+		{
+			AllocCounts counts = allocFrameCounts(static_cast<AllocTag>(i));
+			if (counts.count > 0 && i != ALLOC_ASSETS)
+			{
+				printf(" %s %llu", allocTagName(static_cast<AllocTag>(i)), counts.count);
+			}
+		}
+		printf("\n");
+	}
+	allocFrameBegin();
+	return clean;
+}
 
 
 
@@ -646,15 +829,143 @@ void drawImages(SDL_Texture *image, SDL_Texture *image2, SDL_Texture *image3, SD
 int main(int argc, char** argv)
 {
 	//The music that will be played
-	Mix_Music *gMusicIntro = NULL;
-	Mix_Music *gMusicMid = NULL;
-	Mix_Music *gMusicEnd = NULL;
+	const char *musicIntro = "GameIntro.mp3";
+	const char *musicMid = "GameMid.mp3";
+	const char *musicEnd = "Undefeated.mp3";
 
 	//The sound effects that will be used
 	Mix_Chunk *gCroak = NULL;
 	Mix_Chunk *gWhoosh = NULL;
 	Mix_Chunk *gLaugh = NULL;
 
+	//Audio device settings, the defaults keep sound effects under 10 ms
+	int audioFrequency = AUDIO_DEFAULT_FREQUENCY;
+	int audioSamples = AUDIO_LOW_LATENCY_SAMPLES;
+	bool audioTest = false;
+
+	//Dev mode reloads edited assets while the game runs
+	bool devMode = false;
+
+	//Quit with an error when a steady gameplay frame allocates
+	bool allocCheck = false;
+	int exitCode = 0;
+
+	//Command program the P key queues, run first on a headless board
+	const char *programFile = NULL;
+
+	//Batch grading of a class's programs against a level set, without a window
+	const char *gradeLevels = NULL;
+	const char *gradeSubmissions = NULL;
+	const char *gradeCsv = NULL;
+
+	//Cheapest solution of every level in a level set, without a window
+	const char *solveLevels = NULL;
+	int solveMegabytes = TRANSPOSITION_DEFAULT_MB;
+	ReplacePolicy solvePolicy = REPLACE_DEPTH_AGE;
+
+	//Headless fuzzing of the game rules, or a replay of a case it saved
+	int fuzzSeconds = 0;
+	unsigned long long fuzzSeed = 1;
+	const char *fuzzOut = "fuzz-crash.bin";
+	const char *fuzzReplay = NULL;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--audio-rate" && i + 1 < argc)
+		{
+			audioFrequency = atoi(argv[++i]);
+		}
+		else if (arg == "--audio-samples" && i + 1 < argc)
+		{
+			audioSamples = atoi(argv[++i]);
+		}
+		else if (arg == "--audio-test")
+		{
+			audioTest = true;
+		}
+		else if (arg == "--dev")
+		{
+			devMode = true;
+		}
+		else if (arg == "--alloc-check")
+		{
+			allocCheck = true;
+		}
+		else if (arg == "--program" && i + 1 < argc)
+		{
+			programFile = argv[++i];
+		}
+		else if (arg == "--grade" && i + 2 < argc)
+		{
+			gradeLevels = argv[++i];
+			gradeSubmissions = argv[++i];
+		}
+		else if (arg == "--csv" && i + 1 < argc)
+		{
+			gradeCsv = argv[++i];
+		}
+		else if (arg == "--solve" && i + 1 < argc)
+		{
+			solveLevels = argv[++i];
+		}
+		else if (arg == "--solve-mb" && i + 1 < argc)
+		{
+			solveMegabytes = atoi(argv[++i]);
+		}
+		else if (arg == "--solve-policy" && i + 1 < argc)
+		{
+			//always, depth or age, to compare how each keeps the table
+			std::string policy = argv[++i];
+			solvePolicy = policy == "always" ? REPLACE_ALWAYS : (policy == "depth" ? REPLACE_DEPTH : REPLACE_DEPTH_AGE);
+		}
+		else if (arg == "--fuzz" && i + 1 < argc)
+		{
+			fuzzSeconds = atoi(argv[++i]);
+		}
+		else if (arg == "--fuzz-seed" && i + 1 < argc)
+		{
+			fuzzSeed = strtoull(argv[++i], NULL, 10);
+		}
+		else if (arg == "--fuzz-out" && i + 1 < argc)
+		{
+			fuzzOut = argv[++i];
+		}
+		else if (arg == "--fuzz-replay" && i + 1 < argc)
+		{
+			fuzzReplay = argv[++i];
+		}
+	}
+
+	//Grading only needs the job system
+	if (gradeLevels != NULL)
+	{
+		gJobs.init();
+		int gradeCode = runGrader(gradeLevels, gradeSubmissions, gradeCsv);
+		gJobs.shutdown();
+		return gradeCode;
+	}
+	if (solveLevels != NULL)
+	{
+		gJobs.init();
+		int solveCode = runSolver(solveLevels, solveMegabytes, solvePolicy);
+		gJobs.shutdown();
+		return solveCode;
+	}
+
+	//Fuzzing runs on this thread alone
+	if (fuzzReplay != NULL)
+	{
+		return replayFuzzCase(fuzzReplay);
+	}
+	if (fuzzSeconds > 0)
+	{
+		return runFuzzer(fuzzSeed, fuzzSeconds, fuzzOut);
+	}
+	if (allocCheck && !allocTrackingEnabled())
+	{
+		printf("--alloc-check needs a build with FROG_TRACK_ALLOCS defined\n");
+	}
+
 	bool success = true;
 	//Start up SDL and make sure it went ok
 	if (SDL_Init(SDL_INIT_EVERYTHING) != 0){
@@ -667,6 +978,31 @@ int main(int argc, char** argv)
 		printf("SDL could not initialize! SDL Error: %s\n", SDL_GetError());
 		success = false;
 	}
+	if (TTF_Init() < 0)
+	{
+		printf("SDL_ttf could not initialize! SDL_ttf Error: %s\n", TTF_GetError());
+	}
+
+	//Loopback test: time triggered sounds against the mixer callback and quit
+	if (audioTest)
+	{
+		AudioLatency latency;
+		bool measured = gAudio.open(audioFrequency, audioSamples) && gAudio.measureLatency(AUDIO_TEST_TRIALS, latency);
+		if (measured)
+		{
+			printf("Trigger to callback: %.2f ms average, %.2f ms worst, plus %.2f ms device buffer\n", latency.averageMs, latency.worstMs, latency.bufferMs);
+
+			VoiceStats stats = gAudio.getVoiceStats();
+			printf("Mixer callbacks: %u, voices mixed: %u, peak voices: %u\n", stats.callbacks, stats.voicesMixed, stats.peakVoices);
+		}
+		else
+		{
+			printf("Audio latency test failed! SDL_mixer Error: %s\n", Mix_GetError());
+		}
+		gAudio.close();
+		SDL_Quit();
+		return measured ? 0 : 4;
+	}
 
 
 	//Set texture filtering to linear
@@ -675,7 +1011,7 @@ int main(int argc, char** argv)
 		printf("Warning: Linear texture filtering not enabled!");
 	}//Setup our window and renderer
 
-	SDL_Window *window = SDL_CreateWindow("Frog Chase", 100, 100, SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_SHOWN);
+	SDL_Window *window = SDL_CreateWindow("Frog Chase", 100, 100, SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE);
 	if (window == nullptr)
 	{
 		logSDLError(std::cout, "CreateWindow");
@@ -685,22 +1021,35 @@ int main(int argc, char** argv)
 
 	SDL_Renderer *renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
 	if (renderer == nullptr)
+	{
+		//No usable GPU, fall back to SDL's software renderer
+		renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_SOFTWARE);
+	}
+	if (renderer == nullptr)
 	{
 		logSDLError(std::cout, "CreateRenderer");
 		return 3;
 	}
 	else
 	{
+		//Draw at the board's size and let SDL scale it to the window, which
+		//sets the render scale handleWindowEvent passes to the texture cache
+		SDL_RenderSetLogicalSize(renderer, SCREEN_WIDTH, SCREEN_HEIGHT);
 
 		//Initialize SDL_mixer
-		if (Mix_OpenAudio(44100, MIX_DEFAULT_FORMAT, 2, 2048) < 0)
+		if (!gAudio.open(audioFrequency, audioSamples))
 		{
 			printf("SDL_mixer could not initialize! SDL_mixer Error: %s\n", Mix_GetError());
 			success = false;
 		}
 	}
 
+	//Start the shared job system on the thread that owns the renderer
+	gJobs.init();
 
+	//Composite on the CPU when the renderer has no GPU behind it
+	gCompositor.init(renderer, SCREEN_WIDTH, SCREEN_HEIGHT);
+	gTextureCache.init(renderer);
 
 	//The textures we'll be using
 	LTexture t1, t2, t3, intro, end, redTile;
@@ -715,26 +1064,30 @@ int main(int argc, char** argv)
 	SDL_Texture *redTileImage = redTile.loadTexture("mysterydoor_tiny.png", renderer);
 	SDL_Texture *rockImage = rock.loadTexture("small_rock.png", renderer);
 
-	//Load music
-	gMusicIntro = Mix_LoadMUS("GameIntro.mp3");
-	if (gMusicIntro == NULL)
+	//Scale the tiles once now instead of every frame
+	gTextureCache.prepare(background, TILE_SIZE, TILE_SIZE);
+	gTextureCache.prepare(redTileImage, TILE_SIZE, TILE_SIZE);
+	gTextureCache.prepare(rockImage, TILE_SIZE, TILE_SIZE);
+
+	//Rocks are drawn a tile in size, so that's the mask the frog is tested against
+	rockMask.buildScaled(rock.getMask(), TILE_SIZE, TILE_SIZE);
+
+	//HUD font, the one shipped in the game folder; the system fonts are only
+	//fallbacks for when it has been left out
+	const char *hudFonts[] = { "hud.ttf", "C:\\Windows\\Fonts\\arial.ttf", "/Library/Fonts/Arial.ttf", "/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf" };
+	for (size_t i = 0; i < sizeof(hudFonts) / sizeof(hudFonts[0]) && !gHud.isLoaded(); i++)
 	{
-		printf("Failed to load beat music! SDL_mixer Error: %s\n", Mix_GetError());
-		success = false;
+		gHud.init(renderer, hudFonts[i], 14);
 	}
-	//Load music
-	gMusicMid = Mix_LoadMUS("GameMid.mp3");
-	if (gMusicMid == NULL)
+	if (!gHud.isLoaded())
 	{
-		printf("Failed to load beat music! SDL_mixer Error: %s\n", Mix_GetError());
-		success = false;
+		printf("Failed to load the HUD font hud.ttf, the HUD is off\n");
 	}
-	//Load music
-	gMusicEnd = Mix_LoadMUS("Undefeated.mp3");
-	if (gMusicEnd == NULL)
+
+	//Music is decoded in the background as each phase asks for it
+	if (!gMusic.start())
 	{
-		printf("Failed to load beat music! SDL_mixer Error: %s\n", Mix_GetError());
-		success = false;
+		printf("Music streaming needs 16 bit stereo output\n");
 	}
 
 	//Load sound effects
@@ -761,36 +1114,56 @@ int main(int argc, char** argv)
 		success = false;
 	}
 
-	bool allGame = false;
-
-	while (!allGame)
+	//Dev mode: edits to the art and sounds show up without a restart
+	if (devMode)
 	{
-		//Load music
-		gMusicIntro = Mix_LoadMUS("GameIntro.mp3");
-		if (gMusicIntro == NULL)
+		gHotReload.watchImage("white_tile_small.png", [&](SDL_Surface *s){ swapTexture(t1, background, s, renderer); });
+		gHotReload.watchImage("frog_tiny.png", [&](SDL_Surface *s){ swapTexture(t2, image, s, renderer); });
+		gHotReload.watchImage("pelican.png", [&](SDL_Surface *s){ swapTexture(t3, image2, s, renderer); });
+		gHotReload.watchImage("frog_house.png", [&](SDL_Surface *s){ swapTexture(t4, image3, s, renderer); });
+		gHotReload.watchImage("command_screen.png", [&](SDL_Surface *s){ swapTexture(menu, menuImage, s, renderer); });
+		gHotReload.watchImage("peeking_frog2.png", [&](SDL_Surface *s){ swapTexture(intro, introImage, s, renderer); });
+		gHotReload.watchImage("game_over_screen.png", [&](SDL_Surface *s){ swapTexture(end, gameOverImage, s, renderer); });
+		gHotReload.watchImage("mysterydoor_tiny.png", [&](SDL_Surface *s){ swapTexture(redTile, redTileImage, s, renderer); });
+		gHotReload.watchImage("small_rock.png", [&](SDL_Surface *s)
 		{
-			printf("Failed to load beat music! SDL_mixer Error: %s\n", Mix_GetError());
-			success = false;
-		}
-		//Load music
-		gMusicMid = Mix_LoadMUS("GameMid.mp3");
-		if (gMusicMid == NULL)
-		{
-			printf("Failed to load beat music! SDL_mixer Error: %s\n", Mix_GetError());
-			success = false;
-		}
-		//Load music
-		gMusicEnd = Mix_LoadMUS("Undefeated.mp3");
-		if (gMusicEnd == NULL)
+			swapTexture(rock, rockImage, s, renderer);
+			rockMask.buildScaled(rock.getMask(), TILE_SIZE, TILE_SIZE);
+		});
+		gHotReload.watchSound("Frog Croaking.wav", &gCroak);
+		gHotReload.watchSound("Whoosh.wav", &gWhoosh);
+		gHotReload.watchSound("Evil_laugh.wav", &gLaugh);
+		if (!gHotReload.start("."))
 		{
-			printf("Failed to load beat music! SDL_mixer Error: %s\n", Mix_GetError());
-			success = false;
+			printf("Failed to watch the asset folder for changes\n");
 		}
+	}
+
+	bool allGame = false;
+
+	//Moves of the program being replayed, kept so replays don't allocate;
+	//a ring of commands never makes more runs than it holds
+	std::vector<MoveRun> runs;
+	runs.reserve(COMMAND_RING_CAPACITY);
+
+	//The H key shows the best next press
+	bool showHints = false;
+
+	while (!allGame)
+	{
+		beginRound();
 		setRandomRockPositions();
 		cardHome.setPositions(3 * TILE_SIZE, 7 * TILE_SIZE);
 		cardBird.setRandomPositions();
 		cardDown1.setRandomPositions();
 		cardDown2.setRandomPositions();
+
+		//Later doors win when two cards land on the same tile
+		level.reset();
+		level.setTrigger(cardDown2.getCardYPos(), cardDown2.getCardXPos(), TRIGGER_TELEPORT, 0, 6);
+		level.setTrigger(cardDown1.getCardYPos(), cardDown1.getCardXPos(), TRIGGER_TELEPORT, 0, 5);
+		level.setTrigger(cardBird.getCardYPos(), cardBird.getCardXPos(), TRIGGER_BIRD);
+		level.setTrigger(cardHome.getCardYPos() / TILE_SIZE, cardHome.getCardXPos() / TILE_SIZE, TRIGGER_HOME);
 		bool gameEnd = false;
 		int x = 415;
 		int y = SCREEN_HEIGHT - 80;
@@ -808,9 +1181,20 @@ int main(int argc, char** argv)
 
 		sprite1.setPositions(20, 30);
 		sprite2.setPositions(815, 10);
+		sprite1.setColliderSize(t2.getWidth(), t2.getHeight());
+		sprite2.setColliderSize(t3.getWidth(), t3.getHeight());
+		sprite1.setMask(&t2.getMask());
+		sprite2.setMask(&t3.getMask());
+		sprite1.setRocks(&rockGrid, &rockMask);
+		sprite2.setRocks(&rockGrid, &rockMask);
+
+		//Arrows waiting for enter
+		CommandRing &commands = gRound->commands;
 
-		//queue of events
-		std::queue<SDL_Event> events;
+		//Distances home for this layout; edits repair them from here on
+		MoveBoard hintBoard;
+		buildMoveBoard(sprite1, hintBoard);
+		hintField.rebuild(hintBoard, level);
 
 		//Determine how many tiles we'll need to fill the screen
 		int xTiles = SCREEN_WIDTH / TILE_SIZE;
@@ -818,14 +1202,18 @@ int main(int argc, char** argv)
 
 		bool exit = false;
 		int channel = -1;
-		Mix_PlayMusic(gMusicIntro, -1);
+		gMusic.play(musicIntro);
 		//welcome screen
 		while (!exit)
 		{
+			//Run render work queued by the workers
+			gJobs.pumpMainThread();
 
+			//Swap in assets edited since the last frame
+			gHotReload.update();
 
 			int iW, iH;
-			SDL_QueryTexture(introImage, NULL, NULL, &iW, &iH);
+			gTextureCache.querySize(introImage, &iW, &iH);
 			int x = SCREEN_WIDTH / 2 - iW / 2;
 			int y = SCREEN_HEIGHT / 2 - iH / 2;
 
@@ -833,10 +1221,11 @@ int main(int argc, char** argv)
 
 
 			//Update the screen
-			SDL_RenderPresent(renderer);
+			presentFrame(renderer);
 
 			while (SDL_PollEvent(&e))
 			{
+				handleWindowEvent(e, renderer);
 				if (e.type == SDL_QUIT)
 				{
 					exit = true;
@@ -847,39 +1236,52 @@ int main(int argc, char** argv)
 				if (e.type == SDL_KEYDOWN || e.type == SDL_KEYUP)
 				{
 
-					events.push(e);
 					if (e.key.keysym.sym == SDLK_RETURN)
 					{
-						channel = Mix_PlayChannel(-1, gCroak, 0);
+						channel = gAudio.play(gCroak, SOUND_UI);
 						SDL_Delay(200);
-						Mix_HaltChannel(channel);
+						if (channel >= 0)
+						{
+							Mix_HaltChannel(channel);
+						}
 						exit = true;
 					}
 					else if (e.key.keysym.sym == SDLK_m)
 					{
-						Mix_PlayMusic(gMusicIntro, -1);
+						gMusic.play(musicIntro);
 					}
 					else if (e.key.keysym.sym == SDLK_0)
 					{
-						Mix_HaltMusic();
+						gMusic.pause();
 					}
 				}
 			}
 
 		}
 
-		//Stop the music
-		Mix_HaltMusic();
-		Mix_FreeMusic(gMusicIntro);
-		gMusicIntro = NULL;
-		SDL_Delay(50);
-		Mix_PlayMusic(gMusicMid, -1);
+		//Crossfade into the level music
+		gMusic.play(musicMid);
+
+		//What the HUD shows for this round
+		int moves = 0;
+		const char *outcome = NULL;
+		Uint32 roundStart = SDL_GetTicks();
+		int frame = 0;
+		allocFrameBegin();
 		//main game loop
 		while (!quit)
 		{
+			AllocScope gameScope(ALLOC_GAME);
+
+			//Run render work queued by the workers
+			gJobs.pumpMainThread();
+
+			//Swap in assets edited since the last frame
+			gHotReload.update();
 
 			while (SDL_PollEvent(&e))
 			{
+				handleWindowEvent(e, renderer);
 				if (e.type == SDL_QUIT)
 				{
 					quit = true;
@@ -889,40 +1291,103 @@ int main(int argc, char** argv)
 				if (e.type == SDL_KEYDOWN || e.type == SDL_KEYUP)
 				{
 
-					events.push(e);
-					if (e.key.keysym.sym == SDLK_RETURN)
+					Command command;
+					if (eventCommand(e, command))
+					{
+						commands.push(command);
+					}
+					if (e.key.keysym.sym == SDLK_RETURN && !commands.empty())
 					{
-						while (!events.empty())
+						//Run the whole program first, so the outcome is known before
+						//the replay and moves into rocks or the edge aren't shown
+						MoveBoard board;
+						buildMoveBoard(sprite1, board);
+						int col = (sprite1.getPositionX() - FROG_OFFSET_X) / TILE_SIZE;
+						int row = (sprite1.getPositionY() - FROG_OFFSET_Y) / TILE_SIZE;
+						ProgramResult plan = planMoves(commands, board, col, row, runs);
+						commands.clear();
+						moves += plan.blockedMoves;
+						outcome = outcomeText(level.getTrigger(plan.col, plan.row));
+
+						//Long programs play faster instead of taking a tenth of a second a step
+						int steps = static_cast<int>(plan.moves - plan.blockedMoves);
+						int delay = steps * STEP_DELAY_MS > REPLAY_BUDGET_MS ? REPLAY_BUDGET_MS / steps : STEP_DELAY_MS;
+						delay = delay < MIN_STEP_DELAY_MS ? MIN_STEP_DELAY_MS : delay;
+
+						for (size_t r = 0; r < runs.size(); r++)
 						{
-							SDL_Event b = events.front();
-							sprite1.handleEvent(b);
-							SDL_RenderClear(renderer);
-							drawTiles(xTiles, yTiles, background, redTileImage, rockImage, renderer);
-							drawImages(image, image2, image3, menuImage, sprite1, sprite2, renderer);
-							sprite1.move();
-
-							Mix_PlayChannel(-1, gWhoosh, 0);
-
-							SDL_Delay(100); // possible delay.
-
-							SDL_RenderPresent(renderer);
-
-							events.pop();
+							for (int i = 0; i < runs[r].count; i++)
+							{
+								moves++;
+								sprite1.runCommand(runs[r].command);
+								clearFrame(renderer);
+								drawTiles(xTiles, yTiles, background, redTileImage, rockImage, renderer);
+								drawImages(image, image2, image3, menuImage, sprite1, sprite2, renderer);
+								drawHud(commands, moves, roundStart, outcome);
+
+								//One whoosh per straight run
+								if (i == 0)
+								{
+									gAudio.playOnPresent(gWhoosh, SOUND_STEP);
+								}
+
+								SDL_Delay(delay);
+
+								presentFrame(renderer);
+							}
 						}
 						//startSprite = true;
 
 					}
+					else if (e.key.keysym.sym == SDLK_p && e.type == SDL_KEYDOWN && programFile != NULL)
+					{
+						//Re-read the program so edits show up, then queue the moves it makes;
+						//reading and compiling it is a file load like a hot reload
+						AllocScope scope(ALLOC_ASSETS);
+						Program program;
+						if (loadProgram(programFile, program))
+						{
+							MoveBoard board;
+							buildMoveBoard(sprite1, board);
+							int col = (sprite1.getPositionX() - FROG_OFFSET_X) / TILE_SIZE;
+							int row = (sprite1.getPositionY() - FROG_OFFSET_Y) / TILE_SIZE;
+
+							//The moves go after the ones already queued, so the program starts where those end
+							ProgramResult queued = planMoves(commands, board, col, row, runs);
+							ProgramResult result = program.run(board, queued.col, queued.row);
+
+							//Queue all of it or none, so the queue ends where the report says
+							if (result.moves > COMMAND_RING_CAPACITY - commands.size())
+							{
+								printf("Program: %u moves don't fit, only %u more can be queued\n", result.moves, COMMAND_RING_CAPACITY - commands.size());
+							}
+							else
+							{
+								program.run(board, queued.col, queued.row, PROGRAM_STEP_BUDGET, &commands);
+								printf("Program: %u steps, %u moves, %u blocked, ends on %d, %d%s\n", result.steps, result.moves, result.blockedMoves, result.col, result.row, result.status == PROGRAM_OUT_OF_STEPS ? ", out of steps" : "");
+							}
+						}
+					}
+					else if (e.key.keysym.sym == SDLK_h && e.type == SDL_KEYDOWN)
+					{
+						showHints = !showHints;
+					}
 					else if (e.key.keysym.sym == SDLK_0)
 					{
 						//Stop the music
-						Mix_PauseMusic();
+						gMusic.pause();
 					}
 					else if (e.key.keysym.sym == SDLK_m)
 					{
 						//Play the music
-						Mix_PlayMusic(gMusicMid, -1);
+						gMusic.play(musicMid);
 					}
 				}
+				else if (devMode && e.type == SDL_MOUSEBUTTONDOWN && e.button.button == SDL_BUTTON_LEFT)
+				{
+					//Dev mode: clicking a tile puts a rock on it or takes it off
+					toggleRock(e.button.x / TILE_SIZE, e.button.y / TILE_SIZE, sprite1);
+				}
 			}
 
 
@@ -935,7 +1400,7 @@ int main(int argc, char** argv)
 
 
 			//Clear the window
-			SDL_RenderClear(renderer);
+			clearFrame(renderer);
 
 
 			//Draw the tiles by calculating their positions
@@ -943,29 +1408,23 @@ int main(int argc, char** argv)
 
 			//draw all images
 			drawImages(image, image2, image3, menuImage, sprite1, sprite2, renderer);
+			drawHud(commands, moves, roundStart, outcome);
+			if (showHints)
+			{
+				drawHint((sprite1.getPositionX() - FROG_OFFSET_X) / TILE_SIZE, (sprite1.getPositionY() - FROG_OFFSET_Y) / TILE_SIZE);
+			}
 
 
 			//Update the screen
-			SDL_RenderPresent(renderer);
+			presentFrame(renderer);
 
 			int frogPosX = sprite1.getPositionX();
 			int frogPosY = sprite1.getPositionY();
 
-			int cHomeX = cardHome.getCardXPos() + 30;
-			int cHomeY = cardHome.getCardYPos() + 20;
-
-			int cBirdX = cardBird.getCardXPos()*TILE_SIZE + 30;
-			int cBirdY = cardBird.getCardYPos()*TILE_SIZE + 20;
-
-			int cDown1X = cardDown1.getCardXPos()*TILE_SIZE + 30;
-			int cDown1Y = cardDown1.getCardYPos()*TILE_SIZE + 20;
-
-			int cDown2X = cardDown2.getCardXPos()*TILE_SIZE + 30;
-			int cDown2Y = cardDown2.getCardYPos()*TILE_SIZE + 20;
-			//std::cout<<frogPosY;
-
-			if (frogPosX <= 420 && frogPosX >= 400 && frogPosY <= 670 && frogPosY >= 650)
+			const CellTrigger &trigger = level.getTriggerAt(frogPosX, frogPosY);
+			switch (trigger.action)
 			{
+			case TRIGGER_HOME:
 				sprite1.setPositions(410, SCREEN_HEIGHT - 80);
 				sprite2.setPositions(815, 10);
 
@@ -973,116 +1432,102 @@ int main(int argc, char** argv)
 				drawImages(image, image2, image3, menuImage, sprite1, sprite2, renderer);
 
 				//play music for winning
-				Mix_PlayMusic(gMusicEnd, -1);
+				gMusic.play(musicEnd);
 
 				//Update the screen
-				SDL_RenderPresent(renderer);
+				presentFrame(renderer);
 				SDL_Delay(400);
 				quit = true;
-			}
-			else if (frogPosX == cHomeY && frogPosY == cHomeX)
-			{
-				sprite1.setPositions(420, 670);
-				sprite2.setPositions(815, 10);
-				drawTiles(xTiles, yTiles, background, redTileImage, rockImage, renderer);
-				drawImages(image, image2, image3, menuImage, sprite1, sprite2, renderer);
-				//play music for winning
-				Mix_PlayMusic(gMusicEnd, -1);
-				//Update the screen
-				SDL_RenderPresent(renderer);
-				SDL_Delay(400);
+				break;
 
-				quit = true;
-			}
-			else if (frogPosX == cBirdY && frogPosY == cBirdX)
-			{
+			case TRIGGER_BIRD:
 				sprite1.setPositions(815, 10);
 				sprite2.setPositions(815, 10);
 				drawTiles(xTiles, yTiles, background, redTileImage, rockImage, renderer);
 				drawImages(image, image2, image3, menuImage, sprite1, sprite2, renderer);
 				//play music for losing
-				Mix_PlayChannel(-1, gLaugh, 0);
+				gAudio.playOnPresent(gLaugh, SOUND_STING);
+				gMusic.fadeOut();
 				//Update the screen
-				SDL_RenderPresent(renderer);
+				presentFrame(renderer);
 				SDL_Delay(200);
 
 				quit = true;
-			}
-			else if (frogPosX == cDown1Y && frogPosY == cDown1X)
-			{
-				sprite1.setPositions(20, 430);
-				sprite2.setPositions(815, 10);
-				drawTiles(xTiles, yTiles, background, redTileImage, rockImage, renderer);
-				drawImages(image, image2, image3, menuImage, sprite1, sprite2, renderer);
-				//Update the screen
-				SDL_RenderPresent(renderer);
-				SDL_Delay(200);
+				break;
 
-			}
-			else if (frogPosX == cDown2Y && frogPosY == cDown2X)
-			{
-				sprite1.setPositions(20, 510);
+			case TRIGGER_TELEPORT:
+				sprite1.setPositions(trigger.targetCol * TILE_SIZE + FROG_OFFSET_X, trigger.targetRow * TILE_SIZE + FROG_OFFSET_Y);
 				sprite2.setPositions(815, 10);
 				drawTiles(xTiles, yTiles, background, redTileImage, rockImage, renderer);
 				drawImages(image, image2, image3, menuImage, sprite1, sprite2, renderer);
 				//Update the screen
-				SDL_RenderPresent(renderer);
-				SDL_Delay(200);
-			}
-			if (frogPosX == cDown2Y && frogPosY == cDown2X || frogPosX == cDown1Y && frogPosY == cDown1X || frogPosX == 20 && frogPosY == 30 || frogPosX == 20 && frogPosY == 430 || frogPosX == 20 && frogPosY == 510 || (frogPosX <= 420 && frogPosX >= 400 && frogPosY <= 670 && frogPosY >= 650))
-			{
+				presentFrame(renderer);
+				//Idle, cut short when an edited asset is ready to swap in
+				gHotReload.wait(200);
+				break;
+
+			case TRIGGER_SAFE:
 				sprite2.setPositions(815, 10);
 				drawTiles(xTiles, yTiles, background, redTileImage, rockImage, renderer);
 				drawImages(image, image2, image3, menuImage, sprite1, sprite2, renderer);
 
 				//Update the screen
-				SDL_RenderPresent(renderer);
-				SDL_Delay(200);
-			}
-			else
-			{
-				//if(frogPosX !=20 || frogPosY != 30 || frogPosX!=20 && frogPosY != 30)
-				//{
+				presentFrame(renderer);
+				//Idle, cut short when an edited asset is ready to swap in
+				gHotReload.wait(200);
+				break;
+
+			default:
+				//Out in the open, the pelican catches the frog
 				sprite2.setPositions(frogPosX, frogPosY);
 				drawTiles(xTiles, yTiles, background, redTileImage, rockImage, renderer);
 				drawImages(image, image2, image3, menuImage, sprite1, sprite2, renderer);
-				Mix_PlayChannel(-1, gWhoosh, 0);
+				gAudio.playOnPresent(gWhoosh, SOUND_STEP);
 				//play music for losing
-				Mix_PlayChannel(-1, gLaugh, 0);
+				gAudio.playOnPresent(gLaugh, SOUND_STING);
+				gMusic.fadeOut();
 				//Update the screen
-				SDL_RenderPresent(renderer);
+				presentFrame(renderer);
 				SDL_Delay(200);
 
 				quit = true;
-
-
-				//}
+				break;
 			}
 
-
+			//Once warmed up, a frame must not touch the heap; the last frame
+			//of a round changes music and is not steady state
+			if (!quit && !checkFrameAllocs(frame++) && allocCheck)
+			{
+				exitCode = 5;
+				quit = true;
+				gameEnd = true;
+				allGame = true;
+			}
 		}
-		//Stop the music
-		//Mix_HaltMusic();
-		Mix_FreeMusic(gMusicMid);
-		gMusicMid = NULL;
 		//game over screen
 
 		while (!gameEnd)
 		{
+			//Run render work queued by the workers
+			gJobs.pumpMainThread();
+
+			//Swap in assets edited since the last frame
+			gHotReload.update();
 
 			//Clear the window
-			SDL_RenderClear(renderer);
+			clearFrame(renderer);
 
 			int iW2, iH2;
-			SDL_QueryTexture(gameOverImage, NULL, NULL, &iW2, &iH2);
+			gTextureCache.querySize(gameOverImage, &iW2, &iH2);
 			int x2 = SCREEN_WIDTH / 2 - iW2 / 2;
 			int y2 = SCREEN_HEIGHT / 2 - iH2 / 2;
 			renderTexture(gameOverImage, renderer, x2, y2);
 
 			//Update the screen
-			SDL_RenderPresent(renderer);
+			presentFrame(renderer);
 			while (SDL_PollEvent(&e))
 			{
+				handleWindowEvent(e, renderer);
 				if (e.type == SDL_QUIT)
 				{
 					gameEnd = true;
@@ -1096,37 +1541,36 @@ int main(int argc, char** argv)
 					{
 						gameEnd = true;
 						allGame = false;
-						//Stop the music
-						Mix_HaltMusic();
-						Mix_FreeMusic(gMusicEnd);
-						gMusicEnd = NULL;
-
 					}
 					else if (e.key.keysym.sym == SDLK_n)
 					{
 						gameEnd = true;
 						allGame = true;
-						Mix_HaltMusic();
-						Mix_FreeMusic(gMusicEnd);
-						gMusicEnd = NULL;
 					}
 					else if (e.key.keysym.sym == SDLK_m)
 					{
-						Mix_PlayMusic(gMusicEnd, -1);
+						gMusic.play(musicEnd);
 					}
 					else if (e.key.keysym.sym == SDLK_0)
 					{
-						Mix_HaltMusic();
+						gMusic.pause();
 					}
 
 				}
 			}
 		}
 
-
+		//Back to the outer loop, drop everything the round allocated
+		endRound();
 	}
 
 
+	//Stop reloading before the assets are freed
+	gHotReload.stop();
+
+	//Finish outstanding jobs before the renderer goes away
+	gJobs.shutdown();
+
 	//Destroy the various items
 	SDL_DestroyTexture(background);
 	SDL_DestroyTexture(image);
@@ -1137,6 +1581,9 @@ int main(int argc, char** argv)
 	SDL_DestroyTexture(gameOverImage);
 	SDL_DestroyTexture(redTileImage);
 	SDL_DestroyTexture(rockImage);
+	gTextureCache.free();
+	gCompositor.free();
+	gHud.free();
 
 	//Free the sound effects
 	Mix_FreeChunk(gCroak);
@@ -1149,6 +1596,10 @@ int main(int argc, char** argv)
 	gLaugh = NULL;
 
 	//Free the music
+	gMusic.stop();
+
+	//Close the audio device
+	gAudio.close();
 
 
 
@@ -1156,6 +1607,7 @@ int main(int argc, char** argv)
 
 
 	//Quit SDL subsystems
+	TTF_Quit();
 	Mix_Quit();
 	IMG_Quit();
 	SDL_Quit();
@@ -1166,7 +1618,7 @@ int main(int argc, char** argv)
 	IMG_Quit();
 	SDL_Quit();
 
-	return 0;
+	return exitCode;
 
 	//system("PAUSE");
 }
@@ -0,0 +1,545 @@
+#include "music.h"
+#include <string.h>
+#include "alloctrack.h"
+
+MusicStreamer gMusic;
+
+//smpeg, the MP3 decoder SDL_mixer ships with, loaded at runtime the way
+//SDL_mixer loads it; its SMPEG handles are opaque here
+struct SmpegLibrary
+{
+	void *object;
+	void *(SDLCALL *newRWops)(SDL_RWops *src, void *info, int freesrc, int sdlAudio);
+	void (SDLCALL *actualSpec)(void *mpeg, SDL_AudioSpec *spec);
+	void (SDLCALL *enableAudio)(void *mpeg, int enable);
+	void (SDLCALL *enableVideo)(void *mpeg, int enable);
+	void (SDLCALL *play)(void *mpeg);
+	int (SDLCALL *playAudio)(void *mpeg, Uint8 *stream, int len);
+	int (SDLCALL *status)(void *mpeg);
+	void (SDLCALL *destroy)(void *mpeg);
+};
+
+static SmpegLibrary gSmpeg;
+
+//SMPEG_status while there is audio left to decode
+static const int SMPEG_PLAYING = 1;
+
+#if defined(_WIN32)
+static const char *SMPEG_OBJECT = "smpeg2.dll";
+#elif defined(__APPLE__)
+static const char *SMPEG_OBJECT = "smpeg2.framework/smpeg2";
+#else
+static const char *SMPEG_OBJECT = "libsmpeg2-2.0.so.0";
+#endif
+
+/**
+* Looks up a function of the loaded decoder
+* @param name The function's name
+* @param function Where the function goes; left NULL if it's missing
+* @return true if the function was found
+*/
+template <typename Function>
+static bool loadSmpegFunction(const char *name, Function &function)
+{
+	function = reinterpret_cast<Function>(SDL_LoadFunction(gSmpeg.object, name));
+	return function != NULL;
+}
+
+/**
+* Loads smpeg for decoding MP3 tracks up front; without it they fall back to
+* SDL_mixer's own streaming
+* @return true if every function the decoder needs was found
+*/
+static bool loadSmpeg()
+{
+	if (gSmpeg.object != NULL)
+	{
+		return true;
+	}
+	gSmpeg.object = SDL_LoadObject(SMPEG_OBJECT);
+	if (gSmpeg.object == NULL)
+	{
+		return false;
+	}
+	if (loadSmpegFunction("SMPEG_new_rwops", gSmpeg.newRWops) && loadSmpegFunction("SMPEG_actualSpec", gSmpeg.actualSpec) &&
+		loadSmpegFunction("SMPEG_enableaudio", gSmpeg.enableAudio) && loadSmpegFunction("SMPEG_enablevideo", gSmpeg.enableVideo) &&
+		loadSmpegFunction("SMPEG_play", gSmpeg.play) && loadSmpegFunction("SMPEG_playAudio", gSmpeg.playAudio) &&
+		loadSmpegFunction("SMPEG_status", gSmpeg.status) && loadSmpegFunction("SMPEG_delete", gSmpeg.destroy))
+	{
+		return true;
+	}
+	SDL_UnloadObject(gSmpeg.object);
+	gSmpeg.object = NULL;
+	return false;
+}
+
+/**
+* Unloads smpeg once no decode can be running
+*/
+static void unloadSmpeg()
+{
+	if (gSmpeg.object != NULL)
+	{
+		SDL_UnloadObject(gSmpeg.object);
+		gSmpeg.object = NULL;
+	}
+}
+
+/**
+* Decodes a whole MP3 file to PCM in the mixer's format; safe to call off the main thread
+* @param file The MP3 file
+* @return a chunk Mix_FreeChunk can free, or nullptr if smpeg isn't loaded or the file doesn't decode
+*/
+static Mix_Chunk *decodeMp3(const char *file)
+{
+	if (gSmpeg.object == NULL)
+	{
+		return NULL;
+	}
+	SDL_RWops *src = SDL_RWFromFile(file, "rb");
+	if (src == NULL)
+	{
+		return NULL;
+	}
+
+	//SMPEG_Info is filled in but never read, this is more than big enough for it
+	double info[64];
+	void *mpeg = gSmpeg.newRWops(src, info, 1, 0);
+	if (mpeg == NULL)
+	{
+		return NULL;
+	}
+
+	//smpeg converts to whatever spec it is told the device has
+	int frequency = 0;
+	Uint16 format = 0;
+	int channels = 0;
+	Mix_QuerySpec(&frequency, &format, &channels);
+	SDL_AudioSpec spec;
+	SDL_zero(spec);
+	spec.freq = frequency;
+	spec.format = format;
+	spec.channels = static_cast<Uint8>(channels);
+	gSmpeg.actualSpec(mpeg, &spec);
+	gSmpeg.enableAudio(mpeg, 1);
+	gSmpeg.enableVideo(mpeg, 0);
+	gSmpeg.play(mpeg);
+
+	//Pull PCM until the stream ends, doubling the buffer as it fills;
+	//smpeg mixes into what is there, so each block starts as silence
+	Uint32 length = 0;
+	Uint32 capacity = 1 << 20;
+	Uint8 *pcm = static_cast<Uint8 *>(SDL_malloc(capacity));
+	while (pcm != NULL && gSmpeg.status(mpeg) == SMPEG_PLAYING)
+	{
+		if (capacity - length < 4096)
+		{
+			Uint8 *grown = static_cast<Uint8 *>(SDL_realloc(pcm, capacity * 2));
+			if (grown == NULL)
+			{
+				SDL_free(pcm);
+				pcm = NULL;
+				break;
+			}
+			pcm = grown;
+			capacity *= 2;
+		}
+		memset(pcm + length, 0, 4096);
+		length += gSmpeg.playAudio(mpeg, pcm + length, 4096);
+	}
+	gSmpeg.destroy(mpeg);
+
+	//Whole frames only, readFrame steps through them four bytes at a time
+	length &= ~3u;
+	if (pcm == NULL || length == 0)
+	{
+		SDL_free(pcm);
+		return NULL;
+	}
+	Mix_Chunk *chunk = static_cast<Mix_Chunk *>(SDL_malloc(sizeof(Mix_Chunk)));
+	if (chunk == NULL)
+	{
+		SDL_free(pcm);
+		return NULL;
+	}
+	chunk->allocated = 1;
+	chunk->abuf = pcm;
+	chunk->alen = length;
+	chunk->volume = MIX_MAX_VOLUME;
+	return chunk;
+}
+
+MusicStreamer::MusicStreamer()
+{
+	//Initialize
+	mStarted = false;
+	mTimer = 0;
+	mFadeFrames = 0;
+	mReadFrame = 0;
+	mWriteFrame = 0;
+	mUnderruns = 0;
+	mPaused = false;
+	mStopping = false;
+	mInTimer = 0;
+	mRequest = 0;
+	mCurrent.chunk = NULL;
+	mCurrent.frame = 0;
+	mNext.chunk = NULL;
+	mNext.frame = 0;
+	mFadePos = 0;
+	mFading = false;
+	mFallback = NULL;
+}
+
+MusicStreamer::~MusicStreamer()
+{
+	//Deallocate
+	stop();
+}
+
+bool MusicStreamer::start()
+{
+	if (mStarted)
+	{
+		return true;
+	}
+
+	int frequency = 0;
+	Uint16 format = 0;
+	int channels = 0;
+	if (Mix_QuerySpec(&frequency, &format, &channels) == 0 || format != AUDIO_S16SYS || channels != 2)
+	{
+		return false;
+	}
+
+	//MP3 tracks are decoded to PCM too when smpeg is there
+	loadSmpeg();
+	mFadeFrames = frequency * MUSIC_CROSSFADE_MS / 1000;
+	mRing.assign(MUSIC_RING_FRAMES, 0);
+	mReadFrame = 0;
+	mWriteFrame = 0;
+	mUnderruns = 0;
+	mPaused = false;
+	mStopping = false;
+
+	//Have something in the ring before the mixer asks for it
+	fill();
+	Mix_HookMusic(mixMusic, this);
+	mTimer = SDL_AddTimer(MUSIC_FILL_INTERVAL_MS, fillTimer, this);
+	mStarted = true;
+	return true;
+}
+
+void MusicStreamer::stop()
+{
+	if (!mStarted)
+	{
+		return;
+	}
+
+	//Let a decode in flight land before tearing down
+	if (mDecodeJob)
+	{
+		gJobs.wait(mDecodeJob);
+		mDecodeJob.reset();
+	}
+
+	mStopping = true;
+	SDL_RemoveTimer(mTimer);
+	while (mInTimer > 0)
+	{
+		SDL_Delay(1);
+	}
+	mTimer = 0;
+
+	Mix_HookMusic(NULL, NULL);
+	if (mFallback != NULL)
+	{
+		Mix_FreeMusic(mFallback);
+		mFallback = NULL;
+	}
+	freeChunk(mCurrent.chunk);
+	freeChunk(mNext.chunk);
+	mCurrent.chunk = NULL;
+	mNext.chunk = NULL;
+	mFading = false;
+	mRequestedFile.clear();
+	unloadSmpeg();
+	mStarted = false;
+}
+
+void MusicStreamer::play(const char *file)
+{
+	AllocScope scope(ALLOC_AUDIO);
+	if (!mStarted)
+	{
+		return;
+	}
+	resume();
+	if (file == NULL || mRequestedFile == file)
+	{
+		return;
+	}
+
+	mRequestedFile = file;
+	unsigned request = ++mRequest;
+	std::string name = file;
+
+	//Without workers the job would wait for the next gJobs.wait, decode here
+	if (gJobs.getWorkerCount() == 0)
+	{
+		decode(name, request);
+		return;
+	}
+	mDecodeJob = gJobs.run([this, name, request]()
+	{
+		decode(name, request);
+	});
+}
+
+void MusicStreamer::fadeOut()
+{
+	if (!mStarted)
+	{
+		return;
+	}
+	mRequestedFile.clear();
+	++mRequest;
+
+	std::lock_guard<std::mutex> guard(mLock);
+	if (mFallback != NULL)
+	{
+		Mix_FadeOutMusic(MUSIC_CROSSFADE_MS);
+	}
+
+	//Fading into nothing is a crossfade with an empty track
+	freeChunk(mNext.chunk);
+	mNext.chunk = NULL;
+	mNext.frame = 0;
+	mFadePos = 0;
+	mFading = mCurrent.chunk != NULL;
+}
+
+void MusicStreamer::pause()
+{
+	mPaused = true;
+	if (mFallback != NULL)
+	{
+		Mix_PauseMusic();
+	}
+}
+
+void MusicStreamer::resume()
+{
+	mPaused = false;
+	if (mFallback != NULL)
+	{
+		Mix_ResumeMusic();
+	}
+}
+
+unsigned MusicStreamer::getUnderruns()
+{
+	return mUnderruns;
+}
+
+void MusicStreamer::mixMusic(void *udata, Uint8 *stream, int len)
+{
+	MusicStreamer *music = static_cast<MusicStreamer *>(udata);
+	int frames = len / 4;
+	if (music->mPaused)
+	{
+		memset(stream, 0, len);
+		return;
+	}
+
+	//Just a copy out of the ring, whatever the tracks are doing
+	unsigned read = music->mReadFrame.load(std::memory_order_relaxed);
+	unsigned available = music->mWriteFrame.load(std::memory_order_acquire) - read;
+	int count = static_cast<int>(available) < frames ? static_cast<int>(available) : frames;
+	int done = 0;
+	while (done < count)
+	{
+		int index = (read + done) & (MUSIC_RING_FRAMES - 1);
+		int run = MUSIC_RING_FRAMES - index;
+		if (run > count - done)
+		{
+			run = count - done;
+		}
+		memcpy(stream + done * 4, &music->mRing[index], run * 4);
+		done += run;
+	}
+	music->mReadFrame.store(read + count, std::memory_order_release);
+
+	if (count < frames)
+	{
+		memset(stream + count * 4, 0, (frames - count) * 4);
+		music->mUnderruns++;
+	}
+}
+
+Uint32 MusicStreamer::fillTimer(Uint32 interval, void *param)
+{
+	MusicStreamer *music = static_cast<MusicStreamer *>(param);
+	music->mInTimer++;
+	if (!music->mStopping)
+	{
+		music->fill();
+	}
+	music->mInTimer--;
+	return interval;
+}
+
+void MusicStreamer::fill()
+{
+	AllocScope scope(ALLOC_AUDIO);
+	std::vector<Mix_Chunk *> finished;
+	{
+		std::lock_guard<std::mutex> guard(mLock);
+		unsigned write = mWriteFrame.load(std::memory_order_relaxed);
+		unsigned space = MUSIC_RING_FRAMES - (write - mReadFrame.load(std::memory_order_acquire));
+
+		for (unsigned i = 0; i < space; i++)
+		{
+			//A missing track reads as silence, so fading in and out are crossfades too
+			int left = 0;
+			int right = 0;
+			readFrame(mCurrent, left, right);
+			if (mFading)
+			{
+				int inLeft = 0;
+				int inRight = 0;
+				readFrame(mNext, inLeft, inRight);
+				int gain = static_cast<int>((static_cast<long long>(mFadePos) << 16) / mFadeFrames);
+				left = (left * (65536 - gain) + inLeft * gain) >> 16;
+				right = (right * (65536 - gain) + inRight * gain) >> 16;
+
+				if (++mFadePos >= mFadeFrames)
+				{
+					if (mCurrent.chunk != NULL)
+					{
+						finished.push_back(mCurrent.chunk);
+					}
+					mCurrent = mNext;
+					mNext.chunk = NULL;
+					mNext.frame = 0;
+					mFading = false;
+				}
+			}
+
+			Sint16 frame[2] = { static_cast<Sint16>(left), static_cast<Sint16>(right) };
+			memcpy(&mRing[(write + i) & (MUSIC_RING_FRAMES - 1)], frame, 4);
+		}
+		mWriteFrame.store(write + space, std::memory_order_release);
+	}
+
+	//Freeing takes the audio lock, do it after letting go of ours
+	for (size_t i = 0; i < finished.size(); i++)
+	{
+		freeChunk(finished[i]);
+	}
+}
+
+bool MusicStreamer::readFrame(Track &track, int &left, int &right)
+{
+	if (track.chunk == NULL)
+	{
+		return false;
+	}
+
+	Uint32 frames = track.chunk->alen / 4;
+	if (frames == 0)
+	{
+		return false;
+	}
+
+	//Music loops seamlessly
+	if (track.frame >= frames)
+	{
+		track.frame = 0;
+	}
+	Sint16 frame[2];
+	memcpy(frame, track.chunk->abuf + track.frame * 4, 4);
+	left = frame[0];
+	right = frame[1];
+	track.frame++;
+	return true;
+}
+
+void MusicStreamer::decode(const std::string &file, unsigned request)
+{
+	AllocScope scope(ALLOC_AUDIO);
+	//Decoded and converted to the device format in one go; SDL_mixer
+	//doesn't load MP3 as a chunk, so those go through smpeg here
+	Mix_Chunk *chunk = Mix_LoadWAV(file.c_str());
+	if (chunk == NULL)
+	{
+		chunk = decodeMp3(file.c_str());
+	}
+	Mix_Music *music = NULL;
+	if (chunk == NULL)
+	{
+		//Without smpeg SDL_mixer can still stream the track itself
+		music = Mix_LoadMUS(file.c_str());
+		if (music == NULL)
+		{
+			printf("Failed to load beat music! SDL_mixer Error: %s\n", Mix_GetError());
+		}
+	}
+
+	std::lock_guard<std::mutex> guard(mLock);
+	if (request != mRequest)
+	{
+		freeChunk(chunk);
+		if (music != NULL)
+		{
+			Mix_FreeMusic(music);
+		}
+		return;
+	}
+
+	if (chunk != NULL)
+	{
+		if (mFallback != NULL)
+		{
+			Mix_FreeMusic(mFallback);
+			mFallback = NULL;
+			Mix_HookMusic(mixMusic, this);
+		}
+
+		//A crossfade already running hands over to the newest track
+		freeChunk(mNext.chunk);
+		mNext.chunk = chunk;
+		mNext.frame = 0;
+		mFadePos = 0;
+		mFading = true;
+	}
+	else if (music != NULL)
+	{
+		freeChunk(mCurrent.chunk);
+		freeChunk(mNext.chunk);
+		mCurrent.chunk = NULL;
+		mNext.chunk = NULL;
+		mFading = false;
+
+		Mix_HookMusic(NULL, NULL);
+		if (mFallback != NULL)
+		{
+			Mix_FreeMusic(mFallback);
+		}
+		mFallback = music;
+		Mix_FadeInMusic(mFallback, -1, MUSIC_CROSSFADE_MS);
+		if (mPaused)
+		{
+			Mix_PauseMusic();
+		}
+	}
+}
+
+void MusicStreamer::freeChunk(Mix_Chunk *chunk)
+{
+	if (chunk != NULL)
+	{
+		Mix_FreeChunk(chunk);
+	}
+}
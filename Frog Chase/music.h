@@ -0,0 +1,112 @@
+#pragma once
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "audio.h"
+#include "jobs.h"
+
+/*
+* Streams the background music through a lock-free ring buffer. Tracks are
+* decoded on the job system, a timer thread mixes the playing track and the
+* crossfade into the ring a little ahead, and the mixer callback only copies
+* out of the ring, so a phase change never stalls the main thread or the
+* audio thread.
+*/
+
+//Frames the ring holds, about 186 ms at 44.1 kHz
+const int MUSIC_RING_FRAMES = 8192;
+
+//How often the timer tops the ring up
+const int MUSIC_FILL_INTERVAL_MS = 10;
+
+//Length of the crossfade between two tracks
+const int MUSIC_CROSSFADE_MS = 750;
+
+class MusicStreamer
+{
+public:
+	//Initializes variables
+	MusicStreamer();
+
+	//Deallocates memory
+	~MusicStreamer();
+
+	//Hooks the streamer into the open mixer, false if the format isn't 16 bit stereo
+	bool start();
+
+	//Unhooks the streamer and frees every track
+	void stop();
+
+	//Crossfades to a looping track; asking for the current one only resumes it
+	void play(const char *file);
+
+	//Fades the current track out to silence
+	void fadeOut();
+
+	//Holds the music where it is
+	void pause();
+
+	//Carries on after pause
+	void resume();
+
+	//Times the mixer callback found the ring empty
+	unsigned getUnderruns();
+
+private:
+	struct Track
+	{
+		Mix_Chunk *chunk;
+		Uint32 frame;
+	};
+
+	//Mixer music hook, runs on the audio thread
+	static void mixMusic(void *udata, Uint8 *stream, int len);
+
+	//SDL timer callback that keeps the ring topped up
+	static Uint32 fillTimer(Uint32 interval, void *param);
+
+	//Mixes tracks into the free part of the ring
+	void fill();
+
+	//Reads the next frame of a looping track, false if there is no track
+	bool readFrame(Track &track, int &left, int &right);
+
+	//Loads a track and starts the crossfade if it is still wanted
+	void decode(const std::string &file, unsigned request);
+
+	//Frees a chunk that was decoded for the streamer
+	void freeChunk(Mix_Chunk *chunk);
+
+	bool mStarted;
+	SDL_TimerID mTimer;
+	int mFadeFrames;
+
+	//Ring of interleaved 16 bit stereo frames, one writer and one reader
+	std::vector<Uint32> mRing;
+	std::atomic<unsigned> mReadFrame;
+	std::atomic<unsigned> mWriteFrame;
+	std::atomic<unsigned> mUnderruns;
+	std::atomic<bool> mPaused;
+
+	//Set while the timer callback runs, so stop can wait for it
+	std::atomic<bool> mStopping;
+	std::atomic<int> mInTimer;
+
+	//Latest play request; decodes for older ones are thrown away
+	std::atomic<unsigned> mRequest;
+	std::string mRequestedFile;
+	JobHandle mDecodeJob;
+
+	//Tracks being mixed, guarded by mLock
+	std::mutex mLock;
+	Track mCurrent;
+	Track mNext;
+	bool mFading;
+	int mFadePos;
+
+	//Track SDL_mixer plays itself when it can't be decoded up front
+	Mix_Music *mFallback;
+};
+
+extern MusicStreamer gMusic;
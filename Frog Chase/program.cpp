@@ -0,0 +1,559 @@
+#include "program.h"
+#include <ctype.h>
+#include <string.h>
+#if defined(_MSC_VER)
+#include <SDL.h>
+#else
+#include <SDL2/SDL.h>
+#endif
+
+//Longest program, so every skip fits in 16 bits
+static const size_t PROGRAM_MAX_CODE = 65535;
+
+static const char *DIRECTION_WORDS[] = { "up", "down", "left", "right" };
+static const char *DIRECTION_ARROWS[] = { "^", "v", "<", ">" };
+
+static bool tokenDirection(const char *token, Command &command)
+{
+	for (int i = 0; i < 4; i++)
+	{
+		if (strcmp(token, DIRECTION_WORDS[i]) == 0 || strcmp(token, DIRECTION_ARROWS[i]) == 0)
+		{
+			command = static_cast<Command>(i);
+			return true;
+		}
+	}
+	return false;
+}
+
+static unsigned read16(const unsigned char *code)
+{
+	return code[0] | code[1] << 8;
+}
+
+MoveBoard::MoveBoard()
+{
+	clear();
+}
+
+void MoveBoard::clear()
+{
+	for (int row = 0; row < BOARD_ROWS; row++)
+	{
+		mRows[row] = 0;
+	}
+}
+
+void MoveBoard::block(int col, int row)
+{
+	if (col >= 0 && col < BOARD_COLS && row >= 0 && row < BOARD_ROWS)
+	{
+		mRows[row] |= static_cast<unsigned short>(1u << col);
+	}
+}
+
+void MoveBoard::unblock(int col, int row)
+{
+	if (col >= 0 && col < BOARD_COLS && row >= 0 && row < BOARD_ROWS)
+	{
+		mRows[row] &= static_cast<unsigned short>(~(1u << col));
+	}
+}
+
+bool MoveBoard::isBlocked(int col, int row) const
+{
+	if (col < 0 || col >= FROG_COLS || row < 0 || row >= FROG_ROWS)
+	{
+		return true;
+	}
+	return (mRows[row] >> col & 1u) != 0;
+}
+
+Program::Program()
+{
+	//Initialize
+	mCode.push_back(OP_END);
+	mError[0] = 0;
+	mSource = NULL;
+	mLine = 1;
+	mToken[0] = 0;
+}
+
+bool Program::compile(const char *source)
+{
+	mCode.clear();
+	mError[0] = 0;
+	mSource = source;
+	mLine = 1;
+
+	bool compiled = parseBlock(0);
+	if (compiled && nextToken())
+	{
+		compiled = fail("} without a matching {");
+	}
+	if (compiled && mCode.size() >= PROGRAM_MAX_CODE)
+	{
+		compiled = fail("program is too long");
+	}
+
+	//A failed program does nothing
+	if (!compiled)
+	{
+		mCode.clear();
+	}
+	emit(OP_END);
+	mSource = NULL;
+	return compiled;
+}
+
+void Program::compile(const CommandRing &commands)
+{
+	mCode.clear();
+	mError[0] = 0;
+	for (unsigned i = 0; i < commands.size(); i++)
+	{
+		emit(commands.peek(i));
+	}
+	emit(OP_END);
+}
+
+const char *Program::getError() const
+{
+	return mError;
+}
+
+const std::vector<unsigned char> &Program::getCode() const
+{
+	return mCode;
+}
+
+ProgramResult Program::run(const MoveBoard &board, int col, int row, unsigned budget, CommandRing *trace) const
+{
+	ProgramResult result;
+	result.status = PROGRAM_FINISHED;
+	result.moves = 0;
+	result.blockedMoves = 0;
+
+	const unsigned char *code = &mCode[0];
+	size_t pc = 0;
+	unsigned steps = 0;
+	unsigned counters[PROGRAM_MAX_DEPTH];
+	int depth = 0;
+	bool running = true;
+
+	while (running)
+	{
+		if (steps == budget)
+		{
+			result.status = PROGRAM_OUT_OF_STEPS;
+			break;
+		}
+		steps++;
+
+		unsigned char op = code[pc++];
+		switch (op)
+		{
+		case OP_UP:
+		case OP_DOWN:
+		case OP_LEFT:
+		case OP_RIGHT:
+		{
+			//Sprite::move undoes a move into a rock or off the board
+			int nextCol = col + COMMAND_DX[op];
+			int nextRow = row + COMMAND_DY[op];
+			result.moves++;
+			if (board.isBlocked(nextCol, nextRow))
+			{
+				result.blockedMoves++;
+			}
+			else
+			{
+				col = nextCol;
+				row = nextRow;
+			}
+			if (trace != NULL)
+			{
+				trace->push(static_cast<Command>(op));
+			}
+			break;
+		}
+
+		case OP_REPEAT:
+			//The compiler keeps nesting under PROGRAM_MAX_DEPTH, counted moves included
+			SDL_assert(depth < PROGRAM_MAX_DEPTH);
+			if (depth >= PROGRAM_MAX_DEPTH)
+			{
+				running = false;
+				break;
+			}
+			counters[depth++] = read16(code + pc);
+			pc += 2;
+			break;
+
+		case OP_LOOP:
+		{
+			unsigned back = read16(code + pc);
+			pc += 2;
+			if (--counters[depth - 1] > 0)
+			{
+				pc -= back;
+			}
+			else
+			{
+				depth--;
+			}
+			break;
+		}
+
+		case OP_IF_BLOCKED:
+		case OP_IF_FREE:
+		{
+			int direction = code[pc];
+			unsigned skip = read16(code + pc + 1);
+			pc += 3;
+			bool blocked = board.isBlocked(col + COMMAND_DX[direction], row + COMMAND_DY[direction]);
+			if (blocked != (op == OP_IF_BLOCKED))
+			{
+				pc += skip;
+			}
+			break;
+		}
+
+		case OP_JUMP:
+			pc += 2 + read16(code + pc);
+			break;
+
+		default:
+			running = false;
+			break;
+		}
+	}
+
+	result.steps = steps;
+	result.col = col;
+	result.row = row;
+	return result;
+}
+
+ProgramResult planMoves(const CommandRing &commands, const MoveBoard &board, int col, int row, std::vector<MoveRun> &runs)
+{
+	ProgramResult result;
+	result.status = PROGRAM_FINISHED;
+	result.steps = commands.size();
+	result.moves = commands.size();
+	result.blockedMoves = 0;
+	runs.clear();
+
+	for (unsigned i = 0; i < commands.size(); i++)
+	{
+		Command command = commands.peek(i);
+		int nextCol = col + COMMAND_DX[command];
+		int nextRow = row + COMMAND_DY[command];
+		if (board.isBlocked(nextCol, nextRow))
+		{
+			result.blockedMoves++;
+			continue;
+		}
+		col = nextCol;
+		row = nextRow;
+
+		//A dropped move between two runs the same way joins them
+		if (!runs.empty() && runs.back().command == command)
+		{
+			runs.back().count++;
+		}
+		else
+		{
+			MoveRun run = { command, 1 };
+			runs.push_back(run);
+		}
+	}
+
+	result.col = col;
+	result.row = row;
+	return result;
+}
+
+bool Program::parseBlock(int depth)
+{
+	for (;;)
+	{
+		const char *start = mSource;
+		int line = mLine;
+		if (!nextToken())
+		{
+			return true;
+		}
+		if (strcmp(mToken, "}") == 0)
+		{
+			//The caller closes the block
+			mSource = start;
+			mLine = line;
+			return true;
+		}
+		if (depth >= PROGRAM_MAX_DEPTH && (strcmp(mToken, "repeat") == 0 || strcmp(mToken, "if") == 0))
+		{
+			return fail("blocks are nested too deeply");
+		}
+
+		Command command;
+		if (strcmp(mToken, "repeat") == 0)
+		{
+			int count;
+			if (!parseCount(count))
+			{
+				return false;
+			}
+			size_t begin = mCode.size();
+			emit(OP_REPEAT);
+			emit16(count);
+			size_t body = mCode.size();
+			if (!parseBraces(depth + 1))
+			{
+				return false;
+			}
+
+			//Nothing to run, or nothing to repeat
+			if (count == 0 || mCode.size() == body)
+			{
+				mCode.resize(begin);
+				continue;
+			}
+			emit(OP_LOOP);
+			emit16(static_cast<int>(mCode.size() + 2 - body));
+		}
+		else if (strcmp(mToken, "if") == 0)
+		{
+			int op;
+			if (!nextToken())
+			{
+				return fail("expected blocked or free after if");
+			}
+			if (strcmp(mToken, "blocked") == 0)
+			{
+				op = OP_IF_BLOCKED;
+			}
+			else if (strcmp(mToken, "free") == 0)
+			{
+				op = OP_IF_FREE;
+			}
+			else
+			{
+				return fail("expected blocked or free after if");
+			}
+			if (!nextToken() || !tokenDirection(mToken, command))
+			{
+				return fail("expected a direction");
+			}
+
+			emit(op);
+			emit(command);
+			size_t skip = mCode.size();
+			emit16(0);
+			if (!parseBraces(depth + 1))
+			{
+				return false;
+			}
+
+			start = mSource;
+			line = mLine;
+			if (nextToken() && strcmp(mToken, "else") == 0)
+			{
+				emit(OP_JUMP);
+				size_t end = mCode.size();
+				emit16(0);
+				patch(skip);
+				if (!parseBraces(depth + 1))
+				{
+					return false;
+				}
+				patch(end);
+			}
+			else
+			{
+				mSource = start;
+				mLine = line;
+				patch(skip);
+			}
+		}
+		else if (tokenDirection(mToken, command))
+		{
+			//An optional count repeats the move
+			int count = 1;
+			start = mSource;
+			line = mLine;
+			if (nextToken() && isdigit(static_cast<unsigned char>(mToken[0])))
+			{
+				mSource = start;
+				mLine = line;
+				if (!parseCount(count))
+				{
+					return false;
+				}
+			}
+			else
+			{
+				mSource = start;
+				mLine = line;
+			}
+
+			if (count == 1)
+			{
+				emit(command);
+			}
+			else if (count > 1)
+			{
+				//A counted move is a repeat block too and needs a counter of its own
+				if (depth >= PROGRAM_MAX_DEPTH)
+				{
+					return fail("blocks are nested too deeply");
+				}
+				emit(OP_REPEAT);
+				emit16(count);
+				emit(command);
+				emit(OP_LOOP);
+				emit16(4);
+			}
+		}
+		else
+		{
+			char message[64];
+			SDL_snprintf(message, sizeof(message), "unknown command '%s'", mToken);
+			return fail(message);
+		}
+
+		if (mCode.size() >= PROGRAM_MAX_CODE)
+		{
+			return fail("program is too long");
+		}
+	}
+}
+
+bool Program::parseBraces(int depth)
+{
+	if (!nextToken() || strcmp(mToken, "{") != 0)
+	{
+		return fail("expected {");
+	}
+	if (!parseBlock(depth))
+	{
+		return false;
+	}
+	if (!nextToken() || strcmp(mToken, "}") != 0)
+	{
+		return fail("expected }");
+	}
+	return true;
+}
+
+bool Program::nextToken()
+{
+	mToken[0] = 0;
+
+	//Skip spaces, separators and comments
+	for (;;)
+	{
+		char c = *mSource;
+		if (c == '\n')
+		{
+			mLine++;
+		}
+		if (c == '#')
+		{
+			while (*mSource != 0 && *mSource != '\n')
+			{
+				mSource++;
+			}
+		}
+		else if (c != 0 && (isspace(static_cast<unsigned char>(c)) || c == ';' || c == ','))
+		{
+			mSource++;
+		}
+		else
+		{
+			break;
+		}
+	}
+	if (*mSource == 0)
+	{
+		return false;
+	}
+
+	//Words and numbers run together, anything else is one character. No
+	//word starts with v, so a v is always the down arrow: vvv or v2 read
+	//like ^^^ and ^2
+	size_t length = 0;
+	if (*mSource == 'v' || *mSource == 'V')
+	{
+		mToken[length++] = 'v';
+		mSource++;
+	}
+	else
+	{
+		while (isalnum(static_cast<unsigned char>(*mSource)))
+		{
+			if (length + 1 < sizeof(mToken))
+			{
+				mToken[length++] = static_cast<char>(tolower(static_cast<unsigned char>(*mSource)));
+			}
+			mSource++;
+		}
+	}
+	if (length == 0)
+	{
+		mToken[length++] = *mSource++;
+	}
+	mToken[length] = 0;
+	return true;
+}
+
+bool Program::parseCount(int &count)
+{
+	if (!nextToken() || !isdigit(static_cast<unsigned char>(mToken[0])))
+	{
+		return fail("expected a number");
+	}
+	long value = 0;
+	for (const char *c = mToken; *c != 0; c++)
+	{
+		if (!isdigit(static_cast<unsigned char>(*c)))
+		{
+			return fail("expected a number");
+		}
+		value = value * 10 + (*c - '0');
+		if (value > PROGRAM_MAX_REPEAT)
+		{
+			return fail("count is too large");
+		}
+	}
+	count = static_cast<int>(value);
+	return true;
+}
+
+bool Program::fail(const char *message)
+{
+	//Keep the first error, later ones are knock-on failures
+	if (mError[0] == 0)
+	{
+		SDL_snprintf(mError, sizeof(mError), "line %d: %s", mLine, message);
+	}
+	return false;
+}
+
+void Program::emit(int byte)
+{
+	mCode.push_back(static_cast<unsigned char>(byte));
+}
+
+void Program::emit16(int value)
+{
+	emit(value & 0xFF);
+	emit(value >> 8 & 0xFF);
+}
+
+void Program::patch(size_t offset)
+{
+	size_t skip = mCode.size() - (offset + 2);
+	mCode[offset] = static_cast<unsigned char>(skip & 0xFF);
+	mCode[offset + 1] = static_cast<unsigned char>(skip >> 8 & 0xFF);
+}
@@ -0,0 +1,173 @@
+#pragma once
+#include <stddef.h>
+#include <vector>
+#include "board.h"
+#include "commandring.h"
+
+/*
+* Command programs for the frog. Source text with arrows, repeat blocks and
+* "if blocked" tests compiles to compact bytecode, which a small interpreter
+* runs against a headless copy of the board, so a program can be checked and
+* previewed in microseconds before any of it is animated.
+*
+*   # Comments run to the end of the line
+*   right 2
+*   repeat 3 { down  if blocked right { left } else { right } }
+*
+* Arrows may also be written ^ v < >.
+*/
+
+//Instructions a program may run before it is stopped
+const unsigned PROGRAM_STEP_BUDGET = 1 << 20;
+
+//Deepest nesting of repeat blocks
+const int PROGRAM_MAX_DEPTH = 16;
+
+//Largest repeat count
+const int PROGRAM_MAX_REPEAT = 65535;
+
+//Bytecode; the four moves share their values with Command
+enum Opcode
+{
+	OP_UP = COMMAND_UP,
+	OP_DOWN = COMMAND_DOWN,
+	OP_LEFT = COMMAND_LEFT,
+	OP_RIGHT = COMMAND_RIGHT,
+
+	//count16: runs the block that follows count times
+	OP_REPEAT,
+
+	//back16: closes a repeat block, jumping back while runs are left
+	OP_LOOP,
+
+	//direction, skip16: skips ahead unless that move is blocked
+	OP_IF_BLOCKED,
+
+	//direction, skip16: skips ahead if that move is blocked
+	OP_IF_FREE,
+
+	//skip16: skips ahead, used for else blocks
+	OP_JUMP,
+
+	OP_END
+};
+
+//Headless copy of the tiles the frog can't step onto
+class MoveBoard
+{
+public:
+	//Initializes an empty board
+	MoveBoard();
+
+	//Unblocks every tile
+	void clear();
+
+	//Stops the frog entering a tile
+	void block(int col, int row);
+
+	//Lets the frog enter a tile again
+	void unblock(int col, int row);
+
+	//True for blocked tiles and anywhere the frog can't stand
+	bool isBlocked(int col, int row) const;
+
+private:
+	unsigned short mRows[BOARD_ROWS];
+};
+
+enum ProgramStatus
+{
+	//Ran to the end
+	PROGRAM_FINISHED,
+
+	//Used up the step budget, most likely an endless loop
+	PROGRAM_OUT_OF_STEPS
+};
+
+struct ProgramResult
+{
+	ProgramStatus status;
+
+	//Instructions run
+	unsigned steps;
+
+	//Moves made, and how many of them a rock or the edge undid
+	unsigned moves;
+	unsigned blockedMoves;
+
+	//Where the frog ended up
+	int col;
+	int row;
+};
+
+class Program
+{
+public:
+	//Initializes an empty program
+	Program();
+
+	//Compiles source text; on a syntax error returns false and getError() says where
+	bool compile(const char *source);
+
+	//Compiles a flat list of queued commands
+	void compile(const CommandRing &commands);
+
+	//Description of the last compile error
+	const char *getError() const;
+
+	//The compiled bytecode
+	const std::vector<unsigned char> &getCode() const;
+
+	//Runs the program for the frog at col, row; every move made, blocked or not,
+	//is added to trace when there is one and it has room
+	ProgramResult run(const MoveBoard &board, int col, int row, unsigned budget = PROGRAM_STEP_BUDGET, CommandRing *trace = NULL) const;
+
+private:
+	//Compiles statements up to a closing brace or the end of the source
+	bool parseBlock(int depth);
+
+	//Compiles a { } block
+	bool parseBraces(int depth);
+
+	//Reads the next word or symbol into mToken
+	bool nextToken();
+
+	//Reads a whole number up to PROGRAM_MAX_REPEAT
+	bool parseCount(int &count);
+
+	//Records an error at the current line and fails
+	bool fail(const char *message);
+
+	void emit(int byte);
+	void emit16(int value);
+
+	//Fills in a skip16 written at offset to land on the end of the code
+	void patch(size_t offset);
+
+	std::vector<unsigned char> mCode;
+	char mError[128];
+
+	//Compile state
+	const char *mSource;
+	int mLine;
+	char mToken[32];
+};
+
+//A straight run of moves in one direction
+struct MoveRun
+{
+	Command command;
+	int count;
+};
+
+/**
+* Runs queued commands on the board before any are animated, dropping the moves
+* a rock or the edge would undo and merging the rest into straight runs
+* @param commands The queued commands
+* @param board The headless board
+* @param col The frog's column
+* @param row The frog's row
+* @param runs Cleared, then filled with the moves that change the frog's tile
+* @return what running the commands does
+*/
+ProgramResult planMoves(const CommandRing &commands, const MoveBoard &board, int col, int row, std::vector<MoveRun> &runs);
@@ -0,0 +1,290 @@
+#include "solver.h"
+#include <stdio.h>
+#include <stdlib.h>
+#if defined(_MSC_VER)
+#include <SDL.h>
+#else
+#include <SDL2/SDL.h>
+#endif
+#include "bitboard.h"
+#include "grader.h"
+#include "jobs.h"
+#include "zobrist.h"
+
+//Search results past any real cost
+static const int SOLVER_FOUND = -1;
+static const int SOLVER_NONE = 0xFFFF;
+
+static const char *POLICY_NAMES[] = { "always", "depth", "depth and age" };
+
+Solver::Solver(TranspositionTable &table)
+	: mTable(table)
+{
+	//Initialize
+	mBoard = NULL;
+	mLevel = NULL;
+	mRoot = 0;
+	mNodes = 0;
+	mCost = 0;
+}
+
+void Solver::prepare(const MoveBoard &board, const Level &level)
+{
+	mBoard = &board;
+	mLevel = &level;
+	mDoors.clear();
+	mHomes.clear();
+	for (int row = 0; row < FROG_ROWS; row++)
+	{
+		for (int col = 0; col < FROG_COLS; col++)
+		{
+			const CellTrigger &trigger = level.getTrigger(col, row);
+			if (trigger.action == TRIGGER_HOME)
+			{
+				mHomes.push_back(row * BOARD_COLS + col);
+			}
+			else if (trigger.action == TRIGGER_TELEPORT)
+			{
+				//A door is only worth taking to a tile the frog survives on
+				int action = level.getTrigger(trigger.targetCol, trigger.targetRow).action;
+				if ((action == TRIGGER_SAFE || action == TRIGGER_HOME) && !board.isBlocked(trigger.targetCol, trigger.targetRow))
+				{
+					Door door = { col, row, trigger.targetCol, trigger.targetRow };
+					mDoors.push_back(door);
+				}
+			}
+		}
+	}
+}
+
+int Solver::shortestCost(const MoveBoard &board, const Level &level, int col, int row)
+{
+	prepare(board, level);
+
+	FrogBitEngine engine;
+	for (int r = 0; r < FROG_ROWS; r++)
+	{
+		for (int c = 0; c < FROG_COLS; c++)
+		{
+			if (board.isBlocked(c, r))
+			{
+				engine.rocks.set(c, r);
+			}
+		}
+	}
+	for (size_t i = 0; i < mHomes.size(); i++)
+	{
+		engine.home.set(mHomes[i] % BOARD_COLS, mHomes[i] / BOARD_COLS);
+	}
+
+	//Each layer adds every tile one arrow or one door further away
+	FrogBitEngine::Bits reached;
+	reached.set(col, row);
+	reached = reached & engine.open();
+	for (int cost = 0; cost <= SOLVER_MAX_COST; cost++)
+	{
+		if ((reached & engine.home).any())
+		{
+			return cost;
+		}
+		FrogBitEngine::Bits next = reached;
+		for (int command = COMMAND_UP; command <= COMMAND_RIGHT; command++)
+		{
+			next = next | (engine.shift(reached, static_cast<Command>(command)) & engine.open());
+		}
+		for (size_t i = 0; i < mDoors.size(); i++)
+		{
+			if (reached.test(mDoors[i].col, mDoors[i].row))
+			{
+				next.set(mDoors[i].targetCol, mDoors[i].targetRow);
+			}
+		}
+		if (next == reached)
+		{
+			return -1;
+		}
+		reached = next;
+	}
+	return -1;
+}
+
+Solution Solver::solve(const MoveBoard &board, const Level &level, int col, int row)
+{
+	Solution solution;
+	solution.solved = false;
+	solution.cost = -1;
+	solution.nodes = 0;
+	solution.shortest = board.isBlocked(col, row) ? -1 : shortestCost(board, level, col, row);
+	if (solution.shortest < 0)
+	{
+		return solution;
+	}
+
+	//Costs depend on where the search starts, so the start is part of every key
+	unsigned long long start = gZobrist.frog(col, row);
+	mRoot = gZobrist.layout(board, level) ^ (start << 17 | start >> 47);
+	mNodes = 0;
+	mTable.newSearch();
+
+	int threshold = heuristic(col, row);
+	while (threshold <= SOLVER_MAX_COST)
+	{
+		int next = search(col, row, 0, threshold);
+		if (next == SOLVER_FOUND)
+		{
+			solution.solved = true;
+			solution.cost = mCost;
+			solution.steps.assign(mPath, mCost);
+			break;
+		}
+		if (next >= SOLVER_NONE)
+		{
+			break;
+		}
+		threshold = next;
+	}
+	solution.nodes = mNodes;
+	return solution;
+}
+
+int Solver::heuristic(int col, int row)
+{
+	int best = SOLVER_NONE;
+	for (size_t i = 0; i < mHomes.size(); i++)
+	{
+		int distance = abs(mHomes[i] % BOARD_COLS - col) + abs(mHomes[i] / BOARD_COLS - row);
+		best = distance < best ? distance : best;
+	}
+
+	//A door can lead anywhere, but getting to it and through it still costs
+	for (size_t i = 0; i < mDoors.size(); i++)
+	{
+		int distance = abs(mDoors[i].col - col) + abs(mDoors[i].row - row) + 1;
+		best = distance < best ? distance : best;
+	}
+	return best;
+}
+
+int Solver::search(int col, int row, int g, int threshold)
+{
+	mNodes++;
+	unsigned long long key = mRoot ^ gZobrist.frog(col, row);
+	int h = heuristic(col, row);
+
+	//Reached more cheaply before: that visit covers everything from here
+	TranspositionEntry entry;
+	if (mTable.probe(key, entry))
+	{
+		if (entry.g < g)
+		{
+			return SOLVER_NONE;
+		}
+		h = entry.bound > h ? entry.bound : h;
+	}
+	if (g + h > threshold)
+	{
+		return g + h;
+	}
+	if (mLevel->getTrigger(col, row).action == TRIGGER_HOME)
+	{
+		mCost = g;
+		return SOLVER_FOUND;
+	}
+	if (g >= SOLVER_MAX_COST)
+	{
+		return SOLVER_NONE;
+	}
+	mTable.store(key, g, h);
+
+	int next = SOLVER_NONE;
+	bool exact = true;
+	for (int command = COMMAND_UP; command <= COMMAND_RIGHT; command++)
+	{
+		int nextCol = col + COMMAND_DX[command];
+		int nextRow = row + COMMAND_DY[command];
+		if (mBoard->isBlocked(nextCol, nextRow))
+		{
+			continue;
+		}
+		mPath[g] = COMMAND_SYMBOLS[command];
+		int cost = search(nextCol, nextRow, g + 1, threshold);
+		if (cost == SOLVER_FOUND)
+		{
+			return SOLVER_FOUND;
+		}
+		exact = exact && cost < SOLVER_NONE;
+		next = cost < next ? cost : next;
+	}
+	for (size_t i = 0; i < mDoors.size(); i++)
+	{
+		if (mDoors[i].col != col || mDoors[i].row != row)
+		{
+			continue;
+		}
+		mPath[g] = '|';
+		int cost = search(mDoors[i].targetCol, mDoors[i].targetRow, g + 1, threshold);
+		if (cost == SOLVER_FOUND)
+		{
+			return SOLVER_FOUND;
+		}
+		exact = exact && cost < SOLVER_NONE;
+		next = cost < next ? cost : next;
+	}
+
+	//Nothing below was pruned, so the cheapest overrun is a true bound from here
+	if (exact && next < SOLVER_NONE)
+	{
+		mTable.store(key, g, next - g);
+	}
+	return next;
+}
+
+int runSolver(const char *levelFile, int megabytes, ReplacePolicy policy)
+{
+	std::vector<GradeLevel> levels;
+	if (!loadLevels(levelFile, levels))
+	{
+		return 6;
+	}
+
+	TranspositionTable table(megabytes > 0 ? megabytes : TRANSPOSITION_DEFAULT_MB, policy);
+
+	//One level per job, every job writes its own slot
+	Uint64 start = SDL_GetPerformanceCounter();
+	std::vector<Solution> solutions(levels.size());
+	gJobs.parallelFor(static_cast<int>(levels.size()), 1, [&](int begin, int end)
+	{
+		Solver solver(table);
+		for (int i = begin; i < end; i++)
+		{
+			const GradeLevel &level = levels[i];
+			solutions[i] = solver.solve(level.board, level.triggers, level.startCol, level.startRow);
+		}
+	});
+	double ms = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+
+	unsigned long long nodes = 0;
+	int solved = 0;
+	int code = 0;
+	for (size_t i = 0; i < levels.size(); i++)
+	{
+		const Solution &solution = solutions[i];
+		nodes += solution.nodes;
+		if (!solution.solved)
+		{
+			printf("%s: no way home\n", levels[i].name.c_str());
+			continue;
+		}
+		solved++;
+		printf("%s: %d %s\n", levels[i].name.c_str(), solution.cost, solution.steps.c_str());
+
+		//The search and the flood fill must agree on the cheapest cost
+		if (solution.cost != solution.shortest)
+		{
+			printf("%s: search found %d, flood fill found %d\n", levels[i].name.c_str(), solution.cost, solution.shortest);
+			code = 7;
+		}
+	}
+	fprintf(stderr, "Solved %d of %u levels in %.2f ms, %llu positions searched, %s replacement\n", solved, static_cast<unsigned>(levels.size()), ms, nodes, POLICY_NAMES[policy]);
+	return code;
+}
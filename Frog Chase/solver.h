@@ -0,0 +1,87 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "level.h"
+#include "program.h"
+#include "transposition.h"
+
+/*
+* Finds the cheapest way home: arrows, plus an enter press for each door
+* taken on the way. IDA* with a Manhattan heuristic does the search, and a
+* transposition table shared with other solver threads prunes positions
+* already reached more cheaply and remembers the bounds each search learns.
+* A breadth-first pass over bitboards first rules out levels with no way home.
+*/
+
+//Longest solution looked for
+const int SOLVER_MAX_COST = 512;
+
+struct Solution
+{
+	bool solved;
+
+	//Arrows plus enter presses
+	int cost;
+
+	//Arrows as the HUD shows them, with | where enter is pressed at a door
+	std::string steps;
+
+	//Positions searched
+	unsigned long long nodes;
+
+	//Cost the flood fill found before searching, -1 if it found no way home
+	int shortest;
+};
+
+class Solver
+{
+public:
+	//Initializes a solver that shares table with other solvers
+	Solver(TranspositionTable &table);
+
+	//Cost of the cheapest solution, found breadth-first over bitboards; -1 if there is none
+	int shortestCost(const MoveBoard &board, const Level &level, int col, int row);
+
+	//Finds a cheapest solution for the frog at col, row
+	Solution solve(const MoveBoard &board, const Level &level, int col, int row);
+
+private:
+	struct Door
+	{
+		int col;
+		int row;
+		int targetCol;
+		int targetRow;
+	};
+
+	//Collects the homes and usable doors of a level
+	void prepare(const MoveBoard &board, const Level &level);
+
+	//Lower bound on the cost home from a tile
+	int heuristic(int col, int row);
+
+	//Depth-first search below threshold; returns SOLVER_FOUND or the smallest cost over it
+	int search(int col, int row, int g, int threshold);
+
+	TranspositionTable &mTable;
+	const MoveBoard *mBoard;
+	const Level *mLevel;
+	std::vector<Door> mDoors;
+	std::vector<int> mHomes;
+
+	//Hash of the level and the start, each frog tile is XORed in
+	unsigned long long mRoot;
+	unsigned long long mNodes;
+	char mPath[SOLVER_MAX_COST + 1];
+	int mCost;
+};
+
+/**
+* Solves every level of a level set on gJobs with one shared table and prints
+* each level's cheapest solution
+* @param levelFile The level set file, in the grader's format
+* @param megabytes Size of the shared transposition table
+* @param policy Which entry the table gives up when a bucket is full
+* @return 0 on success, otherwise the exit code for the failure
+*/
+int runSolver(const char *levelFile, int megabytes, ReplacePolicy policy = REPLACE_DEPTH_AGE);
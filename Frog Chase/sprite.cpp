@@ -0,0 +1,166 @@
+#include "sprite.h"
+#include "board.h"
+
+Sprite::Sprite()
+{
+	//Initialize the offsets
+	mPosX = 0;
+	mPosY = 0;
+
+	//Initialize the velocity
+	mVelX = 0;
+	mVelY = 0;
+
+	//Set collision box dimension
+	mCollider.w = SPRITE_WIDTH;
+	mCollider.h = SPRITE_HEIGHT;
+	mMask = NULL;
+	mRocks = NULL;
+	mRockMask = NULL;
+}
+
+void Sprite::runCommand(Command command)
+{
+	//Adjust the velocity for one move, then stop again
+	mVelX = COMMAND_DX[command] * SPRITE_VEL;
+	mVelY = COMMAND_DY[command] * SPRITE_VEL;
+	move();
+	mVelX = 0;
+	mVelY = 0;
+}
+int Sprite::sweepStep(int dx, int dy)
+{
+	int distance = dx != 0 ? dx : dy;
+	if (distance == 0 || mRocks == NULL)
+	{
+		return distance;
+	}
+
+	Box box = { static_cast<float>(mPosX), static_cast<float>(mPosY), static_cast<float>(mCollider.w), static_cast<float>(mCollider.h) };
+	SweepHit hit = sweepGrid(box, static_cast<float>(dx), static_cast<float>(dy), *mRocks);
+	if (hit.time >= 1.0f)
+	{
+		return distance;
+	}
+
+	//The sprite moves in whole steps, the ones made before the boxes touch are free
+	int length = distance < 0 ? -distance : distance;
+	int steps = static_cast<int>(hit.time * length) / SPRITE_VEL;
+
+	//After that only solid pixels block, touching a rock's transparent corner is fine
+	int dirX = dx > 0 ? 1 : (dx < 0 ? -1 : 0);
+	int dirY = dy > 0 ? 1 : (dy < 0 ? -1 : 0);
+	while (steps < length / SPRITE_VEL && !touchesRock(mPosX + dirX * (steps + 1) * SPRITE_VEL, mPosY + dirY * (steps + 1) * SPRITE_VEL))
+	{
+		steps++;
+	}
+	return distance < 0 ? -steps * SPRITE_VEL : steps * SPRITE_VEL;
+}
+
+bool Sprite::touchesRock(int x, int y)
+{
+	if (mRocks == NULL)
+	{
+		return false;
+	}
+
+	//Broad phase: rock tiles under the collision box
+	int firstCol = x / TILE_SIZE;
+	int lastCol = (x + mCollider.w - 1) / TILE_SIZE;
+	int firstRow = y / TILE_SIZE;
+	int lastRow = (y + mCollider.h - 1) / TILE_SIZE;
+	for (int row = firstRow; row <= lastRow; row++)
+	{
+		for (int col = firstCol; col <= lastCol; col++)
+		{
+			if (!mRocks->isSolid(col, row))
+			{
+				continue;
+			}
+
+			//Narrow phase: shift and AND the masks, boxes when there are none
+			if (mMask == NULL || mRockMask == NULL || mRockMask->getWidth() == 0 || CollisionMask::overlaps(*mMask, x, y, *mRockMask, col * TILE_SIZE, row * TILE_SIZE))
+			{
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+void Sprite::move()
+{
+	//Move the sprite left or right, up to the first rock in the way
+	int stepX = sweepStep(mVelX, 0);
+	mPosX += stepX;
+	mCollider.x = mPosX;
+
+	//If the sprite went too far to the left or right
+	if ((mPosX < 0) || (mPosX + SPRITE_WIDTH > SCREEN_WIDTH - 100))
+	{
+		//Move back
+		mPosX -= stepX;
+		mCollider.x = mPosX;
+	}
+
+	//Move the sprite up or down, up to the first rock in the way
+	int stepY = sweepStep(0, mVelY);
+	mPosY += stepY;
+	mCollider.y = mPosY;
+
+	//If the sprite went too far up or down
+	if ((mPosY < 0) || (mPosY + SPRITE_HEIGHT > SCREEN_HEIGHT + 50))
+	{
+		//Move back
+		mPosY -= stepY;
+		mCollider.y = mPosY;
+	}
+}
+
+void Sprite::setColliderSize(int w, int h)
+{
+	mCollider.w = w;
+	mCollider.h = h;
+}
+
+void Sprite::setMask(const CollisionMask *mask)
+{
+	mMask = mask;
+}
+
+void Sprite::setRocks(const RockGrid *grid, const CollisionMask *rockMask)
+{
+	mRocks = grid;
+	mRockMask = rockMask;
+}
+
+void Sprite::setPositions(int x, int y)
+{
+	mPosX = x;
+	mPosY = y;
+}
+
+int Sprite::getPositionX()
+{
+	return mPosX;
+}
+
+int Sprite::getPositionY()
+{
+	return mPosY;
+}
+
+void buildMoveBoard(Sprite &frog, MoveBoard &board)
+{
+	board.clear();
+	for (int row = 0; row < FROG_ROWS; row++)
+	{
+		for (int col = 0; col < FROG_COLS; col++)
+		{
+			if (frog.touchesRock(col * TILE_SIZE + FROG_OFFSET_X, row * TILE_SIZE + FROG_OFFSET_Y))
+			{
+				board.block(col, row);
+			}
+		}
+	}
+}
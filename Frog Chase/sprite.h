@@ -0,0 +1,85 @@
+#pragma once
+#if defined(_MSC_VER)
+#include <SDL.h>
+#else
+#include <SDL2/SDL.h>
+#endif
+#include "collision.h"
+#include "collisionmask.h"
+#include "commandring.h"
+#include "program.h"
+
+/*
+* The frog and the pelican. A move is one tile and stops short at the first
+* rock whose solid pixels the sprite would touch: the box sweep finds where
+* it could first meet a rock tile and the masks decide from there. Nothing
+* here draws, so the rules can run without a window.
+*/
+class Sprite
+{
+public:
+	//The dimensions of the sprite
+	static const int SPRITE_WIDTH = 104;
+	static const int SPRITE_HEIGHT = 96;
+
+	//Maximum axis velocity of the sprite
+	static const int SPRITE_VEL = 80;
+
+	//Initializes the variables
+	Sprite();
+
+	//Set the positions of the sprite
+	void setPositions(int x, int y);
+
+	//Get the position X of the sprite
+	int getPositionX();
+
+	//Get the position Y of the sprite
+	int getPositionY();
+
+	//Moves the sprite one step in the command's direction
+	void runCommand(Command command);
+
+	//Moves the sprite
+	void move();
+
+	//Sets the size of the collision box to the sprite image's
+	void setColliderSize(int w, int h);
+
+	//Sets the solid pixels of the sprite image
+	void setMask(const CollisionMask *mask);
+
+	//Sets the rocks moves stop at and the solid pixels of one rock tile
+	void setRocks(const RockGrid *grid, const CollisionMask *rockMask);
+
+	//How far the sprite gets along a move before hitting a rock
+	int sweepStep(int dx, int dy);
+
+	//True when the sprite at x, y would touch a rock's solid pixels
+	bool touchesRock(int x, int y);
+
+
+private:
+	//The X and Y offsets of the sprite
+	int mPosX, mPosY;
+
+	//The velocity of the sprite
+	int mVelX, mVelY;
+
+	//Sprite's collision box
+	SDL_Rect mCollider;
+
+	//Sprite's solid pixels, the whole box when there are none
+	const CollisionMask *mMask;
+
+	//Rocks in the way, none when mRocks is NULL
+	const RockGrid *mRocks;
+	const CollisionMask *mRockMask;
+};
+
+/**
+* Copy the rocks the frog would bump into onto a headless board
+* @param frog The frog, whose solid pixels are tested against the rocks
+* @param board The board to fill
+*/
+void buildMoveBoard(Sprite &frog, MoveBoard &board);
@@ -0,0 +1,338 @@
+#include "texturecache.h"
+#include <math.h>
+#include "compositor.h"
+
+TextureCache gTextureCache;
+
+//Filter taps for one axis; output i uses indices[offsets[i]] to indices[offsets[i + 1]]
+struct FilterTaps
+{
+	std::vector<int> offsets;
+	std::vector<int> indices;
+	std::vector<float> weights;
+};
+
+static void buildTaps(int srcSize, int dstSize, FilterTaps &taps)
+{
+	float scale = static_cast<float>(srcSize) / dstSize;
+
+	//Shrinking widens the tent to cover every source pixel, growing is bilinear
+	float radius = scale > 1.0f ? scale : 1.0f;
+
+	for (int i = 0; i < dstSize; i++)
+	{
+		float center = (i + 0.5f) * scale - 0.5f;
+		int lo = static_cast<int>(ceilf(center - radius));
+		int hi = static_cast<int>(floorf(center + radius));
+		size_t first = taps.indices.size();
+		float sum = 0.0f;
+
+		taps.offsets.push_back(static_cast<int>(first));
+		for (int j = lo; j <= hi; j++)
+		{
+			float weight = 1.0f - fabsf(j - center) / radius;
+			if (weight <= 0.0f)
+			{
+				continue;
+			}
+			int index = j < 0 ? 0 : (j >= srcSize ? srcSize - 1 : j);
+			taps.indices.push_back(index);
+			taps.weights.push_back(weight);
+			sum += weight;
+		}
+		for (size_t k = first; k < taps.weights.size(); k++)
+		{
+			taps.weights[k] /= sum;
+		}
+	}
+	taps.offsets.push_back(static_cast<int>(taps.indices.size()));
+}
+
+SDL_Surface *resampleSurface(SDL_Surface *src, int w, int h)
+{
+	if (src == NULL || w <= 0 || h <= 0)
+	{
+		return NULL;
+	}
+
+	SDL_Surface *converted = SDL_ConvertSurfaceFormat(src, SDL_PIXELFORMAT_ARGB8888, 0);
+	if (converted == NULL)
+	{
+		return NULL;
+	}
+	SDL_Surface *result = SDL_CreateRGBSurface(0, w, h, 32, 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000);
+	if (result == NULL)
+	{
+		SDL_FreeSurface(converted);
+		return NULL;
+	}
+
+	int srcW = converted->w;
+	int srcH = converted->h;
+
+	//Premultiplied source, four floats per pixel in A R G B order
+	std::vector<float> source(srcW * srcH * 4);
+	SDL_LockSurface(converted);
+	for (int y = 0; y < srcH; y++)
+	{
+		const Uint32 *row = reinterpret_cast<const Uint32 *>(static_cast<const Uint8 *>(converted->pixels) + y * converted->pitch);
+		for (int x = 0; x < srcW; x++)
+		{
+			float *out = &source[(y * srcW + x) * 4];
+			float a = (row[x] >> 24) / 255.0f;
+			out[0] = a;
+			out[1] = ((row[x] >> 16) & 0xFF) / 255.0f * a;
+			out[2] = ((row[x] >> 8) & 0xFF) / 255.0f * a;
+			out[3] = (row[x] & 0xFF) / 255.0f * a;
+		}
+	}
+	SDL_UnlockSurface(converted);
+	SDL_FreeSurface(converted);
+
+	FilterTaps tapsX;
+	FilterTaps tapsY;
+	buildTaps(srcW, w, tapsX);
+	buildTaps(srcH, h, tapsY);
+
+	//Horizontal pass
+	std::vector<float> wide(w * srcH * 4, 0.0f);
+	for (int y = 0; y < srcH; y++)
+	{
+		for (int x = 0; x < w; x++)
+		{
+			float *out = &wide[(y * w + x) * 4];
+			for (int k = tapsX.offsets[x]; k < tapsX.offsets[x + 1]; k++)
+			{
+				const float *in = &source[(y * srcW + tapsX.indices[k]) * 4];
+				float weight = tapsX.weights[k];
+				for (int c = 0; c < 4; c++)
+				{
+					out[c] += in[c] * weight;
+				}
+			}
+		}
+	}
+
+	//Vertical pass straight into the result
+	SDL_LockSurface(result);
+	for (int y = 0; y < h; y++)
+	{
+		Uint32 *row = reinterpret_cast<Uint32 *>(static_cast<Uint8 *>(result->pixels) + y * result->pitch);
+		for (int x = 0; x < w; x++)
+		{
+			float value[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+			for (int k = tapsY.offsets[y]; k < tapsY.offsets[y + 1]; k++)
+			{
+				const float *in = &wide[(tapsY.indices[k] * w + x) * 4];
+				float weight = tapsY.weights[k];
+				for (int c = 0; c < 4; c++)
+				{
+					value[c] += in[c] * weight;
+				}
+			}
+
+			Uint32 pixel = 0;
+			float a = value[0];
+			for (int c = 0; c < 4; c++)
+			{
+				float v = c == 0 ? a : (a > 0.0f ? value[c] / a : 0.0f);
+				int byte = static_cast<int>(v * 255.0f + 0.5f);
+				byte = byte < 0 ? 0 : (byte > 255 ? 255 : byte);
+				pixel |= static_cast<Uint32>(byte) << (24 - 8 * c);
+			}
+			row[x] = pixel;
+		}
+	}
+	SDL_UnlockSurface(result);
+
+	return result;
+}
+
+TextureCache::TextureCache()
+{
+	//Initialize
+	mRenderer = NULL;
+	mScaleX = 1.0f;
+	mScaleY = 1.0f;
+}
+
+TextureCache::~TextureCache()
+{
+	//Deallocate
+	free();
+}
+
+void TextureCache::init(SDL_Renderer *ren)
+{
+	mRenderer = ren;
+	SDL_RenderGetScale(ren, &mScaleX, &mScaleY);
+}
+
+void TextureCache::free()
+{
+	dropVariants();
+	for (std::map<SDL_Texture *, Source>::iterator it = mSources.begin(); it != mSources.end(); ++it)
+	{
+		SDL_FreeSurface(it->second.surface);
+	}
+	mSources.clear();
+	mRenderer = NULL;
+}
+
+void TextureCache::registerSource(SDL_Texture *tex, SDL_Surface *surface, int fullW, int fullH, int offsetX, int offsetY)
+{
+	if (tex == NULL || surface == NULL)
+	{
+		return;
+	}
+
+	//Share the caller's surface instead of copying it
+	surface->refcount++;
+
+	std::map<SDL_Texture *, Source>::iterator it = mSources.find(tex);
+	if (it != mSources.end())
+	{
+		dropVariants(it->second);
+		SDL_FreeSurface(it->second.surface);
+		mSources.erase(it);
+	}
+
+	Source source;
+	source.surface = surface;
+	source.blendMode = SDL_BLENDMODE_BLEND;
+	SDL_GetTextureBlendMode(tex, &source.blendMode);
+	source.fullW = fullW;
+	source.fullH = fullH;
+	source.offsetX = offsetX;
+	source.offsetY = offsetY;
+	mSources[tex] = source;
+}
+
+void TextureCache::unregisterSource(SDL_Texture *tex)
+{
+	std::map<SDL_Texture *, Source>::iterator it = mSources.find(tex);
+	if (it != mSources.end())
+	{
+		dropVariants(it->second);
+		SDL_FreeSurface(it->second.surface);
+		mSources.erase(it);
+	}
+}
+
+void TextureCache::prepare(SDL_Texture *tex, int w, int h)
+{
+	SDL_Rect dst = { 0, 0, w, h };
+	resolve(tex, dst);
+}
+
+SDL_Texture *TextureCache::resolve(SDL_Texture *tex, SDL_Rect &dst)
+{
+	std::map<SDL_Texture *, Source>::iterator it = mSources.find(tex);
+	if (it == mSources.end() || dst.w <= 0 || dst.h <= 0)
+	{
+		return tex;
+	}
+	Source &source = it->second;
+
+	//Map the trimmed part of the image into the destination
+	if (source.surface->w != source.fullW || source.surface->h != source.fullH)
+	{
+		int left = dst.x + source.offsetX * dst.w / source.fullW;
+		int top = dst.y + source.offsetY * dst.h / source.fullH;
+		int right = dst.x + ((source.offsetX + source.surface->w) * dst.w + source.fullW - 1) / source.fullW;
+		int bottom = dst.y + ((source.offsetY + source.surface->h) * dst.h + source.fullH - 1) / source.fullH;
+		dst.x = left;
+		dst.y = top;
+		dst.w = right - left;
+		dst.h = bottom - top;
+	}
+	if (mRenderer == NULL)
+	{
+		return tex;
+	}
+
+	//Size in real pixels once the renderer scale is applied
+	int pixelW = static_cast<int>(dst.w * mScaleX + 0.5f);
+	int pixelH = static_cast<int>(dst.h * mScaleY + 0.5f);
+
+	if (source.surface->w == pixelW && source.surface->h == pixelH)
+	{
+		return tex;
+	}
+
+	for (size_t i = 0; i < source.variants.size(); i++)
+	{
+		if (source.variants[i].w == pixelW && source.variants[i].h == pixelH)
+		{
+			return source.variants[i].texture;
+		}
+	}
+
+	SDL_Texture *variant = createVariant(source, pixelW, pixelH);
+	return variant != NULL ? variant : tex;
+}
+
+void TextureCache::querySize(SDL_Texture *tex, int *w, int *h)
+{
+	std::map<SDL_Texture *, Source>::iterator it = mSources.find(tex);
+	if (it == mSources.end())
+	{
+		SDL_QueryTexture(tex, NULL, NULL, w, h);
+		return;
+	}
+	*w = it->second.fullW;
+	*h = it->second.fullH;
+}
+
+void TextureCache::setScale(float scaleX, float scaleY)
+{
+	if (scaleX == mScaleX && scaleY == mScaleY)
+	{
+		return;
+	}
+	mScaleX = scaleX;
+	mScaleY = scaleY;
+	dropVariants();
+}
+
+SDL_Texture *TextureCache::createVariant(Source &source, int w, int h)
+{
+	SDL_Surface *scaled = resampleSurface(source.surface, w, h);
+	if (scaled == NULL)
+	{
+		return NULL;
+	}
+
+	SDL_Texture *texture = SDL_CreateTextureFromSurface(mRenderer, scaled);
+	if (texture != NULL)
+	{
+		SDL_SetTextureBlendMode(texture, source.blendMode);
+		gCompositor.registerImage(texture, scaled);
+
+		Variant variant;
+		variant.w = w;
+		variant.h = h;
+		variant.texture = texture;
+		source.variants.push_back(variant);
+	}
+	SDL_FreeSurface(scaled);
+	return texture;
+}
+
+void TextureCache::dropVariants(Source &source)
+{
+	for (size_t i = 0; i < source.variants.size(); i++)
+	{
+		gCompositor.unregisterImage(source.variants[i].texture);
+		SDL_DestroyTexture(source.variants[i].texture);
+	}
+	source.variants.clear();
+}
+
+void TextureCache::dropVariants()
+{
+	for (std::map<SDL_Texture *, Source>::iterator it = mSources.begin(); it != mSources.end(); ++it)
+	{
+		dropVariants(it->second);
+	}
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include <map>
+#include <vector>
+#if defined(_MSC_VER)
+#include <SDL.h>
+#else
+#include <SDL2/SDL.h>
+#endif
+
+/*
+* Keeps a copy of every texture at each size it is drawn at, filtered once on
+* the CPU, so per-frame draws are 1:1 copies. Variants are rebuilt only when
+* the renderer scale changes. Textures whose transparent border was trimmed
+* at load are drawn with their offset into the full image.
+*/
+class TextureCache
+{
+public:
+	//Initializes variables
+	TextureCache();
+
+	//Deallocates memory
+	~TextureCache();
+
+	//Sets the renderer variants are created on
+	void init(SDL_Renderer *ren);
+
+	//Destroys every variant and source surface
+	void free();
+
+	//Keeps the surface a texture was created from, which sits at
+	//offsetX, offsetY inside a fullW x fullH image when it was trimmed
+	void registerSource(SDL_Texture *tex, SDL_Surface *surface, int fullW, int fullH, int offsetX, int offsetY);
+
+	//Forgets a texture and destroys its variants
+	void unregisterSource(SDL_Texture *tex);
+
+	//Builds the variant for drawing tex at w x h ahead of time
+	void prepare(SDL_Texture *tex, int w, int h);
+
+	//Texture to draw for tex into dst, which is narrowed to the trimmed part
+	SDL_Texture *resolve(SDL_Texture *tex, SDL_Rect &dst);
+
+	//Size of the image before trimming
+	void querySize(SDL_Texture *tex, int *w, int *h);
+
+	//Drops the variants when the renderer scale changes
+	void setScale(float scaleX, float scaleY);
+
+private:
+	struct Variant
+	{
+		int w;
+		int h;
+		SDL_Texture *texture;
+	};
+
+	struct Source
+	{
+		SDL_Surface *surface;
+		int fullW;
+		int fullH;
+		int offsetX;
+		int offsetY;
+
+		//Blend mode the loader picked, copied to the variants
+		SDL_BlendMode blendMode;
+		std::vector<Variant> variants;
+	};
+
+	//Filters the source down or up to w x h pixels
+	SDL_Texture *createVariant(Source &source, int w, int h);
+
+	//Destroys the variants of one source
+	void dropVariants(Source &source);
+
+	//Destroys the variants of every source
+	void dropVariants();
+
+	SDL_Renderer *mRenderer;
+	float mScaleX;
+	float mScaleY;
+	std::map<SDL_Texture *, Source> mSources;
+};
+
+extern TextureCache gTextureCache;
+
+/**
+* Resamples a surface with a tent filter sized to the scale factor, in
+* premultiplied alpha so transparent edges don't bleed dark fringes
+* @param src The surface to resample
+* @param w The width of the result
+* @param h The height of the result
+* @return a new ARGB8888 surface, or nullptr if something went wrong
+*/
+SDL_Surface *resampleSurface(SDL_Surface *src, int w, int h);
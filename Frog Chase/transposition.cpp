@@ -0,0 +1,158 @@
+#include "transposition.h"
+#include <new>
+#include <stdint.h>
+
+static const size_t CACHE_LINE = 64;
+
+//Entry data: g in bits 0-15, bound in 16-31, age in 32-39; bit 40 marks
+//the slot used, so all-zero data is an empty slot
+static const unsigned long long ENTRY_USED = 1ULL << 40;
+
+static unsigned long long packEntry(int g, int bound, int age)
+{
+	return static_cast<unsigned long long>(g & 0xFFFF) | static_cast<unsigned long long>(bound & 0xFFFF) << 16 | static_cast<unsigned long long>(age & 0xFF) << 32 | ENTRY_USED;
+}
+
+static TranspositionEntry unpackEntry(unsigned long long data)
+{
+	TranspositionEntry entry;
+	entry.g = static_cast<int>(data & 0xFFFF);
+	entry.bound = static_cast<int>(data >> 16 & 0xFFFF);
+	entry.age = static_cast<int>(data >> 32 & 0xFF);
+	return entry;
+}
+
+TranspositionTable::TranspositionTable(size_t megabytes, ReplacePolicy policy)
+{
+	//Initialize
+	size_t buckets = 1;
+	while (buckets * 2 * sizeof(Bucket) <= megabytes * 1024 * 1024)
+	{
+		buckets *= 2;
+	}
+	mMemory = new char[buckets * sizeof(Bucket) + CACHE_LINE];
+	uintptr_t aligned = (reinterpret_cast<uintptr_t>(mMemory) + CACHE_LINE - 1) & ~static_cast<uintptr_t>(CACHE_LINE - 1);
+	mBuckets = reinterpret_cast<Bucket *>(aligned);
+	for (size_t i = 0; i < buckets; i++)
+	{
+		new (&mBuckets[i]) Bucket();
+	}
+	mMask = buckets - 1;
+	mPolicy = policy;
+	mAge = 0;
+	clear();
+}
+
+TranspositionTable::~TranspositionTable()
+{
+	//Deallocate
+	delete[] mMemory;
+}
+
+bool TranspositionTable::probe(unsigned long long key, TranspositionEntry &entry) const
+{
+	const Bucket &bucket = mBuckets[key & mMask];
+	for (int i = 0; i < TRANSPOSITION_BUCKET_ENTRIES; i++)
+	{
+		unsigned long long data = bucket.entries[i].data.load(std::memory_order_relaxed);
+		unsigned long long check = bucket.entries[i].check.load(std::memory_order_relaxed);
+		if ((check ^ data) == key && data != 0)
+		{
+			entry = unpackEntry(data);
+			return true;
+		}
+	}
+	return false;
+}
+
+void TranspositionTable::store(unsigned long long key, int g, int bound)
+{
+	Bucket &bucket = mBuckets[key & mMask];
+	unsigned long long data = packEntry(g, bound, mAge.load(std::memory_order_relaxed));
+
+	//The same position is updated in place, keeping the cheapest way there
+	//and the best bound found
+	int victim = -1;
+	for (int i = 0; i < TRANSPOSITION_BUCKET_ENTRIES && victim < 0; i++)
+	{
+		unsigned long long old = bucket.entries[i].data.load(std::memory_order_relaxed);
+		if ((bucket.entries[i].check.load(std::memory_order_relaxed) ^ old) == key && old != 0)
+		{
+			TranspositionEntry previous = unpackEntry(old);
+			g = previous.g < g ? previous.g : g;
+			bound = previous.bound > bound ? previous.bound : bound;
+			data = packEntry(g, bound, mAge.load(std::memory_order_relaxed));
+			victim = i;
+		}
+	}
+
+	if (victim < 0)
+	{
+		if (mPolicy == REPLACE_ALWAYS)
+		{
+			//The key's top bits pick the slot so positions spread over the bucket
+			victim = static_cast<int>(key >> 62) % TRANSPOSITION_BUCKET_ENTRIES;
+		}
+		else
+		{
+			int lowest = 0;
+			for (int i = 0; i < TRANSPOSITION_BUCKET_ENTRIES; i++)
+			{
+				int score = keepScore(bucket.entries[i].data.load(std::memory_order_relaxed));
+				if (victim < 0 || score < lowest)
+				{
+					victim = i;
+					lowest = score;
+				}
+			}
+		}
+	}
+
+	//Two plain stores; a racing reader sees a mismatched pair as a miss
+	bucket.entries[victim].data.store(data, std::memory_order_relaxed);
+	bucket.entries[victim].check.store(key ^ data, std::memory_order_relaxed);
+}
+
+int TranspositionTable::newSearch()
+{
+	return (mAge.fetch_add(1) + 1) & 0xFF;
+}
+
+int TranspositionTable::getAge() const
+{
+	return mAge.load(std::memory_order_relaxed) & 0xFF;
+}
+
+void TranspositionTable::clear()
+{
+	for (size_t i = 0; i <= mMask; i++)
+	{
+		for (int j = 0; j < TRANSPOSITION_BUCKET_ENTRIES; j++)
+		{
+			mBuckets[i].entries[j].check.store(0, std::memory_order_relaxed);
+			mBuckets[i].entries[j].data.store(0, std::memory_order_relaxed);
+		}
+	}
+}
+
+size_t TranspositionTable::getCapacity() const
+{
+	return (mMask + 1) * TRANSPOSITION_BUCKET_ENTRIES;
+}
+
+int TranspositionTable::keepScore(unsigned long long data) const
+{
+	if (data == 0)
+	{
+		return -1000000;
+	}
+	TranspositionEntry entry = unpackEntry(data);
+	if (mPolicy != REPLACE_DEPTH_AGE)
+	{
+		return entry.bound;
+	}
+
+	//Each generation behind costs more than any bound the board can produce
+	int behind = (getAge() - entry.age) & 0xFF;
+	return entry.bound - behind * 0x10000;
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include <atomic>
+#include <stddef.h>
+
+/*
+* Fixed-size transposition table shared by solver threads without locks.
+* Entries sit four to a 64-byte bucket, one cache line, so a probe touches a
+* single line. Each entry is stored as (key ^ data, data): a reader that
+* catches another thread halfway through a write sees a key that doesn't
+* match and treats it as a miss, so torn entries are never used.
+*/
+
+//Default table size
+const size_t TRANSPOSITION_DEFAULT_MB = 16;
+
+//Entries per bucket, four 16-byte entries fill a cache line
+const int TRANSPOSITION_BUCKET_ENTRIES = 4;
+
+enum ReplacePolicy
+{
+	//Newest entry wins, cheapest to keep, loses deep results
+	REPLACE_ALWAYS,
+
+	//Keeps the entry searched deepest
+	REPLACE_DEPTH,
+
+	//Keeps the entry searched deepest unless it is from an older search
+	REPLACE_DEPTH_AGE
+};
+
+struct TranspositionEntry
+{
+	//Cost from the start when the position was reached
+	int g;
+
+	//Lower bound on the cost left, the depth the position was searched to
+	int bound;
+
+	//Search generation that wrote the entry
+	int age;
+};
+
+class TranspositionTable
+{
+public:
+	//Allocates megabytes of buckets, rounded down to a power of two
+	TranspositionTable(size_t megabytes = TRANSPOSITION_DEFAULT_MB, ReplacePolicy policy = REPLACE_DEPTH_AGE);
+
+	//Deallocates memory
+	~TranspositionTable();
+
+	//Looks up a position; false when it isn't stored
+	bool probe(unsigned long long key, TranspositionEntry &entry) const;
+
+	//Stores a position, possibly replacing another in its bucket; a position
+	//already stored keeps the lower g and the higher bound
+	void store(unsigned long long key, int g, int bound);
+
+	//Starts a new search generation, older entries become first to go
+	int newSearch();
+
+	//Current search generation
+	int getAge() const;
+
+	//Empties the table; not safe while other threads use it
+	void clear();
+
+	//Number of entries the table holds
+	size_t getCapacity() const;
+
+private:
+	struct Entry
+	{
+		std::atomic<unsigned long long> check;
+		std::atomic<unsigned long long> data;
+	};
+
+	struct Bucket
+	{
+		Entry entries[TRANSPOSITION_BUCKET_ENTRIES];
+	};
+
+	//Not copyable
+	TranspositionTable(const TranspositionTable &);
+	TranspositionTable &operator=(const TranspositionTable &);
+
+	//Worth of keeping an entry, lowest is replaced first
+	int keepScore(unsigned long long data) const;
+
+	//Allocation, with the buckets starting on a cache line inside it
+	char *mMemory;
+	Bucket *mBuckets;
+	size_t mMask;
+	ReplacePolicy mPolicy;
+	std::atomic<int> mAge;
+};
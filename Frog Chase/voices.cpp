@@ -0,0 +1,177 @@
+#include "voices.h"
+#include <string.h>
+
+//Steps come fast and are cheap to lose, stings must be heard
+static const SoundClassInfo SOUND_CLASSES[SOUND_CLASS_COUNT] =
+{
+	{ 2, 1, 50 },
+	{ 1, 2, 100 },
+	{ 1, 3, 250 },
+};
+
+VoicePool::VoicePool()
+{
+	//Initialize
+	mOpen = false;
+	mStatsLock = 0;
+	close();
+}
+
+void VoicePool::open()
+{
+	Mix_AllocateChannels(VOICE_COUNT);
+	close();
+	mOpen = true;
+}
+
+void VoicePool::close()
+{
+	for (int i = 0; i < VOICE_COUNT; i++)
+	{
+		mVoices[i].chunk = NULL;
+		mVoices[i].soundClass = SOUND_STEP;
+		mVoices[i].started = 0;
+	}
+	SDL_AtomicLock(&mStatsLock);
+	memset(&mStats, 0, sizeof(mStats));
+	SDL_AtomicUnlock(&mStatsLock);
+	mOpen = false;
+}
+
+int VoicePool::play(Mix_Chunk *chunk, SoundClass soundClass)
+{
+	if (!mOpen || chunk == NULL)
+	{
+		return -1;
+	}
+
+	Uint32 now = SDL_GetTicks();
+	const SoundClassInfo &info = SOUND_CLASSES[soundClass];
+
+	//Fold a retrigger into the voice that just started the same sound
+	for (int i = 0; i < VOICE_COUNT; i++)
+	{
+		if (mVoices[i].chunk == chunk && Mix_Playing(i) && now - mVoices[i].started < info.coalesceMs)
+		{
+			SDL_AtomicLock(&mStatsLock);
+			mStats.coalesced++;
+			SDL_AtomicUnlock(&mStatsLock);
+			return i;
+		}
+	}
+
+	int channel = findVoice(soundClass);
+	if (channel < 0)
+	{
+		SDL_AtomicLock(&mStatsLock);
+		mStats.dropped++;
+		SDL_AtomicUnlock(&mStatsLock);
+		return -1;
+	}
+
+	bool stolen = Mix_Playing(channel) != 0;
+	if (stolen)
+	{
+		Mix_HaltChannel(channel);
+	}
+	if (Mix_PlayChannel(channel, chunk, 0) < 0)
+	{
+		mVoices[channel].chunk = NULL;
+		return -1;
+	}
+	mVoices[channel].chunk = chunk;
+	mVoices[channel].soundClass = soundClass;
+	mVoices[channel].started = now;
+
+	SDL_AtomicLock(&mStatsLock);
+	mStats.played++;
+	if (stolen)
+	{
+		mStats.stolen++;
+	}
+	SDL_AtomicUnlock(&mStatsLock);
+	return channel;
+}
+
+void VoicePool::countMix(int frames)
+{
+	//Mix_Playing takes no lock, so it is safe inside the callback
+	unsigned voices = static_cast<unsigned>(Mix_Playing(-1));
+
+	SDL_AtomicLock(&mStatsLock);
+	mStats.callbacks++;
+	mStats.voicesMixed += voices;
+	mStats.framesMixed += static_cast<unsigned long long>(voices) * frames;
+	if (voices > mStats.peakVoices)
+	{
+		mStats.peakVoices = voices;
+	}
+	SDL_AtomicUnlock(&mStatsLock);
+}
+
+VoiceStats VoicePool::getStats()
+{
+	SDL_AtomicLock(&mStatsLock);
+	VoiceStats stats = mStats;
+	SDL_AtomicUnlock(&mStatsLock);
+	return stats;
+}
+
+int VoicePool::findVoice(SoundClass soundClass)
+{
+	const SoundClassInfo &info = SOUND_CLASSES[soundClass];
+	int ownCount = 0;
+	int ownOldest = -1;
+	int freeVoice = -1;
+	int victim = -1;
+
+	for (int i = 0; i < VOICE_COUNT; i++)
+	{
+		if (!Mix_Playing(i))
+		{
+			if (freeVoice < 0)
+			{
+				freeVoice = i;
+			}
+			continue;
+		}
+
+		const Voice &voice = mVoices[i];
+		if (voice.soundClass == soundClass)
+		{
+			ownCount++;
+			if (ownOldest < 0 || voice.started < mVoices[ownOldest].started)
+			{
+				ownOldest = i;
+			}
+		}
+		else if (SOUND_CLASSES[voice.soundClass].priority < info.priority)
+		{
+			//Lowest priority first, then the oldest
+			if (victim < 0)
+			{
+				victim = i;
+			}
+			else
+			{
+				int victimPriority = SOUND_CLASSES[mVoices[victim].soundClass].priority;
+				int priority = SOUND_CLASSES[voice.soundClass].priority;
+				if (priority < victimPriority || (priority == victimPriority && voice.started < mVoices[victim].started))
+				{
+					victim = i;
+				}
+			}
+		}
+	}
+
+	//A class at its cap restarts its own oldest voice
+	if (ownCount >= info.cap)
+	{
+		return ownOldest;
+	}
+	if (freeVoice >= 0)
+	{
+		return freeVoice;
+	}
+	return victim;
+}
@@ -0,0 +1,105 @@
+#pragma once
+#include <vector>
+#if defined(_MSC_VER)
+#include <SDL.h>
+#include <SDL_mixer.h>
+#elif defined(__clang__)
+#include <SDL2/SDL.h>
+#include <SDL2_mixer/SDL_mixer.h>
+#else
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_mixer.h>
+#endif
+
+/*
+* Hands out mixer channels to sound effects. Each class of sound has a cap on
+* how many voices it holds and a priority; a full pool steals from the lowest
+* priority, and retriggers of a sound that just started are folded into the
+* voice already playing. The number of voices mixed is bounded by the pool.
+*/
+
+//Mixer channels the pool owns
+const int VOICE_COUNT = 8;
+
+enum SoundClass
+{
+	//A move in the command replay
+	SOUND_STEP,
+
+	//Menus and screens
+	SOUND_UI,
+
+	//Winning or losing
+	SOUND_STING,
+
+	SOUND_CLASS_COUNT
+};
+
+struct SoundClassInfo
+{
+	//Voices the class may hold at once
+	int cap;
+
+	//Higher priorities steal from lower ones when the pool is full
+	int priority;
+
+	//Retriggers of the same sound this soon after it started are dropped
+	Uint32 coalesceMs;
+};
+
+//Counters since the pool was opened
+struct VoiceStats
+{
+	unsigned played;
+	unsigned coalesced;
+	unsigned stolen;
+	unsigned dropped;
+
+	//Mixer callbacks and the voices mixed in them
+	unsigned callbacks;
+	unsigned voicesMixed;
+	unsigned peakVoices;
+
+	//Sample frames mixed for sound effects
+	unsigned long long framesMixed;
+};
+
+class VoicePool
+{
+public:
+	//Initializes variables
+	VoicePool();
+
+	//Allocates the mixer channels, called once the mixer is open
+	void open();
+
+	//Forgets every voice
+	void close();
+
+	//Plays a chunk as a sound of the given class, returns the channel or -1
+	int play(Mix_Chunk *chunk, SoundClass soundClass);
+
+	//Counts what one mixer callback mixed, called on the audio thread
+	void countMix(int frames);
+
+	//Copy of the counters
+	VoiceStats getStats();
+
+private:
+	struct Voice
+	{
+		Mix_Chunk *chunk;
+		SoundClass soundClass;
+		Uint32 started;
+	};
+
+	//Picks the voice to reuse for a sound of this class, -1 to drop it
+	int findVoice(SoundClass soundClass);
+
+	bool mOpen;
+	Voice mVoices[VOICE_COUNT];
+	VoiceStats mStats;
+
+	//Written on the audio thread, read whole by getStats
+	SDL_SpinLock mStatsLock;
+};
@@ -0,0 +1,71 @@
+#include "zobrist.h"
+
+const ZobristKeys gZobrist;
+
+//splitmix64, good enough to spread the keys across all 64 bits
+static unsigned long long nextKey(unsigned long long &state)
+{
+	unsigned long long z = (state += 0x9E3779B97F4A7C15ULL);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+ZobristKeys::ZobristKeys()
+{
+	unsigned long long state = 0x46726F6743686173ULL;
+	for (int i = 0; i < BOARD_CELLS; i++)
+	{
+		mFrog[i] = nextKey(state);
+		mRock[i] = nextKey(state);
+		mDoorTarget[i] = nextKey(state);
+		for (int action = 0; action <= TRIGGER_TELEPORT; action++)
+		{
+			mTrigger[action][i] = nextKey(state);
+		}
+	}
+}
+
+unsigned long long ZobristKeys::frog(int col, int row) const
+{
+	return mFrog[row * BOARD_COLS + col];
+}
+
+unsigned long long ZobristKeys::rock(int col, int row) const
+{
+	return mRock[row * BOARD_COLS + col];
+}
+
+unsigned long long ZobristKeys::trigger(int col, int row, const CellTrigger &trigger) const
+{
+	if (trigger.action == TRIGGER_NONE)
+	{
+		return 0;
+	}
+	unsigned long long key = mTrigger[trigger.action][row * BOARD_COLS + col];
+	if (trigger.action == TRIGGER_TELEPORT && trigger.targetCol >= 0 && trigger.targetCol < BOARD_COLS && trigger.targetRow >= 0 && trigger.targetRow < BOARD_ROWS)
+	{
+		//Rotated by the door's tile so two doors swapping targets hash differently
+		unsigned long long target = mDoorTarget[trigger.targetRow * BOARD_COLS + trigger.targetCol];
+		int rotate = (row * BOARD_COLS + col) % 63 + 1;
+		key ^= target << rotate | target >> (64 - rotate);
+	}
+	return key;
+}
+
+unsigned long long ZobristKeys::layout(const MoveBoard &board, const Level &level) const
+{
+	unsigned long long hash = 0;
+	for (int row = 0; row < FROG_ROWS; row++)
+	{
+		for (int col = 0; col < FROG_COLS; col++)
+		{
+			if (board.isBlocked(col, row))
+			{
+				hash ^= rock(col, row);
+			}
+			hash ^= trigger(col, row, level.getTrigger(col, row));
+		}
+	}
+	return hash;
+}
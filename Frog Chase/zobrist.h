@@ -0,0 +1,42 @@
+#pragma once
+#include "board.h"
+#include "level.h"
+#include "program.h"
+
+/*
+* Zobrist keys for hashing game positions. Every (feature, tile) pair has a
+* random 64-bit key and a position hashes to the XOR of the keys of its
+* features, so a move or an edited rock updates the hash with two XORs
+* instead of rehashing the board. The layout part of the hash keeps positions
+* from different levels apart in a shared transposition table.
+*/
+
+const int BOARD_CELLS = BOARD_COLS * BOARD_ROWS;
+
+class ZobristKeys
+{
+public:
+	//Fills the tables from a fixed seed, so hashes are stable between runs
+	ZobristKeys();
+
+	//The frog on a tile
+	unsigned long long frog(int col, int row) const;
+
+	//A rock on a tile
+	unsigned long long rock(int col, int row) const;
+
+	//A tile's trigger, doors keyed with their target
+	unsigned long long trigger(int col, int row, const CellTrigger &trigger) const;
+
+	//Hash of a level's rocks and triggers, without the frog
+	unsigned long long layout(const MoveBoard &board, const Level &level) const;
+
+private:
+	unsigned long long mFrog[BOARD_CELLS];
+	unsigned long long mRock[BOARD_CELLS];
+	unsigned long long mTrigger[TRIGGER_TELEPORT + 1][BOARD_CELLS];
+	unsigned long long mDoorTarget[BOARD_CELLS];
+};
+
+//The one key set every hash is made from
+extern const ZobristKeys gZobrist;